@@ -1,5 +1,8 @@
 #pragma once
 
+#include "../kernel/math_accuracy.h"
+#include "../util/span.h"
+
 namespace deeplearning {
 
 enum ActivateType {
@@ -8,11 +11,43 @@ enum ActivateType {
   ACTIVATE_TANH,
 };
 
-class ActivateFunction {
+template <typename T> class ActivateFunction {
 public:
-  virtual double Activate(const double &input) = 0;
-  virtual double DerivActivate(const double &output) = 0;
+  using Scalar = T;
+
+  virtual T Activate(const T &input) = 0;
+  virtual T DerivActivate(const T &output) = 0;
   virtual ActivateType GetActivateType() = 0;
+
+  // bulk version, output[i] = Activate(input[i]), input may alias output.
+  // one call per layer instead of one per neuron, subclass override it with
+  // simd kernel
+  virtual void Activate(Span<const T> input, Span<T> output) {
+    if (input.size() != output.size()) {
+      return;
+    }
+    for (int i = 0; i < input.size(); i++) {
+      output[i] = Activate(input[i]);
+    }
+  }
+  // bulk version, delta[i] *= DerivActivate(output[i])
+  virtual void DerivActivate(Span<const T> output, Span<T> delta) {
+    if (output.size() != delta.size()) {
+      return;
+    }
+    for (int i = 0; i < output.size(); i++) {
+      delta[i] *= DerivActivate(output[i]);
+    }
+  }
+
+  // tier of the bulk Activate, only sigmoid and tanh depend on it
+  inline MathAccuracy math_accuracy() { return math_accuracy_; }
+  inline void set_math_accuracy(MathAccuracy accuracy) {
+    math_accuracy_ = accuracy;
+  }
+
+protected:
+  MathAccuracy math_accuracy_ = MATH_ACCURACY_EXACT;
 };
 
 } // namespace deeplearning
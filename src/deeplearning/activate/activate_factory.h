@@ -10,14 +10,16 @@ namespace deeplearning {
 
 class ActivateFactory {
 public:
-  static std::shared_ptr<ActivateFunction> Create(ActivateType activate_type) {
+  template <typename T = double>
+  static std::shared_ptr<ActivateFunction<T>>
+  Create(ActivateType activate_type) {
     switch (activate_type) {
     case ACTIVATE_SIGMOID:
-      return std::make_shared<SigmoidActivate>();
+      return std::make_shared<SigmoidActivate<T>>();
     case ACTIVATE_RELU:
-      return std::make_shared<ReluActivate>();
+      return std::make_shared<ReluActivate<T>>();
     case ACTIVATE_TANH:
-      return std::make_shared<TanhActivate>();
+      return std::make_shared<TanhActivate<T>>();
     default:
       return nullptr;
     }
@@ -1,17 +1,30 @@
 #pragma once
 
+#include "../kernel/dispatch.h"
 #include "activate_base.h"
 
 namespace deeplearning {
 
-class ReluActivate : public ActivateFunction {
+template <typename T> class ReluActivate : public ActivateFunction<T> {
 public:
-  double Activate(const double &x) override { return x > 0 ? x : 0; }
+  T Activate(const T &x) override { return x > 0 ? x : 0; }
 
-  double DerivActivate(const double &output) override {
-    return output > 0 ? 1 : 0;
-  }
+  T DerivActivate(const T &output) override { return output > 0 ? 1 : 0; }
 
+  void Activate(Span<const T> input, Span<T> output) override {
+    if (input.size() != output.size()) {
+      return;
+    }
+    kernel::GetKernelTable<T>().relu_(input.size(), input.data(),
+                                      output.data());
+  }
+  void DerivActivate(Span<const T> output, Span<T> delta) override {
+    if (output.size() != delta.size()) {
+      return;
+    }
+    kernel::GetKernelTable<T>().relu_deriv_(output.size(), output.data(),
+                                            delta.data());
+  }
   ActivateType GetActivateType() override {
     return ActivateType::ACTIVATE_RELU;
   }
@@ -1,16 +1,27 @@
 #pragma once
+#include "../kernel/dispatch.h"
 #include "activate_base.h"
 #include <cmath>
 
 namespace deeplearning {
 
-class SigmoidActivate : public ActivateFunction {
+template <typename T> class SigmoidActivate : public ActivateFunction<T> {
 public:
-  double Activate(const double &input) override {
-    return 1 / (1 + exp(-input));
+  T Activate(const T &input) override { return 1 / (1 + std::exp(-input)); }
+  T DerivActivate(const T &output) override { return output * (1 - output); }
+  void Activate(Span<const T> input, Span<T> output) override {
+    if (input.size() != output.size()) {
+      return;
+    }
+    kernel::GetKernelTable<T>().sigmoid_[this->math_accuracy_](
+        input.size(), input.data(), output.data());
   }
-  double DerivActivate(const double &output) override {
-    return output * (1 - output);
+  void DerivActivate(Span<const T> output, Span<T> delta) override {
+    if (output.size() != delta.size()) {
+      return;
+    }
+    kernel::GetKernelTable<T>().sigmoid_deriv_(output.size(), output.data(),
+                                               delta.data());
   }
   ActivateType GetActivateType() override { return ACTIVATE_SIGMOID; }
 };
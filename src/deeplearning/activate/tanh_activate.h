@@ -1,16 +1,29 @@
 #pragma once
 
+#include "../kernel/dispatch.h"
 #include "activate_base.h"
 #include <cmath>
 
 namespace deeplearning {
-class TanhActivate : public ActivateFunction {
+template <typename T> class TanhActivate : public ActivateFunction<T> {
 public:
-  double Activate(const double &input) override {
-    return (1 - exp(-2 * input)) / (1 + exp(-2 * input));
+  T Activate(const T &input) override {
+    return (1 - std::exp(-2 * input)) / (1 + std::exp(-2 * input));
   }
-  double DerivActivate(const double &output) override {
-    return 1 - output * output;
+  T DerivActivate(const T &output) override { return 1 - output * output; }
+  void Activate(Span<const T> input, Span<T> output) override {
+    if (input.size() != output.size()) {
+      return;
+    }
+    kernel::GetKernelTable<T>().tanh_[this->math_accuracy_](
+        input.size(), input.data(), output.data());
+  }
+  void DerivActivate(Span<const T> output, Span<T> delta) override {
+    if (output.size() != delta.size()) {
+      return;
+    }
+    kernel::GetKernelTable<T>().tanh_deriv_(output.size(), output.data(),
+                                            delta.data());
   }
   ActivateType GetActivateType() override { return ACTIVATE_TANH; }
 };
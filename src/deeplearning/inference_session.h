@@ -0,0 +1,41 @@
+#pragma once
+#include "neural_network.h"
+#include <string>
+#include <vector>
+namespace deeplearning {
+
+// read only view of a trained network plus its own forward buffer. create
+// one session per thread, all sessions can share one network as long as the
+// network is not trained or imported at the same time
+template <typename T> class BasicInferenceSession {
+public:
+  using Network = BasicNeuralNetwork<T>;
+  using Matrix = typename Network::Matrix;
+  using RC = typename Network::RC;
+
+  explicit BasicInferenceSession(const Network &network) : network_(network) {}
+
+  inline RC Predict(const std::vector<T> &data, std::vector<T> &result) {
+    return network_.Predict(data, result, workspace_);
+  }
+
+  inline RC Predict(Span<const T> data, Span<T> result) {
+    return network_.Predict(data, result, workspace_);
+  }
+
+  inline RC PredictBatch(const Matrix &inputs, Matrix &outputs) {
+    return network_.PredictBatch(inputs, outputs, workspace_);
+  }
+
+  inline const Network &network() const { return network_; }
+  inline std::string err_msg() { return workspace_.err_msg(); }
+
+private:
+  const Network &network_;
+  typename Network::Workspace workspace_;
+};
+
+using InferenceSession = BasicInferenceSession<double>;
+using FloatInferenceSession = BasicInferenceSession<float>;
+
+} // namespace deeplearning
@@ -0,0 +1,155 @@
+#pragma once
+#include "kernel_base.h"
+#include <cstdlib>
+#include <cstring>
+
+#if DL_KERNEL_X86
+#include <cpuid.h>
+#endif
+
+namespace deeplearning {
+namespace kernel {
+
+// ordered, every level imply all lower one
+enum CpuIsa {
+  CPU_ISA_SCALAR,
+  CPU_ISA_SSE42,
+  CPU_ISA_AVX2,
+  CPU_ISA_AVX512,
+};
+
+class CpuFeature {
+public:
+  // env to pin a lower isa, value is one of IsaName(), e.g. "avx2"
+  static constexpr const char *kIsaEnvName = "DEEPLEARNING_ISA";
+
+  // best isa both cpu and os support, cpuid only run once
+  static CpuIsa DetectIsa() {
+    static const CpuIsa isa = RunCpuid();
+    return isa;
+  }
+
+  // isa kernel should use: detected one, lower by env if set, never higher
+  static CpuIsa ActiveIsa() {
+    static const CpuIsa isa = [] {
+      CpuIsa detect = DetectIsa();
+      CpuIsa env = detect;
+      if (!ParseIsa(std::getenv(kIsaEnvName), env)) {
+        return detect;
+      }
+      return env < detect ? env : detect;
+    }();
+    return isa;
+  }
+
+  // avx512 bf16 dot instruction, only used when avx512 is the active isa
+  static bool HasAvx512Bf16() {
+    static const bool bf16 = ActiveIsa() == CPU_ISA_AVX512 && RunBf16Cpuid();
+    return bf16;
+  }
+
+  // avx512 vnni int8 dot instruction with avx512bw, same condition
+  static bool HasAvx512Vnni() {
+    static const bool vnni = ActiveIsa() == CPU_ISA_AVX512 && RunVnniCpuid();
+    return vnni;
+  }
+
+  static bool ParseIsa(const char *name, CpuIsa &isa) {
+    if (name == nullptr) {
+      return false;
+    }
+    for (int i = CPU_ISA_SCALAR; i <= CPU_ISA_AVX512; i++) {
+      if (std::strcmp(name, IsaName((CpuIsa)i)) == 0) {
+        isa = (CpuIsa)i;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static const char *IsaName(CpuIsa isa) {
+    switch (isa) {
+    case CPU_ISA_SCALAR:
+      return "scalar";
+    case CPU_ISA_SSE42:
+      return "sse42";
+    case CPU_ISA_AVX2:
+      return "avx2";
+    case CPU_ISA_AVX512:
+      return "avx512";
+    }
+    return "unknown";
+  }
+
+private:
+  static bool RunBf16Cpuid() {
+#if DL_KERNEL_X86
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid_max(0, nullptr) < 7) {
+      return false;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    // eax of leaf 7 subleaf 0 is the max subleaf
+    if (eax < 1) {
+      return false;
+    }
+    __cpuid_count(7, 1, eax, ebx, ecx, edx);
+    return eax & (1 << 5);
+#else
+    return false;
+#endif
+  }
+
+  static bool RunVnniCpuid() {
+#if DL_KERNEL_X86
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (__get_cpuid_max(0, nullptr) < 7) {
+      return false;
+    }
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    return (ebx & bit_AVX512BW) && (ecx & (1 << 11));
+#else
+    return false;
+#endif
+  }
+
+  static CpuIsa RunCpuid() {
+#if DL_KERNEL_X86
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+      return CPU_ISA_SCALAR;
+    }
+    bool sse42 = ecx & bit_SSE4_2;
+    bool fma = ecx & bit_FMA;
+    // os must save the ymm / zmm register on context switch
+    unsigned long long xcr0 = 0;
+    if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX)) {
+      unsigned int low = 0, high = 0;
+      __asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+      xcr0 = ((unsigned long long)high << 32) | low;
+    }
+    bool ymm_state = (xcr0 & 0x6) == 0x6;
+    bool zmm_state = (xcr0 & 0xe6) == 0xe6;
+
+    bool avx2 = false, avx512 = false;
+    if (__get_cpuid_max(0, nullptr) >= 7) {
+      __cpuid_count(7, 0, eax, ebx, ecx, edx);
+      avx2 = ebx & bit_AVX2;
+      avx512 = ebx & bit_AVX512F;
+    }
+    if (avx512 && avx2 && fma && zmm_state) {
+      return CPU_ISA_AVX512;
+    }
+    if (avx2 && fma && ymm_state) {
+      return CPU_ISA_AVX2;
+    }
+    if (sse42) {
+      return CPU_ISA_SSE42;
+    }
+#endif
+    return CPU_ISA_SCALAR;
+  }
+};
+
+} // namespace kernel
+} // namespace deeplearning
@@ -0,0 +1,150 @@
+#pragma once
+#include "cpu_feature.h"
+#include "elementwise_scalar.h"
+#include "gemm_scalar.h"
+#include "kernel_base.h"
+#include "simd_avx2.h"
+#include "simd_avx512.h"
+#include "simd_sse42.h"
+
+namespace deeplearning {
+namespace kernel {
+
+// kernel of one isa, bind once and call through function pointer
+template <typename T> struct KernelTable {
+  CpuIsa isa_;
+  void (*gemm_)(bool trans_a, bool trans_b, int m, int n, int k, T alpha,
+                const T *a, int lda, const T *b, int ldb, T beta, T *c,
+                int ldc);
+  // same as gemm_ with a and b rounded to bf16 and a float accumulator,
+  // native_bf16_ tell if the cpu instruction is used or it is emulated
+  void (*gemm_bf16_)(bool trans_a, bool trans_b, int m, int n, int k, T alpha,
+                     const T *a, int lda, const T *b, int ldb, T beta, T *c,
+                     int ldc);
+  bool native_bf16_;
+  // y[i] = sum of x[p] * w[i][p] in int32, k a multiple of kInt8Align and
+  // x below 128. vnni_ tell if the avx512 vnni instruction is used
+  void (*int8_gemv_)(int rows, int k, const std::uint8_t *x,
+                     const std::int8_t *w, int ldw, std::int32_t *y);
+  bool vnni_;
+  void (*gemv_)(bool trans, int m, int k, T alpha, const T *a, int lda,
+                const T *x, T beta, T *y);
+  void (*relu_)(int n, const T *input, T *output);
+  // transcendental kernel, index by MathAccuracy
+  void (*exp_[kMathAccuracyNum])(int n, const T *input, T *output);
+  void (*sigmoid_[kMathAccuracyNum])(int n, const T *input, T *output);
+  void (*tanh_[kMathAccuracyNum])(int n, const T *input, T *output);
+  // row-wise softmax of a rows x cols matrix, input may alias output
+  void (*softmax_[kMathAccuracyNum])(int rows, int cols, const T *input,
+                                     T *output);
+  // delta *= activate'(output)
+  void (*relu_deriv_)(int n, const T *output, T *delta);
+  void (*sigmoid_deriv_)(int n, const T *output, T *delta);
+  void (*tanh_deriv_)(int n, const T *output, T *delta);
+  void (*sgd_update_)(int n, T learning_rate, const T *grad, T *weight);
+  void (*momentum_update_)(int n, T learning_rate, T momentum, const T *grad,
+                           T *velocity, T *weight);
+  void (*adam_update_)(int n, const AdaptiveParam<T> &param, const T *grad,
+                       T *moment1, T *moment2, T *weight);
+  void (*rmsprop_update_)(int n, const AdaptiveParam<T> &param, const T *grad,
+                          T *moment2, T *weight);
+};
+
+template <typename T> KernelTable<T> CreateScalarKernelTable() {
+  KernelTable<T> table;
+  table.isa_ = CPU_ISA_SCALAR;
+  table.gemm_ = GemmBlocked<ScalarGemmKernel<T>, T>;
+  table.gemm_bf16_ = GemmBlockedBf16<ScalarGemmBf16Kernel<T>, T>;
+  table.native_bf16_ = false;
+  table.int8_gemv_ = Int8GemvScalar;
+  table.vnni_ = false;
+  table.gemv_ = GemvScalar<T>;
+  table.relu_ = ReluScalar<T>;
+  for (int i = 0; i < kMathAccuracyNum; i++) {
+    table.exp_[i] = ExpScalar<T>;
+    table.sigmoid_[i] = SigmoidScalar<T>;
+    table.tanh_[i] = TanhScalar<T>;
+    table.softmax_[i] = SoftmaxScalar<T>;
+  }
+  table.relu_deriv_ = ReluDerivScalar<T>;
+  table.sigmoid_deriv_ = SigmoidDerivScalar<T>;
+  table.tanh_deriv_ = TanhDerivScalar<T>;
+  table.sgd_update_ = SgdUpdateScalar<T>;
+  table.momentum_update_ = MomentumUpdateScalar<T>;
+  table.adam_update_ = AdamUpdateScalar<T>;
+  table.rmsprop_update_ = RmspropUpdateScalar<T>;
+  return table;
+}
+
+#define DL_BIND_MATH_KERNEL(table, ns, T, accuracy)                           \
+  do {                                                                         \
+    table.exp_[accuracy] = ns::Exp<T, accuracy>;                               \
+    table.sigmoid_[accuracy] = ns::Sigmoid<T, accuracy>;                       \
+    table.tanh_[accuracy] = ns::Tanh<T, accuracy>;                             \
+    table.softmax_[accuracy] = ns::Softmax<T, accuracy>;                       \
+  } while (0)
+
+#define DL_BIND_SIMD_KERNEL(table, ns, T)                                     \
+  do {                                                                         \
+    table.gemm_ = ns::Gemm<T>;                                                 \
+    table.gemm_bf16_ = ns::GemmBf16<T>;                                        \
+    table.gemv_ = ns::Gemv<T>;                                                 \
+    table.relu_ = ns::Relu<T>;                                                 \
+    DL_BIND_MATH_KERNEL(table, ns, T, MATH_ACCURACY_EXACT);                    \
+    DL_BIND_MATH_KERNEL(table, ns, T, MATH_ACCURACY_HIGH);                     \
+    DL_BIND_MATH_KERNEL(table, ns, T, MATH_ACCURACY_FAST);                     \
+    table.relu_deriv_ = ns::ReluDeriv<T>;                                      \
+    table.sigmoid_deriv_ = ns::SigmoidDeriv<T>;                                \
+    table.tanh_deriv_ = ns::TanhDeriv<T>;                                      \
+    table.sgd_update_ = ns::SgdUpdate<T>;                                      \
+    table.momentum_update_ = ns::MomentumUpdate<T>;                            \
+    table.adam_update_ = ns::AdamUpdate<T>;                                    \
+    table.rmsprop_update_ = ns::RmspropUpdate<T>;                              \
+  } while (0)
+
+// table for isa, caller must make sure the cpu support it
+template <typename T> KernelTable<T> CreateKernelTable(CpuIsa isa) {
+  KernelTable<T> table = CreateScalarKernelTable<T>();
+#if DL_KERNEL_X86
+  switch (isa) {
+  case CPU_ISA_AVX512:
+    DL_BIND_SIMD_KERNEL(table, avx512, T);
+    if (CpuFeature::HasAvx512Bf16()) {
+      table.gemm_bf16_ = avx512::GemmBf16Native<T>;
+      table.native_bf16_ = true;
+    }
+    // maddubs of avx512 need avx512bw, without vnni the avx2 one is used
+    table.int8_gemv_ = avx2::Int8Gemv;
+    if (CpuFeature::HasAvx512Vnni()) {
+      table.int8_gemv_ = avx512::Int8GemvVnni;
+      table.vnni_ = true;
+    }
+    break;
+  case CPU_ISA_AVX2:
+    DL_BIND_SIMD_KERNEL(table, avx2, T);
+    table.int8_gemv_ = avx2::Int8Gemv;
+    break;
+  case CPU_ISA_SSE42:
+    DL_BIND_SIMD_KERNEL(table, sse42, T);
+    table.int8_gemv_ = sse42::Int8Gemv;
+    break;
+  default:
+    return table;
+  }
+  table.isa_ = isa;
+#endif
+  return table;
+}
+
+#undef DL_BIND_SIMD_KERNEL
+#undef DL_BIND_MATH_KERNEL
+
+// table of CpuFeature::ActiveIsa(), build on first use
+template <typename T> const KernelTable<T> &GetKernelTable() {
+  static const KernelTable<T> table =
+      CreateKernelTable<T>(CpuFeature::ActiveIsa());
+  return table;
+}
+
+} // namespace kernel
+} // namespace deeplearning
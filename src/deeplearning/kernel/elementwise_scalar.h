@@ -0,0 +1,115 @@
+#pragma once
+#include "kernel_base.h"
+#include <cmath>
+#include <cstddef>
+
+namespace deeplearning {
+namespace kernel {
+
+template <typename T> void ReluScalar(int n, const T *input, T *output) {
+  for (int i = 0; i < n; i++) {
+    output[i] = input[i] > 0 ? input[i] : 0;
+  }
+}
+
+// scalar fallback always use libm, it meet every MathAccuracy tier
+template <typename T> void ExpScalar(int n, const T *input, T *output) {
+  for (int i = 0; i < n; i++) {
+    output[i] = std::exp(input[i]);
+  }
+}
+
+template <typename T> void SigmoidScalar(int n, const T *input, T *output) {
+  for (int i = 0; i < n; i++) {
+    output[i] = 1 / (1 + std::exp(-input[i]));
+  }
+}
+
+template <typename T> void TanhScalar(int n, const T *input, T *output) {
+  for (int i = 0; i < n; i++) {
+    output[i] = std::tanh(input[i]);
+  }
+}
+
+template <typename T>
+void SoftmaxScalar(int rows, int cols, const T *input, T *output) {
+  for (int r = 0; r < rows; r++) {
+    const T *in = input + (std::size_t)r * cols;
+    T *out = output + (std::size_t)r * cols;
+    T max = cols > 0 ? in[0] : 0;
+    for (int i = 1; i < cols; i++) {
+      max = in[i] > max ? in[i] : max;
+    }
+    T sum = 0;
+    for (int i = 0; i < cols; i++) {
+      out[i] = std::exp(in[i] - max);
+      sum += out[i];
+    }
+    for (int i = 0; i < cols; i++) {
+      out[i] /= sum;
+    }
+  }
+}
+
+template <typename T> void ReluDerivScalar(int n, const T *output, T *delta) {
+  for (int i = 0; i < n; i++) {
+    delta[i] = output[i] > 0 ? delta[i] : 0;
+  }
+}
+
+template <typename T>
+void SigmoidDerivScalar(int n, const T *output, T *delta) {
+  for (int i = 0; i < n; i++) {
+    delta[i] *= output[i] * (1 - output[i]);
+  }
+}
+
+template <typename T> void TanhDerivScalar(int n, const T *output, T *delta) {
+  for (int i = 0; i < n; i++) {
+    delta[i] *= 1 - output[i] * output[i];
+  }
+}
+
+template <typename T>
+void SgdUpdateScalar(int n, T learning_rate, const T *grad, T *weight) {
+  for (int i = 0; i < n; i++) {
+    weight[i] -= learning_rate * grad[i];
+  }
+}
+
+template <typename T>
+void MomentumUpdateScalar(int n, T learning_rate, T momentum, const T *grad,
+                          T *velocity, T *weight) {
+  for (int i = 0; i < n; i++) {
+    velocity[i] = momentum * velocity[i] - learning_rate * grad[i];
+    weight[i] += velocity[i];
+  }
+}
+
+template <typename T>
+void AdamUpdateScalar(int n, const AdaptiveParam<T> &param, const T *grad,
+                      T *moment1, T *moment2, T *weight) {
+  for (int i = 0; i < n; i++) {
+    T g = grad[i] * param.grad_scale_;
+    moment1[i] = param.beta1_ * moment1[i] + (1 - param.beta1_) * g;
+    moment2[i] = param.beta2_ * moment2[i] + (1 - param.beta2_) * g * g;
+    T denom = std::sqrt(moment2[i]) * param.correction2_ + param.eps_;
+    weight[i] = weight[i] * (1 - param.decay_) -
+                param.step_size_ * moment1[i] / denom;
+  }
+}
+
+// adam without first moment, beta1 and decay are not used
+template <typename T>
+void RmspropUpdateScalar(int n, const AdaptiveParam<T> &param, const T *grad,
+                         T *moment2, T *weight) {
+  for (int i = 0; i < n; i++) {
+    T g = grad[i] * param.grad_scale_;
+    moment2[i] = param.beta2_ * moment2[i] + (1 - param.beta2_) * g * g;
+    T denom = std::sqrt(moment2[i]) * param.correction2_ + param.eps_;
+    weight[i] -= param.step_size_ * g / denom;
+  }
+}
+
+} // namespace kernel
+} // namespace deeplearning
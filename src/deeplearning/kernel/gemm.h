@@ -0,0 +1,64 @@
+#pragma once
+#include "../util/matrix.h"
+#include "../util/thread_pool.h"
+#include "dispatch.h"
+
+namespace deeplearning {
+namespace kernel {
+
+// c = alpha * op(a) * op(b) + beta * c, all matrix row-major, op(a) is m x k
+// and op(b) is k x n, beta == 0 never read c
+template <typename T>
+void Gemm(bool trans_a, bool trans_b, int m, int n, int k, T alpha,
+          const T *a, int lda, const T *b, int ldb, T beta, T *c, int ldc) {
+  GetKernelTable<T>().gemm_(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb,
+                            beta, c, ldc);
+}
+
+// Gemm with a and b rounded to bf16 and accumulate in float, half the
+// operand byte of a float gemm
+template <typename T>
+void GemmBf16(bool trans_a, bool trans_b, int m, int n, int k, T alpha,
+              const T *a, int lda, const T *b, int ldb, T beta, T *c,
+              int ldc) {
+  GetKernelTable<T>().gemm_bf16_(trans_a, trans_b, m, n, k, alpha, a, lda, b,
+                                 ldb, beta, c, ldc);
+}
+
+// y = alpha * op(a) * x + beta * y, a is m x k row-major
+template <typename T>
+void Gemv(bool trans, int m, int k, T alpha, const T *a, int lda, const T *x,
+          T beta, T *y) {
+  GetKernelTable<T>().gemv_(trans, m, k, alpha, a, lda, x, beta, y);
+}
+
+// result = op(left) * op(right), result is reshape to fit. bf16 run the
+// product through GemmBf16
+template <typename T>
+void MatMul(const Matrix<T> &left, bool trans_left, const Matrix<T> &right,
+            bool trans_right, Matrix<T> &result, bool bf16 = false) {
+  auto gemm = bf16 ? GemmBf16<T> : Gemm<T>;
+  int m = trans_left ? left.cols() : left.rows();
+  int k = trans_left ? left.rows() : left.cols();
+  int n = trans_right ? right.rows() : right.cols();
+  result.Reshape(m, n);
+  // big product split its result row between the pool thread, small one
+  // is cheaper than the task hand off
+  const int row_block = 32;
+  const long long parallel_work = 1 << 20;
+  if ((long long)m * n * k < parallel_work || m < 2 * row_block) {
+    gemm(trans_left, trans_right, m, n, k, 1, left.data(), left.cols(),
+         right.data(), right.cols(), 0, result.data(), n);
+    return;
+  }
+  ThreadPool::Global().ParallelFor(0, m, row_block, [&](int begin, int end) {
+    const T *a = trans_left ? left.data() + begin
+                            : left.data() + (std::size_t)begin * left.cols();
+    gemm(trans_left, trans_right, end - begin, n, k, 1, a, left.cols(),
+         right.data(), right.cols(), 0, result.data() + (std::size_t)begin * n,
+         n);
+  });
+}
+
+} // namespace kernel
+} // namespace deeplearning
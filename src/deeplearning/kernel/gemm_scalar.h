@@ -0,0 +1,98 @@
+#pragma once
+#include "kernel_base.h"
+
+namespace deeplearning {
+namespace kernel {
+
+// portable micro kernel, a 4 x 4 accumulator tile the compiler keep in
+// register
+template <typename T> struct ScalarGemmKernel {
+  static constexpr int kMr = 4;
+  static constexpr int kNr = 4;
+  static constexpr int kMc = 128;
+  static constexpr int kKc = 256;
+  static constexpr int kNc = 2048;
+
+  static void Run(int kc, const T *a, const T *b, T *c, int ldc, int m, int n,
+                  T beta) {
+    T acc[kMr][kNr] = {};
+    for (int p = 0; p < kc; p++) {
+      for (int i = 0; i < kMr; i++) {
+        for (int j = 0; j < kNr; j++) {
+          acc[i][j] += a[i] * b[j];
+        }
+      }
+      a += kMr;
+      b += kNr;
+    }
+    StoreTile(&acc[0][0], kNr, c, ldc, m, n, beta);
+  }
+};
+
+// bf16 emulated by widen each value to float, same pair layout as the
+// native instruction so the packing is shared
+template <typename T> struct ScalarGemmBf16Kernel {
+  static constexpr int kMr = 4;
+  static constexpr int kNr = 4;
+  static constexpr int kMc = 128;
+  static constexpr int kKc = 256;
+  static constexpr int kNc = 2048;
+
+  static void Run(int pair_num, const std::uint16_t *a, const std::uint16_t *b,
+                  T *c, int ldc, int m, int n, T beta) {
+    float acc[kMr][kNr] = {};
+    for (int p = 0; p < pair_num; p++) {
+      for (int i = 0; i < kMr; i++) {
+        float a0 = Bf16ToFloat(a[i * 2]), a1 = Bf16ToFloat(a[i * 2 + 1]);
+        for (int j = 0; j < kNr; j++) {
+          acc[i][j] += a0 * Bf16ToFloat(b[j * 2]);
+          acc[i][j] += a1 * Bf16ToFloat(b[j * 2 + 1]);
+        }
+      }
+      a += kMr * 2;
+      b += kNr * 2;
+    }
+    StoreTile(&acc[0][0], kNr, c, ldc, m, n, beta);
+  }
+};
+
+// y = alpha * op(a) * x + beta * y, a is m x k row-major
+template <typename T>
+void GemvScalar(bool trans, int m, int k, T alpha, const T *a, int lda,
+                const T *x, T beta, T *y) {
+  if (!trans) {
+    for (int i = 0; i < m; i++) {
+      const T *a_row = a + (std::size_t)i * lda;
+      T sum = 0;
+      for (int p = 0; p < k; p++) {
+        sum += a_row[p] * x[p];
+      }
+      y[i] = alpha * sum + (beta == 0 ? 0 : beta * y[i]);
+    }
+    return;
+  }
+  ScaleMatrix(1, k, beta, y, k);
+  for (int i = 0; i < m; i++) {
+    const T *a_row = a + (std::size_t)i * lda;
+    T value = alpha * x[i];
+    for (int p = 0; p < k; p++) {
+      y[p] += value * a_row[p];
+    }
+  }
+}
+
+// y[i] = sum of x[p] * w[i][p], u8 input and s8 weight in int32
+inline void Int8GemvScalar(int rows, int k, const std::uint8_t *x,
+                           const std::int8_t *w, int ldw, std::int32_t *y) {
+  for (int i = 0; i < rows; i++) {
+    const std::int8_t *row = w + (std::size_t)i * ldw;
+    std::int32_t sum = 0;
+    for (int p = 0; p < k; p++) {
+      sum += (std::int32_t)x[p] * row[p];
+    }
+    y[i] = sum;
+  }
+}
+
+} // namespace kernel
+} // namespace deeplearning
@@ -0,0 +1,337 @@
+#pragma once
+#include "../util/matrix.h"
+#include "../util/reduced_float.h"
+#include "math_accuracy.h"
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DL_KERNEL_X86 1
+#include <immintrin.h>
+// each isa kernel is compiled by target attribute, so one binary build
+// without -march flag still carry every kernel and pick one at runtime
+#define DL_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define DL_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define DL_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#define DL_TARGET_AVX512_BF16                                                  \
+  __attribute__((target("avx512bf16,avx512bw,avx512f,avx2,fma")))
+#define DL_TARGET_AVX512_VNNI                                                  \
+  __attribute__((target("avx512vnni,avx512bw,avx512f,avx2,fma")))
+#else
+#define DL_KERNEL_X86 0
+#endif
+
+namespace deeplearning {
+namespace kernel {
+
+// constant of vector exp, e^x = 2^n * e^r with x = n * ln2 + r, |r| <= ln2/2
+// and e^r by taylor series, ln2 split in hi + lo so n * hi is exact.
+// MATH_ACCURACY_HIGH and MATH_ACCURACY_FAST cut the series earlier
+template <typename T> struct ExpConst;
+
+template <> struct ExpConst<double> {
+  static constexpr double kMin = -708;
+  static constexpr double kMax = 709;
+  static constexpr double kLog2e = 1.4426950408889634;
+  static constexpr double kLn2Hi = 0.693145751953125;
+  static constexpr double kLn2Lo = 1.4286068203094173e-06;
+  // 1 / k!, truncation error of degree 13 is under 1e-17
+  static constexpr int kDegree = 13;
+  static constexpr int kHighDegree = 7;
+  static constexpr int kFastDegree = 4;
+  static constexpr double kTaylor[kDegree + 1] = {
+      1.0,
+      1.0,
+      1.0 / 2,
+      1.0 / 6,
+      1.0 / 24,
+      1.0 / 120,
+      1.0 / 720,
+      1.0 / 5040,
+      1.0 / 40320,
+      1.0 / 362880,
+      1.0 / 3628800,
+      1.0 / 39916800,
+      1.0 / 479001600,
+      1.0 / 6227020800,
+  };
+};
+
+template <> struct ExpConst<float> {
+  static constexpr float kMin = -87;
+  static constexpr float kMax = 88;
+  static constexpr float kLog2e = 1.44269504f;
+  static constexpr float kLn2Hi = 0.693359375f;
+  static constexpr float kLn2Lo = -2.12194440e-4f;
+  static constexpr int kDegree = 7;
+  static constexpr int kHighDegree = 6;
+  static constexpr int kFastDegree = 4;
+  static constexpr float kTaylor[kDegree + 1] = {
+      1.0f, 1.0f, 1.0f / 2, 1.0f / 6, 1.0f / 24, 1.0f / 120, 1.0f / 720,
+      1.0f / 5040,
+  };
+};
+
+// k of an int8 gemv must be a multiple of it, the widest register in byte.
+// caller zero pad both the row and the input
+constexpr int kInt8Align = 64;
+
+// one step of the adaptive optimizer, every value is folded on the caller
+// side so the kernel stay a single pass:
+// g = grad * grad_scale, m = beta1 * m + (1 - beta1) * g,
+// v = beta2 * v + (1 - beta2) * g * g, weight *= 1 - decay,
+// weight -= step_size * m / (sqrt(v) * correction2 + eps)
+template <typename T> struct AdaptiveParam {
+  T grad_scale_;
+  T beta1_;
+  T beta2_;
+  // learning rate over the first moment bias correction
+  T step_size_;
+  // 1 / sqrt(1 - beta2^t)
+  T correction2_;
+  T eps_;
+  // learning rate * decoupled weight decay
+  T decay_;
+};
+
+// write a computed m x n tile back to c, c = tile + beta * c. the tile may be
+// the float accumulator of a bf16 kernel
+template <typename Acc, typename T>
+inline void StoreTile(const Acc *tile, int tile_ld, T *c, int ldc, int m, int n,
+                      T beta) {
+  for (int i = 0; i < m; i++) {
+    T *c_row = c + (std::size_t)i * ldc;
+    const Acc *tile_row = tile + (std::size_t)i * tile_ld;
+    if (beta == 0) {
+      std::copy(tile_row, tile_row + n, c_row);
+    } else {
+      for (int j = 0; j < n; j++) {
+        c_row[j] = tile_row[j] + beta * c_row[j];
+      }
+    }
+  }
+}
+
+template <typename T>
+inline void ScaleMatrix(int m, int n, T beta, T *c, int ldc) {
+  for (int i = 0; i < m; i++) {
+    T *c_row = c + (std::size_t)i * ldc;
+    for (int j = 0; j < n; j++) {
+      c_row[j] = beta == 0 ? 0 : beta * c_row[j];
+    }
+  }
+}
+
+// copy op(a)[row..row+m, col..col+k] * alpha into mr tall panels, each
+// panel store k columns of mr contiguous value, zero padded at the edge
+template <int MR, typename T>
+void PackA(bool trans, int m, int k, T alpha, const T *a, int lda, int row,
+           int col, AlignedVector<T> &packed) {
+  int panel_num = (m + MR - 1) / MR;
+  packed.resize((std::size_t)panel_num * MR * k);
+  for (int ir = 0; ir < m; ir += MR) {
+    T *panel = packed.data() + (std::size_t)ir * k;
+    int rows = std::min(MR, m - ir);
+    for (int r = 0; r < MR; r++) {
+      int i = row + ir + r;
+      // walk the source along its contiguous direction
+      for (int p = 0; p < k; p++) {
+        T value = 0;
+        if (r < rows) {
+          value = trans ? a[(std::size_t)(col + p) * lda + i]
+                        : a[(std::size_t)i * lda + col + p];
+        }
+        panel[p * MR + r] = alpha * value;
+      }
+    }
+  }
+}
+
+// copy op(b)[row..row+k, col..col+n] into nr wide panels, each panel store k
+// rows of nr contiguous value, zero padded at the edge
+template <int NR, typename T>
+void PackB(bool trans, int k, int n, const T *b, int ldb, int row, int col,
+           AlignedVector<T> &packed) {
+  int panel_num = (n + NR - 1) / NR;
+  packed.resize((std::size_t)panel_num * NR * k);
+  for (int jr = 0; jr < n; jr += NR) {
+    T *panel = packed.data() + (std::size_t)jr * k;
+    int cols = std::min(NR, n - jr);
+    if (!trans) {
+      for (int p = 0; p < k; p++) {
+        const T *src = b + (std::size_t)(row + p) * ldb + col + jr;
+        std::copy(src, src + cols, panel + p * NR);
+        std::fill(panel + p * NR + cols, panel + (p + 1) * NR, T(0));
+      }
+      continue;
+    }
+    for (int c = 0; c < NR; c++) {
+      if (c >= cols) {
+        for (int p = 0; p < k; p++) {
+          panel[p * NR + c] = 0;
+        }
+        continue;
+      }
+      const T *src = b + (std::size_t)(col + jr + c) * ldb + row;
+      for (int p = 0; p < k; p++) {
+        panel[p * NR + c] = src[p];
+      }
+    }
+  }
+}
+
+// goto style blocked gemm, c = alpha * op(a) * op(b) + beta * c, row-major
+// Kernel supply the register tile size, cache block size and micro kernel
+template <typename Kernel, typename T>
+void GemmBlocked(bool trans_a, bool trans_b, int m, int n, int k, T alpha,
+                 const T *a, int lda, const T *b, int ldb, T beta, T *c,
+                 int ldc) {
+  constexpr int mr = Kernel::kMr, nr = Kernel::kNr;
+  if (m <= 0 || n <= 0) {
+    return;
+  }
+  if (k <= 0 || alpha == 0) {
+    ScaleMatrix(m, n, beta, c, ldc);
+    return;
+  }
+  // packing buffer is reuse between call, so steady state has no allocation
+  thread_local AlignedVector<T> packed_a, packed_b;
+  for (int jc = 0; jc < n; jc += Kernel::kNc) {
+    int nc = std::min(Kernel::kNc, n - jc);
+    for (int pc = 0; pc < k; pc += Kernel::kKc) {
+      int kc = std::min(Kernel::kKc, k - pc);
+      T block_beta = pc == 0 ? beta : T(1);
+      PackB<nr>(trans_b, kc, nc, b, ldb, pc, jc, packed_b);
+      for (int ic = 0; ic < m; ic += Kernel::kMc) {
+        int mc = std::min(Kernel::kMc, m - ic);
+        PackA<mr>(trans_a, mc, kc, alpha, a, lda, ic, pc, packed_a);
+        for (int jr = 0; jr < nc; jr += nr) {
+          for (int ir = 0; ir < mc; ir += mr) {
+            Kernel::Run(kc, packed_a.data() + (std::size_t)ir * kc,
+                        packed_b.data() + (std::size_t)jr * kc,
+                        c + (std::size_t)(ic + ir) * ldc + jc + jr, ldc,
+                        std::min(mr, mc - ir), std::min(nr, nc - jr),
+                        block_beta);
+          }
+        }
+      }
+    }
+  }
+}
+
+// bf16 packing keep k in pair, the layout of vdpbf16ps: panel[p][r][e] is
+// op(a)[r][2p + e] for mr tall panel, zero padded past m and k
+template <int MR, typename T>
+void PackABf16(bool trans, int m, int k, T alpha, const T *a, int lda, int row,
+               int col, AlignedVector<std::uint16_t> &packed) {
+  int pair_num = (k + 1) / 2;
+  int panel_num = (m + MR - 1) / MR;
+  packed.assign((std::size_t)panel_num * MR * pair_num * 2, 0);
+  for (int ir = 0; ir < m; ir += MR) {
+    std::uint16_t *panel = packed.data() + (std::size_t)ir * pair_num * 2;
+    int rows = std::min(MR, m - ir);
+    if (trans) {
+      for (int p = 0; p < k; p++) {
+        const T *src = a + (std::size_t)(col + p) * lda + row + ir;
+        std::uint16_t *out = panel + (std::size_t)(p / 2) * MR * 2 + p % 2;
+        for (int r = 0; r < rows; r++) {
+          out[r * 2] = FloatToBf16(alpha * src[r]);
+        }
+      }
+      continue;
+    }
+    for (int r = 0; r < rows; r++) {
+      const T *src = a + (std::size_t)(row + ir + r) * lda + col;
+      std::uint16_t *out = panel + r * 2;
+      for (int p = 0; p < k; p++) {
+        out[(std::size_t)(p / 2) * MR * 2 + p % 2] =
+            FloatToBf16(alpha * src[p]);
+      }
+    }
+  }
+}
+
+// panel[p][c][e] is op(b)[2p + e][c] for nr wide panel
+template <int NR, typename T>
+void PackBBf16(bool trans, int k, int n, const T *b, int ldb, int row, int col,
+               AlignedVector<std::uint16_t> &packed) {
+  int pair_num = (k + 1) / 2;
+  int panel_num = (n + NR - 1) / NR;
+  packed.assign((std::size_t)panel_num * NR * pair_num * 2, 0);
+  for (int jr = 0; jr < n; jr += NR) {
+    std::uint16_t *panel = packed.data() + (std::size_t)jr * pair_num * 2;
+    int cols = std::min(NR, n - jr);
+    // walk the source along its contiguous direction
+    if (!trans) {
+      for (int p = 0; p < k; p++) {
+        const T *src = b + (std::size_t)(row + p) * ldb + col + jr;
+        std::uint16_t *out = panel + (std::size_t)(p / 2) * NR * 2 + p % 2;
+        for (int c = 0; c < cols; c++) {
+          out[c * 2] = FloatToBf16(src[c]);
+        }
+      }
+      continue;
+    }
+    // a pair is contiguous in the source too, so write the panel in order
+    const T *src = b + (std::size_t)(col + jr) * ldb + row;
+    for (int p = 0; p + 1 < k; p += 2) {
+      std::uint16_t *out = panel + (std::size_t)p * NR;
+      for (int c = 0; c < cols; c++) {
+        out[c * 2] = FloatToBf16(src[(std::size_t)c * ldb + p]);
+        out[c * 2 + 1] = FloatToBf16(src[(std::size_t)c * ldb + p + 1]);
+      }
+    }
+    if (k % 2 != 0) {
+      std::uint16_t *out = panel + (std::size_t)(k - 1) * NR;
+      for (int c = 0; c < cols; c++) {
+        out[c * 2] = FloatToBf16(src[(std::size_t)c * ldb + k - 1]);
+      }
+    }
+  }
+}
+
+// GemmBlocked with both operand rounded to bf16 while packing, so the micro
+// kernel read half the byte of a float gemm and accumulate in float. result
+// is the same c = alpha * op(a) * op(b) + beta * c within bf16 precision
+template <typename Kernel, typename T>
+void GemmBlockedBf16(bool trans_a, bool trans_b, int m, int n, int k, T alpha,
+                     const T *a, int lda, const T *b, int ldb, T beta, T *c,
+                     int ldc) {
+  constexpr int mr = Kernel::kMr, nr = Kernel::kNr;
+  // a k block must start on a pair
+  static_assert(Kernel::kKc % 2 == 0, "odd k block");
+  if (m <= 0 || n <= 0) {
+    return;
+  }
+  if (k <= 0 || alpha == 0) {
+    ScaleMatrix(m, n, beta, c, ldc);
+    return;
+  }
+  thread_local AlignedVector<std::uint16_t> packed_a, packed_b;
+  for (int jc = 0; jc < n; jc += Kernel::kNc) {
+    int nc = std::min(Kernel::kNc, n - jc);
+    for (int pc = 0; pc < k; pc += Kernel::kKc) {
+      int kc = std::min(Kernel::kKc, k - pc);
+      int pair_num = (kc + 1) / 2;
+      T block_beta = pc == 0 ? beta : T(1);
+      PackBBf16<nr>(trans_b, kc, nc, b, ldb, pc, jc, packed_b);
+      for (int ic = 0; ic < m; ic += Kernel::kMc) {
+        int mc = std::min(Kernel::kMc, m - ic);
+        PackABf16<mr>(trans_a, mc, kc, alpha, a, lda, ic, pc, packed_a);
+        for (int jr = 0; jr < nc; jr += nr) {
+          for (int ir = 0; ir < mc; ir += mr) {
+            Kernel::Run(pair_num,
+                        packed_a.data() + (std::size_t)ir * pair_num * 2,
+                        packed_b.data() + (std::size_t)jr * pair_num * 2,
+                        c + (std::size_t)(ic + ir) * ldc + jc + jr, ldc,
+                        std::min(mr, mc - ir), std::min(nr, nc - jr),
+                        block_beta);
+          }
+        }
+      }
+    }
+  }
+}
+
+} // namespace kernel
+} // namespace deeplearning
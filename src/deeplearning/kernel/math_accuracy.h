@@ -0,0 +1,18 @@
+#pragma once
+
+namespace deeplearning {
+
+// accuracy tier of the vector exp/sigmoid/tanh kernel, max relative error
+// of exp against libm:
+//   EXACT  a few ulp, taylor series to full precision
+//   HIGH   about 1e-8 (float 1e-7), shorter polynomial
+//   FAST   about 1e-4, degree 4 polynomial
+enum MathAccuracy {
+  MATH_ACCURACY_EXACT,
+  MATH_ACCURACY_HIGH,
+  MATH_ACCURACY_FAST,
+};
+
+constexpr int kMathAccuracyNum = MATH_ACCURACY_FAST + 1;
+
+} // namespace deeplearning
@@ -0,0 +1,177 @@
+#pragma once
+#include "elementwise_scalar.h"
+#include "kernel_base.h"
+
+#if DL_KERNEL_X86
+
+namespace deeplearning {
+namespace kernel {
+namespace avx2 {
+
+template <typename T> struct Vec;
+
+template <> struct Vec<double> {
+  using Type = __m256d;
+  static constexpr int kWidth = 4;
+  DL_TARGET_AVX2 static Type Zero() { return _mm256_setzero_pd(); }
+  DL_TARGET_AVX2 static Type Set1(double value) {
+    return _mm256_set1_pd(value);
+  }
+  DL_TARGET_AVX2 static Type Load(const double *ptr) {
+    return _mm256_loadu_pd(ptr);
+  }
+  DL_TARGET_AVX2 static void Store(double *ptr, Type value) {
+    _mm256_storeu_pd(ptr, value);
+  }
+  DL_TARGET_AVX2 static Type Add(Type a, Type b) { return _mm256_add_pd(a, b); }
+  DL_TARGET_AVX2 static Type Sub(Type a, Type b) { return _mm256_sub_pd(a, b); }
+  DL_TARGET_AVX2 static Type Mul(Type a, Type b) { return _mm256_mul_pd(a, b); }
+  DL_TARGET_AVX2 static Type Fmadd(Type a, Type b, Type c) {
+    return _mm256_fmadd_pd(a, b, c);
+  }
+  DL_TARGET_AVX2 static Type Max(Type a, Type b) { return _mm256_max_pd(a, b); }
+  DL_TARGET_AVX2 static Type Min(Type a, Type b) { return _mm256_min_pd(a, b); }
+  DL_TARGET_AVX2 static Type Div(Type a, Type b) { return _mm256_div_pd(a, b); }
+  DL_TARGET_AVX2 static Type Sqrt(Type a) { return _mm256_sqrt_pd(a); }
+  DL_TARGET_AVX2 static Type Round(Type a) {
+    return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  }
+  // 2^n for integral n in [-1022, 1023], build the exponent bit directly
+  DL_TARGET_AVX2 static Type Pow2(Type n) {
+    auto bits =
+        _mm256_castpd_si256(_mm256_add_pd(n, _mm256_set1_pd(0x1.8p52 + 1023)));
+    return _mm256_castsi256_pd(_mm256_slli_epi64(bits, 52));
+  }
+  // value where key > 0, else 0
+  DL_TARGET_AVX2 static Type KeepPositive(Type key, Type value) {
+    return _mm256_and_pd(_mm256_cmp_pd(key, _mm256_setzero_pd(), _CMP_GT_OQ),
+                         value);
+  }
+  DL_TARGET_AVX2 static double HorizontalSum(Type value) {
+    __m128d low = _mm256_castpd256_pd128(value);
+    low = _mm_add_pd(low, _mm256_extractf128_pd(value, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(low, _mm_unpackhi_pd(low, low)));
+  }
+  DL_TARGET_AVX2 static double HorizontalMax(Type value) {
+    __m128d low = _mm256_castpd256_pd128(value);
+    low = _mm_max_pd(low, _mm256_extractf128_pd(value, 1));
+    return _mm_cvtsd_f64(_mm_max_sd(low, _mm_unpackhi_pd(low, low)));
+  }
+};
+
+template <> struct Vec<float> {
+  using Type = __m256;
+  static constexpr int kWidth = 8;
+  DL_TARGET_AVX2 static Type Zero() { return _mm256_setzero_ps(); }
+  DL_TARGET_AVX2 static Type Set1(float value) { return _mm256_set1_ps(value); }
+  DL_TARGET_AVX2 static Type Load(const float *ptr) {
+    return _mm256_loadu_ps(ptr);
+  }
+  DL_TARGET_AVX2 static void Store(float *ptr, Type value) {
+    _mm256_storeu_ps(ptr, value);
+  }
+  DL_TARGET_AVX2 static Type Add(Type a, Type b) { return _mm256_add_ps(a, b); }
+  DL_TARGET_AVX2 static Type Sub(Type a, Type b) { return _mm256_sub_ps(a, b); }
+  DL_TARGET_AVX2 static Type Mul(Type a, Type b) { return _mm256_mul_ps(a, b); }
+  DL_TARGET_AVX2 static Type Fmadd(Type a, Type b, Type c) {
+    return _mm256_fmadd_ps(a, b, c);
+  }
+  DL_TARGET_AVX2 static Type Max(Type a, Type b) { return _mm256_max_ps(a, b); }
+  DL_TARGET_AVX2 static Type Min(Type a, Type b) { return _mm256_min_ps(a, b); }
+  DL_TARGET_AVX2 static Type Div(Type a, Type b) { return _mm256_div_ps(a, b); }
+  DL_TARGET_AVX2 static Type Sqrt(Type a) { return _mm256_sqrt_ps(a); }
+  DL_TARGET_AVX2 static Type Round(Type a) {
+    return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  }
+  // 2^n for integral n in [-126, 127]
+  DL_TARGET_AVX2 static Type Pow2(Type n) {
+    auto bits =
+        _mm256_castps_si256(_mm256_add_ps(n, _mm256_set1_ps(0x1.8p23f + 127)));
+    return _mm256_castsi256_ps(_mm256_slli_epi32(bits, 23));
+  }
+  DL_TARGET_AVX2 static Type KeepPositive(Type key, Type value) {
+    return _mm256_and_ps(_mm256_cmp_ps(key, _mm256_setzero_ps(), _CMP_GT_OQ),
+                         value);
+  }
+  DL_TARGET_AVX2 static float HorizontalSum(Type value) {
+    __m128 low = _mm256_castps256_ps128(value);
+    low = _mm_add_ps(low, _mm256_extractf128_ps(value, 1));
+    low = _mm_add_ps(low, _mm_movehl_ps(low, low));
+    low = _mm_add_ss(low, _mm_shuffle_ps(low, low, 1));
+    return _mm_cvtss_f32(low);
+  }
+  DL_TARGET_AVX2 static float HorizontalMax(Type value) {
+    __m128 low = _mm256_castps256_ps128(value);
+    low = _mm_max_ps(low, _mm256_extractf128_ps(value, 1));
+    low = _mm_max_ps(low, _mm_movehl_ps(low, low));
+    low = _mm_max_ss(low, _mm_shuffle_ps(low, low, 1));
+    return _mm_cvtss_f32(low);
+  }
+  // kWidth bf16 pair, the first of each pair widen to even and the second
+  // to odd as float
+  DL_TARGET_AVX2 static void LoadBf16Pair(const std::uint16_t *ptr,
+                                         Type &even, Type &odd) {
+    __m256i pair = _mm256_loadu_si256((const __m256i *)ptr);
+    even = _mm256_castsi256_ps(_mm256_slli_epi32(pair, 16));
+    odd = _mm256_castsi256_ps(
+        _mm256_and_si256(pair, _mm256_set1_epi32(0xffff0000)));
+  }
+};
+
+#define DL_KERNEL_TARGET DL_TARGET_AVX2
+#include "simd_kernel_impl.h"
+#undef DL_KERNEL_TARGET
+
+// u8 x s8 int8 gemv, see sse42::Int8Gemv
+DL_TARGET_AVX2 inline __m256i Int8Madd(__m256i acc, __m256i x,
+                                       const std::int8_t *w) {
+  __m256i pair =
+      _mm256_maddubs_epi16(x, _mm256_loadu_si256((const __m256i *)w));
+  return _mm256_add_epi32(acc, _mm256_madd_epi16(pair, _mm256_set1_epi16(1)));
+}
+
+DL_TARGET_AVX2 inline std::int32_t Int8Sum(__m256i value) {
+  __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(value),
+                              _mm256_extracti128_si256(value, 1));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4e));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xb1));
+  return _mm_cvtsi128_si32(sum);
+}
+
+DL_TARGET_AVX2 inline void Int8Gemv(int rows, int k, const std::uint8_t *x,
+                                    const std::int8_t *w, int ldw,
+                                    std::int32_t *y) {
+  int i = 0;
+  for (; i + 4 <= rows; i += 4) {
+    const std::int8_t *w0 = w + (std::size_t)i * ldw;
+    const std::int8_t *w1 = w0 + ldw, *w2 = w1 + ldw, *w3 = w2 + ldw;
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+    __m256i acc2 = _mm256_setzero_si256(), acc3 = _mm256_setzero_si256();
+    for (int p = 0; p < k; p += 32) {
+      __m256i value = _mm256_loadu_si256((const __m256i *)(x + p));
+      acc0 = Int8Madd(acc0, value, w0 + p);
+      acc1 = Int8Madd(acc1, value, w1 + p);
+      acc2 = Int8Madd(acc2, value, w2 + p);
+      acc3 = Int8Madd(acc3, value, w3 + p);
+    }
+    y[i] = Int8Sum(acc0);
+    y[i + 1] = Int8Sum(acc1);
+    y[i + 2] = Int8Sum(acc2);
+    y[i + 3] = Int8Sum(acc3);
+  }
+  for (; i < rows; i++) {
+    const std::int8_t *row = w + (std::size_t)i * ldw;
+    __m256i acc = _mm256_setzero_si256();
+    for (int p = 0; p < k; p += 32) {
+      acc = Int8Madd(acc, _mm256_loadu_si256((const __m256i *)(x + p)),
+                     row + p);
+    }
+    y[i] = Int8Sum(acc);
+  }
+}
+
+} // namespace avx2
+} // namespace kernel
+} // namespace deeplearning
+
+#endif
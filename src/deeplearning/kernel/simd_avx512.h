@@ -0,0 +1,251 @@
+#pragma once
+#include "elementwise_scalar.h"
+#include "kernel_base.h"
+#include <cstring>
+
+#if DL_KERNEL_X86
+
+namespace deeplearning {
+namespace kernel {
+namespace avx512 {
+
+template <typename T> struct Vec;
+
+template <> struct Vec<double> {
+  using Type = __m512d;
+  static constexpr int kWidth = 8;
+  DL_TARGET_AVX512 static Type Zero() { return _mm512_setzero_pd(); }
+  DL_TARGET_AVX512 static Type Set1(double value) {
+    return _mm512_set1_pd(value);
+  }
+  DL_TARGET_AVX512 static Type Load(const double *ptr) {
+    return _mm512_loadu_pd(ptr);
+  }
+  DL_TARGET_AVX512 static void Store(double *ptr, Type value) {
+    _mm512_storeu_pd(ptr, value);
+  }
+  DL_TARGET_AVX512 static Type Add(Type a, Type b) {
+    return _mm512_add_pd(a, b);
+  }
+  DL_TARGET_AVX512 static Type Sub(Type a, Type b) {
+    return _mm512_sub_pd(a, b);
+  }
+  DL_TARGET_AVX512 static Type Mul(Type a, Type b) {
+    return _mm512_mul_pd(a, b);
+  }
+  DL_TARGET_AVX512 static Type Fmadd(Type a, Type b, Type c) {
+    return _mm512_fmadd_pd(a, b, c);
+  }
+  DL_TARGET_AVX512 static Type Max(Type a, Type b) {
+    return _mm512_max_pd(a, b);
+  }
+  DL_TARGET_AVX512 static Type Min(Type a, Type b) {
+    return _mm512_min_pd(a, b);
+  }
+  DL_TARGET_AVX512 static Type Div(Type a, Type b) {
+    return _mm512_div_pd(a, b);
+  }
+  DL_TARGET_AVX512 static Type Sqrt(Type a) { return _mm512_sqrt_pd(a); }
+  DL_TARGET_AVX512 static Type Round(Type a) {
+    return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEAREST_INT |
+                                         _MM_FROUND_NO_EXC);
+  }
+  // 2^n for integral n in [-1022, 1023], build the exponent bit directly
+  DL_TARGET_AVX512 static Type Pow2(Type n) {
+    auto bits = _mm512_castpd_si512(
+        _mm512_add_pd(n, _mm512_set1_pd(0x1.8p52 + 1023)));
+    return _mm512_castsi512_pd(_mm512_slli_epi64(bits, 52));
+  }
+  // value where key > 0, else 0
+  DL_TARGET_AVX512 static Type KeepPositive(Type key, Type value) {
+    return _mm512_maskz_mov_pd(
+        _mm512_cmp_pd_mask(key, _mm512_setzero_pd(), _CMP_GT_OQ), value);
+  }
+  DL_TARGET_AVX512 static double HorizontalSum(Type value) {
+    return _mm512_reduce_add_pd(value);
+  }
+  DL_TARGET_AVX512 static double HorizontalMax(Type value) {
+    return _mm512_reduce_max_pd(value);
+  }
+};
+
+template <> struct Vec<float> {
+  using Type = __m512;
+  static constexpr int kWidth = 16;
+  DL_TARGET_AVX512 static Type Zero() { return _mm512_setzero_ps(); }
+  DL_TARGET_AVX512 static Type Set1(float value) {
+    return _mm512_set1_ps(value);
+  }
+  DL_TARGET_AVX512 static Type Load(const float *ptr) {
+    return _mm512_loadu_ps(ptr);
+  }
+  DL_TARGET_AVX512 static void Store(float *ptr, Type value) {
+    _mm512_storeu_ps(ptr, value);
+  }
+  DL_TARGET_AVX512 static Type Add(Type a, Type b) {
+    return _mm512_add_ps(a, b);
+  }
+  DL_TARGET_AVX512 static Type Sub(Type a, Type b) {
+    return _mm512_sub_ps(a, b);
+  }
+  DL_TARGET_AVX512 static Type Mul(Type a, Type b) {
+    return _mm512_mul_ps(a, b);
+  }
+  DL_TARGET_AVX512 static Type Fmadd(Type a, Type b, Type c) {
+    return _mm512_fmadd_ps(a, b, c);
+  }
+  DL_TARGET_AVX512 static Type Max(Type a, Type b) {
+    return _mm512_max_ps(a, b);
+  }
+  DL_TARGET_AVX512 static Type Min(Type a, Type b) {
+    return _mm512_min_ps(a, b);
+  }
+  DL_TARGET_AVX512 static Type Div(Type a, Type b) {
+    return _mm512_div_ps(a, b);
+  }
+  DL_TARGET_AVX512 static Type Sqrt(Type a) { return _mm512_sqrt_ps(a); }
+  DL_TARGET_AVX512 static Type Round(Type a) {
+    return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT |
+                                         _MM_FROUND_NO_EXC);
+  }
+  // 2^n for integral n in [-126, 127]
+  DL_TARGET_AVX512 static Type Pow2(Type n) {
+    auto bits = _mm512_castps_si512(
+        _mm512_add_ps(n, _mm512_set1_ps(0x1.8p23f + 127)));
+    return _mm512_castsi512_ps(_mm512_slli_epi32(bits, 23));
+  }
+  DL_TARGET_AVX512 static Type KeepPositive(Type key, Type value) {
+    return _mm512_maskz_mov_ps(
+        _mm512_cmp_ps_mask(key, _mm512_setzero_ps(), _CMP_GT_OQ), value);
+  }
+  DL_TARGET_AVX512 static float HorizontalSum(Type value) {
+    return _mm512_reduce_add_ps(value);
+  }
+  DL_TARGET_AVX512 static float HorizontalMax(Type value) {
+    return _mm512_reduce_max_ps(value);
+  }
+  // kWidth bf16 pair, the first of each pair widen to even and the second
+  // to odd as float
+  DL_TARGET_AVX512 static void LoadBf16Pair(const std::uint16_t *ptr,
+                                           Type &even, Type &odd) {
+    __m512i pair = _mm512_loadu_si512((const __m512i *)ptr);
+    even = _mm512_castsi512_ps(_mm512_slli_epi32(pair, 16));
+    odd = _mm512_castsi512_ps(
+        _mm512_and_si512(pair, _mm512_set1_epi32(0xffff0000)));
+  }
+};
+
+#define DL_KERNEL_TARGET DL_TARGET_AVX512
+#include "simd_kernel_impl.h"
+#undef DL_KERNEL_TARGET
+
+DL_TARGET_AVX512_VNNI inline __m512i Int8Dot(__m512i acc, __m512i x,
+                                             const std::int8_t *w) {
+  return _mm512_dpbusd_epi32(acc, x, _mm512_loadu_si512((const __m512i *)w));
+}
+
+// vpdpbusd add four u8 x s8 product straight into each int32 lane, no int16
+// step to saturate. otherwise the same as sse42::Int8Gemv
+DL_TARGET_AVX512_VNNI inline void Int8GemvVnni(int rows, int k,
+                                               const std::uint8_t *x,
+                                               const std::int8_t *w, int ldw,
+                                               std::int32_t *y) {
+  int i = 0;
+  for (; i + 4 <= rows; i += 4) {
+    const std::int8_t *w0 = w + (std::size_t)i * ldw;
+    const std::int8_t *w1 = w0 + ldw, *w2 = w1 + ldw, *w3 = w2 + ldw;
+    __m512i acc0 = _mm512_setzero_si512(), acc1 = _mm512_setzero_si512();
+    __m512i acc2 = _mm512_setzero_si512(), acc3 = _mm512_setzero_si512();
+    for (int p = 0; p < k; p += 64) {
+      __m512i value = _mm512_loadu_si512((const __m512i *)(x + p));
+      acc0 = Int8Dot(acc0, value, w0 + p);
+      acc1 = Int8Dot(acc1, value, w1 + p);
+      acc2 = Int8Dot(acc2, value, w2 + p);
+      acc3 = Int8Dot(acc3, value, w3 + p);
+    }
+    y[i] = _mm512_reduce_add_epi32(acc0);
+    y[i + 1] = _mm512_reduce_add_epi32(acc1);
+    y[i + 2] = _mm512_reduce_add_epi32(acc2);
+    y[i + 3] = _mm512_reduce_add_epi32(acc3);
+  }
+  for (; i < rows; i++) {
+    const std::int8_t *row = w + (std::size_t)i * ldw;
+    __m512i acc = _mm512_setzero_si512();
+    for (int p = 0; p < k; p += 64) {
+      acc = Int8Dot(acc, _mm512_loadu_si512((const __m512i *)(x + p)),
+                    row + p);
+    }
+    y[i] = _mm512_reduce_add_epi32(acc);
+  }
+}
+
+// vdpbf16ps add the product of a bf16 pair into each float lane, the packed
+// pair layout feed it directly. 8 x 32 tile, 16 accumulator and one
+// broadcast a pair per row
+template <typename T> struct GemmBf16NativeKernel {
+  static constexpr int kMr = 8;
+  static constexpr int kNr = 32;
+  static constexpr int kMc = 128;
+  static constexpr int kKc = 512;
+  static constexpr int kNc = 2048;
+
+  DL_TARGET_AVX512_BF16 static inline void Dot(const std::uint16_t *a,
+                                               __m512bh b0, __m512bh b1,
+                                               __m512 &c0, __m512 &c1) {
+    int pair;
+    std::memcpy(&pair, a, sizeof(pair));
+    auto value = (__m512bh)_mm512_set1_epi32(pair);
+    c0 = _mm512_dpbf16_ps(c0, value, b0);
+    c1 = _mm512_dpbf16_ps(c1, value, b1);
+  }
+
+  DL_TARGET_AVX512_BF16 static void Run(int pair_num, const std::uint16_t *a,
+                                        const std::uint16_t *b, T *c, int ldc,
+                                        int m, int n, T beta) {
+    __m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+    __m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+    __m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+    __m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+    __m512 c40 = _mm512_setzero_ps(), c41 = _mm512_setzero_ps();
+    __m512 c50 = _mm512_setzero_ps(), c51 = _mm512_setzero_ps();
+    __m512 c60 = _mm512_setzero_ps(), c61 = _mm512_setzero_ps();
+    __m512 c70 = _mm512_setzero_ps(), c71 = _mm512_setzero_ps();
+    for (int p = 0; p < pair_num; p++) {
+      auto b0 = (__m512bh)_mm512_loadu_si512((const __m512i *)b);
+      auto b1 = (__m512bh)_mm512_loadu_si512((const __m512i *)(b + 32));
+      Dot(a, b0, b1, c00, c01);
+      Dot(a + 2, b0, b1, c10, c11);
+      Dot(a + 4, b0, b1, c20, c21);
+      Dot(a + 6, b0, b1, c30, c31);
+      Dot(a + 8, b0, b1, c40, c41);
+      Dot(a + 10, b0, b1, c50, c51);
+      Dot(a + 12, b0, b1, c60, c61);
+      Dot(a + 14, b0, b1, c70, c71);
+      a += kMr * 2;
+      b += kNr * 2;
+    }
+
+    __m512 acc[kMr][2] = {{c00, c01}, {c10, c11}, {c20, c21}, {c30, c31},
+                          {c40, c41}, {c50, c51}, {c60, c61}, {c70, c71}};
+    alignas(64) float tile[kMr * kNr];
+    for (int i = 0; i < kMr; i++) {
+      _mm512_store_ps(tile + i * kNr, acc[i][0]);
+      _mm512_store_ps(tile + i * kNr + 16, acc[i][1]);
+    }
+    StoreTile(tile, kNr, c, ldc, m, n, beta);
+  }
+};
+
+template <typename T>
+void GemmBf16Native(bool trans_a, bool trans_b, int m, int n, int k, T alpha,
+                    const T *a, int lda, const T *b, int ldb, T beta, T *c,
+                    int ldc) {
+  GemmBlockedBf16<GemmBf16NativeKernel<T>>(trans_a, trans_b, m, n, k, alpha, a,
+                                           lda, b, ldb, beta, c, ldc);
+}
+
+} // namespace avx512
+} // namespace kernel
+} // namespace deeplearning
+
+#endif
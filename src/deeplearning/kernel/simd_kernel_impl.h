@@ -0,0 +1,502 @@
+// simd kernel body shared by every isa, no include guard on purpose
+//
+// the including header must open its isa namespace, define Vec<T> with the
+// intrinsic wrappers and DL_KERNEL_TARGET with the matching target attribute
+// before include this file, then undef DL_KERNEL_TARGET after
+
+// 6 x (2 * width) register tile, the 12 accumulator keep in named variable so
+// the compiler never spill them
+template <typename T> struct GemmKernel {
+  using V = Vec<T>;
+  using Type = typename V::Type;
+  static constexpr int kMr = 6;
+  static constexpr int kNr = 2 * V::kWidth;
+  static constexpr int kMc = 120;
+  static constexpr int kKc = 256;
+  static constexpr int kNc = 2048;
+
+  DL_KERNEL_TARGET static void Run(int kc, const T *a, const T *b, T *c,
+                                   int ldc, int m, int n, T beta) {
+    Type c00 = V::Zero(), c01 = V::Zero(), c10 = V::Zero(), c11 = V::Zero();
+    Type c20 = V::Zero(), c21 = V::Zero(), c30 = V::Zero(), c31 = V::Zero();
+    Type c40 = V::Zero(), c41 = V::Zero(), c50 = V::Zero(), c51 = V::Zero();
+    for (int p = 0; p < kc; p++) {
+      Type b0 = V::Load(b);
+      Type b1 = V::Load(b + V::kWidth);
+      Type value = V::Set1(a[0]);
+      c00 = V::Fmadd(value, b0, c00);
+      c01 = V::Fmadd(value, b1, c01);
+      value = V::Set1(a[1]);
+      c10 = V::Fmadd(value, b0, c10);
+      c11 = V::Fmadd(value, b1, c11);
+      value = V::Set1(a[2]);
+      c20 = V::Fmadd(value, b0, c20);
+      c21 = V::Fmadd(value, b1, c21);
+      value = V::Set1(a[3]);
+      c30 = V::Fmadd(value, b0, c30);
+      c31 = V::Fmadd(value, b1, c31);
+      value = V::Set1(a[4]);
+      c40 = V::Fmadd(value, b0, c40);
+      c41 = V::Fmadd(value, b1, c41);
+      value = V::Set1(a[5]);
+      c50 = V::Fmadd(value, b0, c50);
+      c51 = V::Fmadd(value, b1, c51);
+      a += kMr;
+      b += kNr;
+    }
+
+    Type acc[kMr][2] = {{c00, c01}, {c10, c11}, {c20, c21},
+                        {c30, c31}, {c40, c41}, {c50, c51}};
+    if (m == kMr && n == kNr) {
+      Type beta_value = V::Set1(beta);
+      for (int i = 0; i < kMr; i++) {
+        T *c_row = c + (std::size_t)i * ldc;
+        if (beta != 0) {
+          acc[i][0] = V::Fmadd(beta_value, V::Load(c_row), acc[i][0]);
+          acc[i][1] = V::Fmadd(beta_value, V::Load(c_row + V::kWidth),
+                               acc[i][1]);
+        }
+        V::Store(c_row, acc[i][0]);
+        V::Store(c_row + V::kWidth, acc[i][1]);
+      }
+      return;
+    }
+    alignas(64) T tile[kMr * kNr];
+    for (int i = 0; i < kMr; i++) {
+      V::Store(tile + i * kNr, acc[i][0]);
+      V::Store(tile + i * kNr + V::kWidth, acc[i][1]);
+    }
+    StoreTile(tile, kNr, c, ldc, m, n, beta);
+  }
+};
+
+template <typename T>
+DL_KERNEL_TARGET void Gemm(bool trans_a, bool trans_b, int m, int n, int k,
+                           T alpha, const T *a, int lda, const T *b, int ldb,
+                           T beta, T *c, int ldc) {
+  GemmBlocked<GemmKernel<T>>(trans_a, trans_b, m, n, k, alpha, a, lda, b, ldb,
+                             beta, c, ldc);
+}
+
+// bf16 operand emulated on a cpu without the dot instruction: each packed
+// pair widen to two float vector, so the accumulator is float for any T.
+// 4 x (2 * width) tile, 8 accumulator leave room for the widened operand
+template <typename T> struct GemmBf16Kernel {
+  using V = Vec<float>;
+  using Type = typename V::Type;
+  static constexpr int kMr = 4;
+  static constexpr int kNr = 2 * V::kWidth;
+  static constexpr int kMc = 128;
+  static constexpr int kKc = 256;
+  static constexpr int kNc = 2048;
+
+  DL_KERNEL_TARGET static void Run(int pair_num, const std::uint16_t *a,
+                                   const std::uint16_t *b, T *c, int ldc,
+                                   int m, int n, T beta) {
+    Type c00 = V::Zero(), c01 = V::Zero(), c10 = V::Zero(), c11 = V::Zero();
+    Type c20 = V::Zero(), c21 = V::Zero(), c30 = V::Zero(), c31 = V::Zero();
+    for (int p = 0; p < pair_num; p++) {
+      Type b0_even, b0_odd, b1_even, b1_odd;
+      V::LoadBf16Pair(b, b0_even, b0_odd);
+      V::LoadBf16Pair(b + 2 * V::kWidth, b1_even, b1_odd);
+      Type even = V::Set1(Bf16ToFloat(a[0])), odd = V::Set1(Bf16ToFloat(a[1]));
+      c00 = V::Fmadd(odd, b0_odd, V::Fmadd(even, b0_even, c00));
+      c01 = V::Fmadd(odd, b1_odd, V::Fmadd(even, b1_even, c01));
+      even = V::Set1(Bf16ToFloat(a[2]));
+      odd = V::Set1(Bf16ToFloat(a[3]));
+      c10 = V::Fmadd(odd, b0_odd, V::Fmadd(even, b0_even, c10));
+      c11 = V::Fmadd(odd, b1_odd, V::Fmadd(even, b1_even, c11));
+      even = V::Set1(Bf16ToFloat(a[4]));
+      odd = V::Set1(Bf16ToFloat(a[5]));
+      c20 = V::Fmadd(odd, b0_odd, V::Fmadd(even, b0_even, c20));
+      c21 = V::Fmadd(odd, b1_odd, V::Fmadd(even, b1_even, c21));
+      even = V::Set1(Bf16ToFloat(a[6]));
+      odd = V::Set1(Bf16ToFloat(a[7]));
+      c30 = V::Fmadd(odd, b0_odd, V::Fmadd(even, b0_even, c30));
+      c31 = V::Fmadd(odd, b1_odd, V::Fmadd(even, b1_even, c31));
+      a += kMr * 2;
+      b += kNr * 2;
+    }
+
+    alignas(64) float tile[kMr * kNr];
+    V::Store(tile, c00);
+    V::Store(tile + V::kWidth, c01);
+    V::Store(tile + kNr, c10);
+    V::Store(tile + kNr + V::kWidth, c11);
+    V::Store(tile + 2 * kNr, c20);
+    V::Store(tile + 2 * kNr + V::kWidth, c21);
+    V::Store(tile + 3 * kNr, c30);
+    V::Store(tile + 3 * kNr + V::kWidth, c31);
+    StoreTile(tile, kNr, c, ldc, m, n, beta);
+  }
+};
+
+template <typename T>
+DL_KERNEL_TARGET void GemmBf16(bool trans_a, bool trans_b, int m, int n, int k,
+                               T alpha, const T *a, int lda, const T *b,
+                               int ldb, T beta, T *c, int ldc) {
+  GemmBlockedBf16<GemmBf16Kernel<T>>(trans_a, trans_b, m, n, k, alpha, a, lda,
+                                     b, ldb, beta, c, ldc);
+}
+
+// y = alpha * op(a) * x + beta * y, four row of a share each load of x
+template <typename T>
+DL_KERNEL_TARGET void Gemv(bool trans, int m, int k, T alpha, const T *a,
+                           int lda, const T *x, T beta, T *y) {
+  using V = Vec<T>;
+  using Type = typename V::Type;
+  constexpr int width = V::kWidth;
+  if (!trans) {
+    int i = 0;
+    for (; i + 4 <= m; i += 4) {
+      const T *a0 = a + (std::size_t)i * lda, *a1 = a0 + lda;
+      const T *a2 = a1 + lda, *a3 = a2 + lda;
+      Type sum0 = V::Zero(), sum1 = V::Zero();
+      Type sum2 = V::Zero(), sum3 = V::Zero();
+      int p = 0;
+      for (; p + width <= k; p += width) {
+        Type value = V::Load(x + p);
+        sum0 = V::Fmadd(V::Load(a0 + p), value, sum0);
+        sum1 = V::Fmadd(V::Load(a1 + p), value, sum1);
+        sum2 = V::Fmadd(V::Load(a2 + p), value, sum2);
+        sum3 = V::Fmadd(V::Load(a3 + p), value, sum3);
+      }
+      T result[4] = {V::HorizontalSum(sum0), V::HorizontalSum(sum1),
+                     V::HorizontalSum(sum2), V::HorizontalSum(sum3)};
+      for (; p < k; p++) {
+        result[0] += a0[p] * x[p];
+        result[1] += a1[p] * x[p];
+        result[2] += a2[p] * x[p];
+        result[3] += a3[p] * x[p];
+      }
+      for (int r = 0; r < 4; r++) {
+        y[i + r] = alpha * result[r] + (beta == 0 ? 0 : beta * y[i + r]);
+      }
+    }
+    for (; i < m; i++) {
+      const T *a_row = a + (std::size_t)i * lda;
+      Type sum = V::Zero();
+      int p = 0;
+      for (; p + width <= k; p += width) {
+        sum = V::Fmadd(V::Load(a_row + p), V::Load(x + p), sum);
+      }
+      T result = V::HorizontalSum(sum);
+      for (; p < k; p++) {
+        result += a_row[p] * x[p];
+      }
+      y[i] = alpha * result + (beta == 0 ? 0 : beta * y[i]);
+    }
+    return;
+  }
+
+  ScaleMatrix(1, k, beta, y, k);
+  int i = 0;
+  for (; i + 4 <= m; i += 4) {
+    const T *a0 = a + (std::size_t)i * lda, *a1 = a0 + lda;
+    const T *a2 = a1 + lda, *a3 = a2 + lda;
+    T value[4] = {alpha * x[i], alpha * x[i + 1], alpha * x[i + 2],
+                  alpha * x[i + 3]};
+    Type x0 = V::Set1(value[0]), x1 = V::Set1(value[1]);
+    Type x2 = V::Set1(value[2]), x3 = V::Set1(value[3]);
+    int p = 0;
+    for (; p + width <= k; p += width) {
+      Type sum = V::Load(y + p);
+      sum = V::Fmadd(x0, V::Load(a0 + p), sum);
+      sum = V::Fmadd(x1, V::Load(a1 + p), sum);
+      sum = V::Fmadd(x2, V::Load(a2 + p), sum);
+      sum = V::Fmadd(x3, V::Load(a3 + p), sum);
+      V::Store(y + p, sum);
+    }
+    for (; p < k; p++) {
+      y[p] += value[0] * a0[p] + value[1] * a1[p] + value[2] * a2[p] +
+              value[3] * a3[p];
+    }
+  }
+  for (; i < m; i++) {
+    const T *a_row = a + (std::size_t)i * lda;
+    T value = alpha * x[i];
+    Type value_vec = V::Set1(value);
+    int p = 0;
+    for (; p + width <= k; p += width) {
+      V::Store(y + p,
+               V::Fmadd(value_vec, V::Load(a_row + p), V::Load(y + p)));
+    }
+    for (; p < k; p++) {
+      y[p] += value * a_row[p];
+    }
+  }
+}
+
+template <typename T>
+DL_KERNEL_TARGET void Relu(int n, const T *input, T *output) {
+  using V = Vec<T>;
+  int i = 0;
+  for (; i + V::kWidth <= n; i += V::kWidth) {
+    V::Store(output + i, V::Max(V::Load(input + i), V::Zero()));
+  }
+  for (; i < n; i++) {
+    output[i] = input[i] > 0 ? input[i] : 0;
+  }
+}
+
+// sum of coefficient[i] * r^i for i in [0, degree], horner form
+template <typename T, int kDegree>
+DL_KERNEL_TARGET typename Vec<T>::Type Polynomial(typename Vec<T>::Type r) {
+  using V = Vec<T>;
+  auto poly = V::Set1(ExpConst<T>::kTaylor[kDegree]);
+  for (int i = kDegree - 1; i >= 0; i--) {
+    poly = V::Fmadd(poly, r, V::Set1(ExpConst<T>::kTaylor[i]));
+  }
+  return poly;
+}
+
+// e^x of the accuracy tier, input clamp to ExpConst range so it never
+// overflow to inf
+template <typename T, int kAccuracy>
+DL_KERNEL_TARGET typename Vec<T>::Type Exp(typename Vec<T>::Type x) {
+  using V = Vec<T>;
+  using C = ExpConst<T>;
+  constexpr int kDegree = kAccuracy == MATH_ACCURACY_FAST   ? C::kFastDegree
+                          : kAccuracy == MATH_ACCURACY_HIGH ? C::kHighDegree
+                                                            : C::kDegree;
+  x = V::Min(V::Max(x, V::Set1(C::kMin)), V::Set1(C::kMax));
+  auto n = V::Round(V::Mul(x, V::Set1(C::kLog2e)));
+  auto r = V::Fmadd(n, V::Set1(-C::kLn2Hi), x);
+  r = V::Fmadd(n, V::Set1(-C::kLn2Lo), r);
+  return V::Mul(Polynomial<T, kDegree>(r), V::Pow2(n));
+}
+
+// run Op::Apply on every full vector, the tail go through a padded copy so
+// it get the same result as the body
+template <typename Op, typename T>
+DL_KERNEL_TARGET void MapVector(int n, const T *input, T *output) {
+  using V = Vec<T>;
+  int i = 0;
+  for (; i + V::kWidth <= n; i += V::kWidth) {
+    V::Store(output + i, Op::Apply(V::Load(input + i)));
+  }
+  if (i < n) {
+    T tail[V::kWidth] = {};
+    std::copy(input + i, input + n, tail);
+    V::Store(tail, Op::Apply(V::Load(tail)));
+    std::copy(tail, tail + (n - i), output + i);
+  }
+}
+
+template <typename T, int kAccuracy> struct ExpOp {
+  using V = Vec<T>;
+  DL_KERNEL_TARGET static typename V::Type Apply(typename V::Type x) {
+    return Exp<T, kAccuracy>(x);
+  }
+};
+
+// 1 / (1 + e^-x)
+template <typename T, int kAccuracy> struct SigmoidOp {
+  using V = Vec<T>;
+  DL_KERNEL_TARGET static typename V::Type Apply(typename V::Type x) {
+    auto one = V::Set1(1);
+    auto exp = Exp<T, kAccuracy>(V::Sub(V::Zero(), x));
+    return V::Div(one, V::Add(one, exp));
+  }
+};
+
+// (1 - e^-2x) / (1 + e^-2x)
+template <typename T, int kAccuracy> struct TanhOp {
+  using V = Vec<T>;
+  DL_KERNEL_TARGET static typename V::Type Apply(typename V::Type x) {
+    auto one = V::Set1(1);
+    auto exp = Exp<T, kAccuracy>(V::Mul(x, V::Set1(-2)));
+    return V::Div(V::Sub(one, exp), V::Add(one, exp));
+  }
+};
+
+template <typename T, int kAccuracy>
+DL_KERNEL_TARGET void Exp(int n, const T *input, T *output) {
+  MapVector<ExpOp<T, kAccuracy>>(n, input, output);
+}
+
+template <typename T, int kAccuracy>
+DL_KERNEL_TARGET void Sigmoid(int n, const T *input, T *output) {
+  MapVector<SigmoidOp<T, kAccuracy>>(n, input, output);
+}
+
+template <typename T, int kAccuracy>
+DL_KERNEL_TARGET void Tanh(int n, const T *input, T *output) {
+  MapVector<TanhOp<T, kAccuracy>>(n, input, output);
+}
+
+// row-wise softmax of a rows x cols matrix, input may alias output.
+// subtract the row max so e^x never overflow, then one sweep write e^x and
+// sum it, one more sweep scale by 1 / sum
+template <typename T, int kAccuracy>
+DL_KERNEL_TARGET void Softmax(int rows, int cols, const T *input, T *output) {
+  using V = Vec<T>;
+  int body = cols / V::kWidth * V::kWidth;
+  for (int r = 0; r < rows; r++) {
+    const T *in = input + (std::size_t)r * cols;
+    T *out = output + (std::size_t)r * cols;
+    T max = cols > 0 ? in[0] : 0;
+    if (body > 0) {
+      auto max_vec = V::Load(in);
+      for (int i = V::kWidth; i < body; i += V::kWidth) {
+        max_vec = V::Max(max_vec, V::Load(in + i));
+      }
+      max = V::HorizontalMax(max_vec);
+    }
+    for (int i = body; i < cols; i++) {
+      max = in[i] > max ? in[i] : max;
+    }
+
+    auto max_vec = V::Set1(max);
+    auto sum_vec = V::Zero();
+    for (int i = 0; i < body; i += V::kWidth) {
+      auto exp = Exp<T, kAccuracy>(V::Sub(V::Load(in + i), max_vec));
+      V::Store(out + i, exp);
+      sum_vec = V::Add(sum_vec, exp);
+    }
+    T sum = V::HorizontalSum(sum_vec);
+    if (body < cols) {
+      T tail[V::kWidth] = {};
+      std::copy(in + body, in + cols, tail);
+      V::Store(tail, Exp<T, kAccuracy>(V::Sub(V::Load(tail), max_vec)));
+      for (int i = body; i < cols; i++) {
+        out[i] = tail[i - body];
+        sum += out[i];
+      }
+    }
+
+    auto scale = V::Set1(1 / sum);
+    for (int i = 0; i < body; i += V::kWidth) {
+      V::Store(out + i, V::Mul(V::Load(out + i), scale));
+    }
+    for (int i = body; i < cols; i++) {
+      out[i] /= sum;
+    }
+  }
+}
+
+// delta *= relu'(output)
+template <typename T>
+DL_KERNEL_TARGET void ReluDeriv(int n, const T *output, T *delta) {
+  using V = Vec<T>;
+  int i = 0;
+  for (; i + V::kWidth <= n; i += V::kWidth) {
+    V::Store(delta + i, V::KeepPositive(V::Load(output + i),
+                                        V::Load(delta + i)));
+  }
+  for (; i < n; i++) {
+    delta[i] = output[i] > 0 ? delta[i] : 0;
+  }
+}
+
+// delta *= sigmoid'(output) = output * (1 - output)
+template <typename T>
+DL_KERNEL_TARGET void SigmoidDeriv(int n, const T *output, T *delta) {
+  using V = Vec<T>;
+  int i = 0;
+  for (; i + V::kWidth <= n; i += V::kWidth) {
+    auto out = V::Load(output + i);
+    auto deriv = V::Mul(out, V::Sub(V::Set1(1), out));
+    V::Store(delta + i, V::Mul(V::Load(delta + i), deriv));
+  }
+  for (; i < n; i++) {
+    delta[i] *= output[i] * (1 - output[i]);
+  }
+}
+
+// delta *= tanh'(output) = 1 - output^2
+template <typename T>
+DL_KERNEL_TARGET void TanhDeriv(int n, const T *output, T *delta) {
+  using V = Vec<T>;
+  int i = 0;
+  for (; i + V::kWidth <= n; i += V::kWidth) {
+    auto out = V::Load(output + i);
+    auto deriv = V::Sub(V::Set1(1), V::Mul(out, out));
+    V::Store(delta + i, V::Mul(V::Load(delta + i), deriv));
+  }
+  for (; i < n; i++) {
+    delta[i] *= 1 - output[i] * output[i];
+  }
+}
+
+// weight -= learning_rate * grad
+template <typename T>
+DL_KERNEL_TARGET void SgdUpdate(int n, T learning_rate, const T *grad,
+                                T *weight) {
+  using V = Vec<T>;
+  auto rate = V::Set1(-learning_rate);
+  int i = 0;
+  for (; i + V::kWidth <= n; i += V::kWidth) {
+    V::Store(weight + i,
+             V::Fmadd(rate, V::Load(grad + i), V::Load(weight + i)));
+  }
+  for (; i < n; i++) {
+    weight[i] -= learning_rate * grad[i];
+  }
+}
+
+// velocity = momentum * velocity - learning_rate * grad, weight += velocity
+template <typename T>
+DL_KERNEL_TARGET void MomentumUpdate(int n, T learning_rate, T momentum,
+                                     const T *grad, T *velocity, T *weight) {
+  using V = Vec<T>;
+  auto rate = V::Set1(-learning_rate), keep = V::Set1(momentum);
+  int i = 0;
+  for (; i + V::kWidth <= n; i += V::kWidth) {
+    auto now = V::Fmadd(rate, V::Load(grad + i),
+                        V::Mul(keep, V::Load(velocity + i)));
+    V::Store(velocity + i, now);
+    V::Store(weight + i, V::Add(V::Load(weight + i), now));
+  }
+  for (; i < n; i++) {
+    velocity[i] = momentum * velocity[i] - learning_rate * grad[i];
+    weight[i] += velocity[i];
+  }
+}
+
+// fused adam/adamw step, read grad and write both moment and weight in one
+// sweep, see AdaptiveParam
+template <typename T>
+DL_KERNEL_TARGET void AdamUpdate(int n, const AdaptiveParam<T> &param,
+                                 const T *grad, T *moment1, T *moment2,
+                                 T *weight) {
+  using V = Vec<T>;
+  auto scale = V::Set1(param.grad_scale_);
+  auto beta1 = V::Set1(param.beta1_), rest1 = V::Set1(1 - param.beta1_);
+  auto beta2 = V::Set1(param.beta2_), rest2 = V::Set1(1 - param.beta2_);
+  auto step = V::Set1(-param.step_size_), keep = V::Set1(1 - param.decay_);
+  auto correction = V::Set1(param.correction2_), eps = V::Set1(param.eps_);
+  int i = 0;
+  for (; i + V::kWidth <= n; i += V::kWidth) {
+    auto g = V::Mul(V::Load(grad + i), scale);
+    auto m = V::Fmadd(beta1, V::Load(moment1 + i), V::Mul(rest1, g));
+    auto v = V::Fmadd(beta2, V::Load(moment2 + i), V::Mul(rest2, V::Mul(g, g)));
+    V::Store(moment1 + i, m);
+    V::Store(moment2 + i, v);
+    auto denom = V::Fmadd(V::Sqrt(v), correction, eps);
+    V::Store(weight + i, V::Fmadd(step, V::Div(m, denom),
+                                  V::Mul(keep, V::Load(weight + i))));
+  }
+  AdamUpdateScalar(n - i, param, grad + i, moment1 + i, moment2 + i,
+                   weight + i);
+}
+
+template <typename T>
+DL_KERNEL_TARGET void RmspropUpdate(int n, const AdaptiveParam<T> &param,
+                                    const T *grad, T *moment2, T *weight) {
+  using V = Vec<T>;
+  auto scale = V::Set1(param.grad_scale_);
+  auto beta2 = V::Set1(param.beta2_), rest2 = V::Set1(1 - param.beta2_);
+  auto step = V::Set1(-param.step_size_);
+  auto correction = V::Set1(param.correction2_), eps = V::Set1(param.eps_);
+  int i = 0;
+  for (; i + V::kWidth <= n; i += V::kWidth) {
+    auto g = V::Mul(V::Load(grad + i), scale);
+    auto v = V::Fmadd(beta2, V::Load(moment2 + i), V::Mul(rest2, V::Mul(g, g)));
+    V::Store(moment2 + i, v);
+    auto denom = V::Fmadd(V::Sqrt(v), correction, eps);
+    V::Store(weight + i,
+             V::Fmadd(step, V::Div(g, denom), V::Load(weight + i)));
+  }
+  RmspropUpdateScalar(n - i, param, grad + i, moment2 + i, weight + i);
+}
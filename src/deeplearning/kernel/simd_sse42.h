@@ -0,0 +1,162 @@
+#pragma once
+#include "elementwise_scalar.h"
+#include "kernel_base.h"
+
+#if DL_KERNEL_X86
+
+namespace deeplearning {
+namespace kernel {
+namespace sse42 {
+
+template <typename T> struct Vec;
+
+template <> struct Vec<double> {
+  using Type = __m128d;
+  static constexpr int kWidth = 2;
+  DL_TARGET_SSE42 static Type Zero() { return _mm_setzero_pd(); }
+  DL_TARGET_SSE42 static Type Set1(double value) { return _mm_set1_pd(value); }
+  DL_TARGET_SSE42 static Type Load(const double *ptr) {
+    return _mm_loadu_pd(ptr);
+  }
+  DL_TARGET_SSE42 static void Store(double *ptr, Type value) {
+    _mm_storeu_pd(ptr, value);
+  }
+  DL_TARGET_SSE42 static Type Add(Type a, Type b) { return _mm_add_pd(a, b); }
+  DL_TARGET_SSE42 static Type Sub(Type a, Type b) { return _mm_sub_pd(a, b); }
+  DL_TARGET_SSE42 static Type Mul(Type a, Type b) { return _mm_mul_pd(a, b); }
+  // no fma before avx2, a * b + c in two step
+  DL_TARGET_SSE42 static Type Fmadd(Type a, Type b, Type c) {
+    return _mm_add_pd(_mm_mul_pd(a, b), c);
+  }
+  DL_TARGET_SSE42 static Type Max(Type a, Type b) { return _mm_max_pd(a, b); }
+  DL_TARGET_SSE42 static Type Min(Type a, Type b) { return _mm_min_pd(a, b); }
+  DL_TARGET_SSE42 static Type Div(Type a, Type b) { return _mm_div_pd(a, b); }
+  DL_TARGET_SSE42 static Type Sqrt(Type a) { return _mm_sqrt_pd(a); }
+  DL_TARGET_SSE42 static Type Round(Type a) {
+    return _mm_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  }
+  // 2^n for integral n in [-1022, 1023], build the exponent bit directly
+  DL_TARGET_SSE42 static Type Pow2(Type n) {
+    auto bits = _mm_castpd_si128(_mm_add_pd(n, _mm_set1_pd(0x1.8p52 + 1023)));
+    return _mm_castsi128_pd(_mm_slli_epi64(bits, 52));
+  }
+  // value where key > 0, else 0
+  DL_TARGET_SSE42 static Type KeepPositive(Type key, Type value) {
+    return _mm_and_pd(_mm_cmpgt_pd(key, _mm_setzero_pd()), value);
+  }
+  DL_TARGET_SSE42 static double HorizontalSum(Type value) {
+    return _mm_cvtsd_f64(_mm_add_sd(value, _mm_unpackhi_pd(value, value)));
+  }
+  DL_TARGET_SSE42 static double HorizontalMax(Type value) {
+    return _mm_cvtsd_f64(_mm_max_sd(value, _mm_unpackhi_pd(value, value)));
+  }
+};
+
+template <> struct Vec<float> {
+  using Type = __m128;
+  static constexpr int kWidth = 4;
+  DL_TARGET_SSE42 static Type Zero() { return _mm_setzero_ps(); }
+  DL_TARGET_SSE42 static Type Set1(float value) { return _mm_set1_ps(value); }
+  DL_TARGET_SSE42 static Type Load(const float *ptr) {
+    return _mm_loadu_ps(ptr);
+  }
+  DL_TARGET_SSE42 static void Store(float *ptr, Type value) {
+    _mm_storeu_ps(ptr, value);
+  }
+  DL_TARGET_SSE42 static Type Add(Type a, Type b) { return _mm_add_ps(a, b); }
+  DL_TARGET_SSE42 static Type Sub(Type a, Type b) { return _mm_sub_ps(a, b); }
+  DL_TARGET_SSE42 static Type Mul(Type a, Type b) { return _mm_mul_ps(a, b); }
+  DL_TARGET_SSE42 static Type Fmadd(Type a, Type b, Type c) {
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+  }
+  DL_TARGET_SSE42 static Type Max(Type a, Type b) { return _mm_max_ps(a, b); }
+  DL_TARGET_SSE42 static Type Min(Type a, Type b) { return _mm_min_ps(a, b); }
+  DL_TARGET_SSE42 static Type Div(Type a, Type b) { return _mm_div_ps(a, b); }
+  DL_TARGET_SSE42 static Type Sqrt(Type a) { return _mm_sqrt_ps(a); }
+  DL_TARGET_SSE42 static Type Round(Type a) {
+    return _mm_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  }
+  // 2^n for integral n in [-126, 127]
+  DL_TARGET_SSE42 static Type Pow2(Type n) {
+    auto bits = _mm_castps_si128(_mm_add_ps(n, _mm_set1_ps(0x1.8p23f + 127)));
+    return _mm_castsi128_ps(_mm_slli_epi32(bits, 23));
+  }
+  DL_TARGET_SSE42 static Type KeepPositive(Type key, Type value) {
+    return _mm_and_ps(_mm_cmpgt_ps(key, _mm_setzero_ps()), value);
+  }
+  DL_TARGET_SSE42 static float HorizontalSum(Type value) {
+    value = _mm_add_ps(value, _mm_movehl_ps(value, value));
+    value = _mm_add_ss(value, _mm_shuffle_ps(value, value, 1));
+    return _mm_cvtss_f32(value);
+  }
+  DL_TARGET_SSE42 static float HorizontalMax(Type value) {
+    value = _mm_max_ps(value, _mm_movehl_ps(value, value));
+    value = _mm_max_ss(value, _mm_shuffle_ps(value, value, 1));
+    return _mm_cvtss_f32(value);
+  }
+  // kWidth bf16 pair, the first of each pair widen to even and the second
+  // to odd as float
+  DL_TARGET_SSE42 static void LoadBf16Pair(const std::uint16_t *ptr,
+                                          Type &even, Type &odd) {
+    __m128i pair = _mm_loadu_si128((const __m128i *)ptr);
+    even = _mm_castsi128_ps(_mm_slli_epi32(pair, 16));
+    odd = _mm_castsi128_ps(_mm_and_si128(pair, _mm_set1_epi32(0xffff0000)));
+  }
+};
+
+#define DL_KERNEL_TARGET DL_TARGET_SSE42
+#include "simd_kernel_impl.h"
+#undef DL_KERNEL_TARGET
+
+// u8 x s8 int8 gemv, y[i] = sum of x[p] * w[i][p] with k a multiple of
+// kInt8Align. maddubs add each product pair into int16, which can not
+// saturate while x stay below 128, then madd by one widen it to int32
+DL_TARGET_SSE42 inline __m128i Int8Madd(__m128i acc, __m128i x,
+                                        const std::int8_t *w) {
+  __m128i pair = _mm_maddubs_epi16(x, _mm_loadu_si128((const __m128i *)w));
+  return _mm_add_epi32(acc, _mm_madd_epi16(pair, _mm_set1_epi16(1)));
+}
+
+DL_TARGET_SSE42 inline std::int32_t Int8Sum(__m128i value) {
+  value = _mm_add_epi32(value, _mm_shuffle_epi32(value, 0x4e));
+  value = _mm_add_epi32(value, _mm_shuffle_epi32(value, 0xb1));
+  return _mm_cvtsi128_si32(value);
+}
+
+// four row share each load of x
+DL_TARGET_SSE42 inline void Int8Gemv(int rows, int k, const std::uint8_t *x,
+                                     const std::int8_t *w, int ldw,
+                                     std::int32_t *y) {
+  int i = 0;
+  for (; i + 4 <= rows; i += 4) {
+    const std::int8_t *w0 = w + (std::size_t)i * ldw;
+    const std::int8_t *w1 = w0 + ldw, *w2 = w1 + ldw, *w3 = w2 + ldw;
+    __m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+    __m128i acc2 = _mm_setzero_si128(), acc3 = _mm_setzero_si128();
+    for (int p = 0; p < k; p += 16) {
+      __m128i value = _mm_loadu_si128((const __m128i *)(x + p));
+      acc0 = Int8Madd(acc0, value, w0 + p);
+      acc1 = Int8Madd(acc1, value, w1 + p);
+      acc2 = Int8Madd(acc2, value, w2 + p);
+      acc3 = Int8Madd(acc3, value, w3 + p);
+    }
+    y[i] = Int8Sum(acc0);
+    y[i + 1] = Int8Sum(acc1);
+    y[i + 2] = Int8Sum(acc2);
+    y[i + 3] = Int8Sum(acc3);
+  }
+  for (; i < rows; i++) {
+    const std::int8_t *row = w + (std::size_t)i * ldw;
+    __m128i acc = _mm_setzero_si128();
+    for (int p = 0; p < k; p += 16) {
+      acc = Int8Madd(acc, _mm_loadu_si128((const __m128i *)(x + p)), row + p);
+    }
+    y[i] = Int8Sum(acc);
+  }
+}
+
+} // namespace sse42
+} // namespace kernel
+} // namespace deeplearning
+
+#endif
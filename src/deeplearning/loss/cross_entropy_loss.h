@@ -5,15 +5,15 @@
 
 namespace deeplearning {
 
-class CrossEntropyLoss : public LossFunction {
+template <typename T> class CrossEntropyLoss : public LossFunction<T> {
 public:
   CrossEntropyLoss() = default;
-  virtual double Loss(double target, double output) override {
-    return -target * log(output) - (1.0 - target) * log(1.0 - output);
+  virtual T Loss(T target, T output) override {
+    return -target * std::log(output) - (1 - target) * std::log(1 - output);
   }
 
-  virtual double DerivLoss(double target, double output) override {
-    return (output - target) / (output * (1.0 - output));
+  virtual T DerivLoss(T target, T output) override {
+    return (output - target) / (output * (1 - output));
   }
 
   virtual LossType GetLossType() override { return LOSS_CROSS_ENTROPY; }
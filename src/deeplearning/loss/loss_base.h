@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../util/span.h"
 #include <vector>
 
 namespace deeplearning {
@@ -9,11 +10,12 @@ enum LossType {
   LOSS_CROSS_ENTROPY,
 };
 
-class LossFunction {
+template <typename T> class LossFunction {
 public:
-  virtual double AverageLoss(const std::vector<double> &target,
-                             const std::vector<double> &output) {
-    double result = 0;
+  using Scalar = T;
+
+  virtual T AverageLoss(Span<const T> target, Span<const T> output) {
+    T result = 0;
     if (target.size() != output.size() || target.size() == 0) {
       return -1;
     }
@@ -24,8 +26,8 @@ public:
     return result;
   }
 
-  virtual double Loss(double target, double output) = 0;
-  virtual double DerivLoss(double target, double output) = 0;
+  virtual T Loss(T target, T output) = 0;
+  virtual T DerivLoss(T target, T output) = 0;
   virtual LossType GetLossType() = 0;
 };
 } // namespace deeplearning
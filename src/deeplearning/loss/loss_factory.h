@@ -7,12 +7,13 @@ namespace deeplearning {
 
 class LossFactory {
 public:
-  static std::shared_ptr<LossFunction> Create(LossType loss_type) {
+  template <typename T = double>
+  static std::shared_ptr<LossFunction<T>> Create(LossType loss_type) {
     switch (loss_type) {
     case LOSS_MSE:
-      return std::make_shared<MSELoss>();
+      return std::make_shared<MSELoss<T>>();
     case LOSS_CROSS_ENTROPY:
-      return std::make_shared<CrossEntropyLoss>();
+      return std::make_shared<CrossEntropyLoss<T>>();
     default:
       return nullptr;
     }
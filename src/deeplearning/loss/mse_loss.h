@@ -2,15 +2,12 @@
 #include "loss_base.h"
 namespace deeplearning {
 
-class MSELoss : public LossFunction {
+template <typename T> class MSELoss : public LossFunction<T> {
 public:
-  double Loss(double target, double output) override {
-    return (double)(1.0 / 2.0) * (double)(target - output) *
-           (double)(target - output);
-  }
-  double DerivLoss(double target, double output) override {
-    return -2.0 * (target - output);
+  T Loss(T target, T output) override {
+    return (T)(1.0 / 2.0) * (target - output) * (target - output);
   }
+  T DerivLoss(T target, T output) override { return -2 * (target - output); }
   LossType GetLossType() override { return LOSS_MSE; }
 };
 
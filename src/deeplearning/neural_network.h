@@ -1,10 +1,18 @@
 #pragma once
 #include "activate/activate_factory.h"
+#include "kernel/gemm.h"
 #include "loss/loss_factory.h"
 #include "optimizer/optimizer_factory.h"
 #include "param_init/param_init_factory.h"
 #include "softmax/softmax_factory.h"
+#include "util/data_source.h"
+#include "util/dataset.h"
+#include "util/matrix.h"
 #include "util/random.h"
+#include "util/thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <functional>
 #include <memory>
 #include <string>
@@ -12,7 +20,7 @@
 #include <vector>
 namespace deeplearning {
 
-class NeuralNetwork {
+template <typename T> class BasicNeuralNetwork {
 public:
   enum RC {
     SUCCESS,
@@ -24,10 +32,30 @@ public:
     NETWORK_STATUS_UNINIT,
     NETWORK_STATUS_INIT,
   };
+  // how Train use more than one thread
+  enum TrainMode {
+    // split every batch between threads and step once with the summed grad
+    TRAIN_MODE_SYNC,
+    // hogwild, every thread step the shared weight on its own without lock
+    TRAIN_MODE_ASYNC,
+  };
+  // operand precision of the batch gemm in train and evaluate
+  enum TrainPrecision {
+    TRAIN_PRECISION_FULL,
+    // activation, delta and weight round to bf16 when fed to the gemm, the
+    // product accumulate in float and the weights stay in T
+    TRAIN_PRECISION_BF16,
+  };
+  // good step before the dynamic loss scale double
+  static constexpr int kLossScaleWindow = 1000;
+  // largest share of nonzero input column the sparse first layer gather
+  static constexpr double kSparseDensity = 0.75;
   struct NetworkParam {
     std::vector<int> layer_;
-    std::vector<std::vector<double>> neuron_bias_;
-    std::vector<std::vector<std::vector<double>>> neuron_weight_;
+    std::vector<std::vector<T>> neuron_bias_;
+    std::vector<std::vector<std::vector<T>>> neuron_weight_;
+    // OptimizerFunction::ExportState, empty import start from a fresh state
+    std::vector<T> optimizer_state_;
   };
   struct NetworkOption {
     double learning_rate_;
@@ -37,14 +65,122 @@ public:
     SoftmaxType softmax_type_;
     OptimizerType optimizer_type_;
   };
+  using Matrix = deeplearning::Matrix<T>;
+  using Scalar = T;
+
+  using EpochCallback = std::function<void(BasicNeuralNetwork &network,
+                                           int epoch_num, bool &early_stop)>;
+
+  struct EvaluateResult {
+    // average loss, the same as CalcLoss
+    T loss_;
+    // rate of sample whose max output is at the max target
+    double accuracy_;
+    // confusion_matrix_[target class][predict class] is the sample count
+    std::vector<std::vector<int>> confusion_matrix_;
+  };
+
+  // nonzero input columns of a batch and the first layer input and weight
+  // gathered down to them, see set_sparse_input
+  struct SparseBuffer {
+    std::vector<int> column_;
+    std::vector<char> nonzero_;
+    Matrix input_;
+    Matrix weight_;
+    Matrix weight_grad_;
+  };
+
+  // activation buffer of forward pass. the const Predict only write into
+  // the workspace, so threads each holding one can share a network
+  class Workspace {
+  public:
+    inline std::string err_msg() { return err_msg_; }
+
+  private:
+    friend class BasicNeuralNetwork;
+    std::vector<AlignedVector<T>> neuron_output_;
+    std::vector<Matrix> batch_output_;
+    SparseBuffer sparse_;
+    std::string err_msg_;
+  };
+
+private:
+  // N x layer_[i] activations, deltas and the summed gradient of one batch
+  // slice, owned by one training thread
+  struct TrainBuffer {
+    std::vector<Matrix> batch_output_;
+    std::vector<Matrix> batch_delta_;
+    Matrix batch_target_;
+    std::vector<Matrix> weight_grad_;
+    std::vector<AlignedVector<T>> bias_grad_;
+    SparseBuffer sparse_;
+    // set by the caller when the buffer is applied alone, without a reduce,
+    // then a sparse first layer gradient may stay gathered in sparse_
+    bool keep_gathered_ = false;
+    // weight_grad_[1] is not written, the gradient is sparse_.weight_grad_
+    bool gathered_grad_ = false;
+    std::string err_msg_;
+  };
+  // sample access shared by the nested vector and the Dataset overloads,
+  // Load copy sample pos into a batch row, false on a size mismatch
+  struct VectorSample {
+    VectorSample(const std::vector<std::vector<T>> &data,
+                 const std::vector<std::vector<T>> &target)
+        : data_(data), target_(target) {}
+    inline int size() const { return data_.size(); }
+    bool Load(int pos, int data_size, int target_size, T *data,
+              T *target) const {
+      if (data_[pos].size() != data_size ||
+          target_[pos].size() != target_size) {
+        return false;
+      }
+      std::copy(data_[pos].begin(), data_[pos].end(), data);
+      std::copy(target_[pos].begin(), target_[pos].end(), target);
+      return true;
+    }
+    const std::vector<std::vector<T>> &data_;
+    const std::vector<std::vector<T>> &target_;
+  };
+  // the shape is checked once by DatasetMatch
+  struct DatasetSample {
+    explicit DatasetSample(const Dataset &data) : data_(data) {}
+    inline int size() const { return data_.size(); }
+    bool Load(int pos, int, int, T *data, T *target) const {
+      data_.LoadSample(pos, data);
+      data_.LoadTarget(pos, target);
+      return true;
+    }
+    const Dataset &data_;
+  };
+  // one streamed batch, row pos of the staging matrix
+  struct MatrixSample {
+    MatrixSample(const Matrix &data, const Matrix &target)
+        : data_(data), target_(target) {}
+    inline int size() const { return data_.rows(); }
+    bool Load(int pos, int, int, T *data, T *target) const {
+      std::copy(data_.Row(pos), data_.Row(pos) + data_.cols(), data);
+      std::copy(target_.Row(pos), target_.Row(pos) + target_.cols(), target);
+      return true;
+    }
+    const Matrix &data_;
+    const Matrix &target_;
+  };
+  // partial sum of one Evaluate task
+  struct EvaluateBuffer {
+    Workspace workspace_;
+    Matrix target_;
+    T loss_sum_ = 0;
+    int right_count_ = 0;
+    std::vector<std::vector<int>> confusion_matrix_;
+  };
 
 public:
-  NeuralNetwork() = default;
-  ~NeuralNetwork() = default;
-  NeuralNetwork(const NeuralNetwork &) = delete;
-  NeuralNetwork &operator=(const NeuralNetwork &) = delete;
+  BasicNeuralNetwork() = default;
+  ~BasicNeuralNetwork() = default;
+  BasicNeuralNetwork(const BasicNeuralNetwork &) = delete;
+  BasicNeuralNetwork &operator=(const BasicNeuralNetwork &) = delete;
 
-  NeuralNetwork(const std::vector<int> &layer) { Init(layer); }
+  BasicNeuralNetwork(const std::vector<int> &layer) { Init(layer); }
 
   RC Init(const std::vector<int> &layer) {
     if (network_status_ != NETWORK_STATUS_UNINIT) {
@@ -59,40 +195,155 @@ public:
     learning_rate_ = 0.1;
     rand_seed_ = 0;
 
-    softmax_function_ = SoftmaxFactory::Create(SOFTMAX_NONE);
-    loss_function_ = LossFactory::Create(LOSS_MSE);
-    activate_function_ = ActivateFactory::Create(ACTIVATE_SIGMOID);
-    param_init_function_ = ParamInitFactory::Create(PARAM_INIT_ZERO);
-    optimizer_function_ = OptimizerFactory::Create(OPTIMIZER_SGD, layer_);
+    softmax_function_ = SoftmaxFactory::Create<T>(SOFTMAX_NONE);
+    loss_function_ = LossFactory::Create<T>(LOSS_MSE);
+    activate_function_ = ActivateFactory::Create<T>(ACTIVATE_SIGMOID);
+    param_init_function_ = ParamInitFactory::Create<T>(PARAM_INIT_ZERO);
+    ApplyMathAccuracy();
 
     InitParamWithLayer(layer);
+    optimizer_function_ = OptimizerFactory::Create<T>(OPTIMIZER_SGD, layer_);
     param_init_function_->InitParam(neuron_weight_, neuron_bias_);
 
     network_status_ = NETWORK_STATUS_INIT;
     return SUCCESS;
   }
 
-  RC Train(const std::vector<std::vector<double>> &data,
-           const std::vector<std::vector<double>> &target,
-           std::function<void(NeuralNetwork &network, int epoch_num,
+  RC Train(const std::vector<std::vector<T>> &data,
+           const std::vector<std::vector<T>> &target,
+           std::function<void(BasicNeuralNetwork &network, int epoch_num,
                               bool &early_stop)>
                each_epoch_call = nullptr,
-           int epoch_num = 0, int batch_num = 1, double learning_rate = 0) {
+           int epoch_num = 0, int batch_num = 1, T learning_rate = 0,
+           int num_threads = 1) {
+    if (data.size() != target.size()) {
+      err_msg_ = "[NeuralNetwork::Train] Invalid data input in size";
+      return INVALID_DATA;
+    }
+    return TrainSample(VectorSample(data, target), each_epoch_call,
+                       epoch_num, batch_num, learning_rate, num_threads);
+  }
+
+  // the same as above, a batch is converted from the compact store when it
+  // is assembled
+  RC Train(const Dataset &data, EpochCallback each_epoch_call = nullptr,
+           int epoch_num = 0, int batch_num = 1, T learning_rate = 0,
+           int num_threads = 1) {
     if (network_status_ != NETWORK_STATUS_INIT) {
       err_msg_ = "[NeuralNetwork::Train] Network not init";
       return NOT_INIT;
     }
-    if (data.size() != target.size() || batch_num <= 0) {
-      err_msg_ = "[NeuralNetwork::Train] Invalid data input in size";
+    if (!DatasetMatch(data)) {
+      err_msg_ = "[NeuralNetwork::Train] Dataset not match network";
+      return INVALID_DATA;
+    }
+    return TrainSample(DatasetSample(data), each_epoch_call, epoch_num,
+                       batch_num, learning_rate, num_threads);
+  }
+
+  // batch come from the source, for data larger than memory. a step take
+  // batch_num sample, a pass end at the first short batch and the source is
+  // reset for the next one, epoch_num 0 train a single pass. a stream can not
+  // be sharded, so the async mode train synchronously here
+  RC Train(DataSource<T> &source, EpochCallback each_epoch_call = nullptr,
+           int epoch_num = 0, int batch_num = 1, T learning_rate = 0,
+           int num_threads = 1) {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      err_msg_ = "[NeuralNetwork::Train] Network not init";
+      return NOT_INIT;
+    }
+    int last_layer = layer_.size() - 1;
+    long long size_hint = source.SizeHint();
+    if (source.sample_size() != layer_[0] ||
+        source.target_size() != layer_[last_layer] || batch_num <= 0 ||
+        num_threads <= 0 || (size_hint >= 0 && batch_num > size_hint)) {
+      err_msg_ = "[NeuralNetwork::Train] Data source not match network";
+      return INVALID_DATA;
+    }
+    if (!source.Reset()) {
+      err_msg_ = "[NeuralNetwork::Train] " + source.err_msg();
       return INVALID_DATA;
     }
+    InitLearningRate(learning_rate);
+
+    Matrix data(batch_num, layer_[0]);
+    Matrix target(batch_num, layer_[last_layer]);
+    MatrixSample sample(data, target);
+    std::vector<int> index_pos(batch_num);
+    for (int i = 0; i < batch_num; i++) {
+      index_pos[i] = i;
+    }
+    int worker_num = std::min(num_threads, batch_num);
+    train_buffer_.resize(worker_num);
+    for (auto &buffer : train_buffer_) {
+      PrepareTrainBuffer(buffer);
+    }
+    std::vector<RC> worker_rc(worker_num, SUCCESS);
 
-    // init learning_rate
+    // step in the current pass
+    int pass_step = 0;
+    for (int i = 0; epoch_num == 0 || i < epoch_num;) {
+      int count = source.NextBatch(batch_num, data.data(), target.data());
+      if (count < 0) {
+        err_msg_ = "[NeuralNetwork::Train] " + source.err_msg();
+        return INVALID_DATA;
+      }
+      if (count < batch_num) {
+        if (pass_step == 0) {
+          err_msg_ = "[NeuralNetwork::Train] Data source has no whole batch";
+          return INVALID_DATA;
+        }
+        if (epoch_num == 0) {
+          break;
+        }
+        if (!source.Reset()) {
+          err_msg_ = "[NeuralNetwork::Train] " + source.err_msg();
+          return INVALID_DATA;
+        }
+        pass_step = 0;
+        continue;
+      }
+      pass_step++;
+      auto rc = TrainBatch(sample, index_pos, 0, batch_num, worker_rc);
+      if (rc != SUCCESS) {
+        return rc;
+      }
+
+      auto early_stop = false;
+      if (each_epoch_call != nullptr) {
+        each_epoch_call(*this, i, early_stop);
+        if (early_stop) {
+          break;
+        }
+      }
+      i++;
+    }
+    return SUCCESS;
+  }
+
+private:
+  void InitLearningRate(T learning_rate) {
     if (learning_rate != 0) {
       learning_rate_ = learning_rate;
     } else {
       learning_rate_ = (learning_rate_ != 0) ? learning_rate_ : 0.1;
     }
+  }
+
+  template <typename Sample>
+  RC TrainSample(const Sample &data, EpochCallback each_epoch_call,
+                 int epoch_num, int batch_num, T learning_rate,
+                 int num_threads) {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      err_msg_ = "[NeuralNetwork::Train] Network not init";
+      return NOT_INIT;
+    }
+    if (batch_num <= 0 || batch_num > data.size() || num_threads <= 0) {
+      err_msg_ = "[NeuralNetwork::Train] Invalid data input in size";
+      return INVALID_DATA;
+    }
+
+    InitLearningRate(learning_rate);
 
     // init batch random
     std::vector<int> index_pos(data.size());
@@ -101,8 +352,23 @@ public:
     }
     Random::RandomShuffle(index_pos);
     auto max_batch_num = data.size() / batch_num;
-
     epoch_num = epoch_num == 0 ? data.size() : epoch_num;
+
+    // a sync worker need at least one sample of the batch, an async one a
+    // whole batch in its shard
+    int worker_num = train_mode_ == TRAIN_MODE_ASYNC
+                         ? std::min<int>(num_threads, max_batch_num)
+                         : std::min(num_threads, batch_num);
+    train_buffer_.resize(worker_num);
+    for (auto &buffer : train_buffer_) {
+      PrepareTrainBuffer(buffer);
+    }
+    if (train_mode_ == TRAIN_MODE_ASYNC && worker_num > 1) {
+      return TrainAsync(data, each_epoch_call, index_pos, epoch_num,
+                        batch_num, worker_num);
+    }
+    std::vector<RC> worker_rc(worker_num, SUCCESS);
+
     for (int i = 0; i < epoch_num; i++) {
 
       auto init_batch_num = (i % max_batch_num) * batch_num;
@@ -110,23 +376,10 @@ public:
         Random::RandomShuffle(index_pos);
       }
 
-      for (int j = (i % max_batch_num) * batch_num;
-           j < init_batch_num + batch_num; j += 1) {
-        auto data_pos = j;
-        auto rc = ForwardPropagation(data[data_pos]);
-        if (rc != SUCCESS) {
-          return rc;
-        }
-        rc = BackPropagation(data[data_pos], target[data_pos]);
-        if (rc != SUCCESS) {
-          return rc;
-        }
-
-        // update neuron
-        rc = UpdateAllNeuron();
-        if (rc != SUCCESS) {
-          return rc;
-        }
+      auto rc = TrainBatch(data, index_pos, init_batch_num, batch_num,
+                           worker_rc);
+      if (rc != SUCCESS) {
+        return rc;
       }
 
       // callback
@@ -141,17 +394,129 @@ public:
     return SUCCESS;
   }
 
-  RC Predict(const std::vector<double> &data, std::vector<double> &result) {
-    auto rc = ForwardPropagation(data);
+  // every worker forward and backward its slice of the batch into its own
+  // gradient, the sum of them is then applied once
+  template <typename Sample>
+  RC TrainBatch(const Sample &data, const std::vector<int> &index_pos,
+                int init_batch_num, int batch_num,
+                std::vector<RC> &worker_rc) {
+    int worker_num = worker_rc.size();
+    ParallelRun(worker_num, [&](int worker) {
+      train_buffer_[worker].keep_gathered_ = worker_num == 1;
+      int begin = init_batch_num + batch_num * worker / worker_num;
+      int end = init_batch_num + batch_num * (worker + 1) / worker_num;
+      worker_rc[worker] = CalcBatchGradient(data, index_pos, begin,
+                                            end - begin,
+                                            train_buffer_[worker]);
+    });
+    for (int j = 0; j < worker_num; j++) {
+      if (worker_rc[j] != SUCCESS) {
+        err_msg_ = train_buffer_[j].err_msg_;
+        return worker_rc[j];
+      }
+    }
+    ReduceGradient(worker_num);
+    return UpdateAllNeuronBatch(train_buffer_[0], *optimizer_function_,
+                                batch_num, dynamic_loss_scale_);
+  }
+
+public:
+  RC Predict(const std::vector<T> &data, std::vector<T> &result) {
+    auto rc = Predict(data, result, workspace_);
+    if (rc != SUCCESS) {
+      err_msg_ = workspace_.err_msg_;
+    }
+    return rc;
+  }
+
+  // const version, safe to call from many threads at once as long as each
+  // thread pass its own workspace and nobody train the network meanwhile
+  RC Predict(const std::vector<T> &data, std::vector<T> &result,
+             Workspace &workspace) const {
+    auto rc = ForwardPropagation(data.data(), data.size(), nullptr, workspace);
+    if (rc != SUCCESS) {
+      return rc;
+    }
+    auto &output = workspace.neuron_output_[layer_.size() - 1];
+    result.assign(output.begin(), output.end());
+    return SUCCESS;
+  }
+
+  // read input in place and write the output layer straight to result, which
+  // must hold last layer size. no heap allocation once the workspace is warm
+  RC Predict(Span<const T> data, Span<T> result) {
+    auto rc = Predict(data, result, workspace_);
+    if (rc != SUCCESS) {
+      err_msg_ = workspace_.err_msg_;
+    }
+    return rc;
+  }
+
+  RC Predict(Span<const T> data, Span<T> result, Workspace &workspace) const {
+    if (layer_.size() == 0 || result.size() != layer_[layer_.size() - 1]) {
+      workspace.err_msg_ = "[NeuralNetwork::Predict] Invalid result size";
+      return INVALID_DATA;
+    }
+    return ForwardPropagation(data.data(), data.size(), result.data(),
+                              workspace);
+  }
+
+  RC Predict(const Dataset &data, int index, std::vector<T> &result) {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      err_msg_ = "[NeuralNetwork::Predict] Network not init";
+      return NOT_INIT;
+    }
+    if (!DatasetMatch(data) || index < 0 || index >= data.size()) {
+      err_msg_ = "[NeuralNetwork::Predict] Invalid data input";
+      return INVALID_DATA;
+    }
+    // the forward pass never use slot 0, stage the converted input there
+    auto &input = workspace_.neuron_output_;
+    input.resize(layer_.size());
+    input[0].resize(layer_[0]);
+    data.LoadSample(index, input[0].data());
+    result.resize(layer_[layer_.size() - 1]);
+    auto rc = ForwardPropagation(input[0].data(), layer_[0], result.data(),
+                                 workspace_);
+    if (rc != SUCCESS) {
+      err_msg_ = workspace_.err_msg_;
+    }
+    return rc;
+  }
+
+  // inputs is N x layer[0], one sample per row; outputs become N x last layer
+  RC PredictBatch(const Matrix &inputs, Matrix &outputs) {
+    auto rc = PredictBatch(inputs, outputs, workspace_);
+    if (rc != SUCCESS) {
+      err_msg_ = workspace_.err_msg_;
+    }
+    return rc;
+  }
+
+  RC PredictBatch(const Matrix &inputs, Matrix &outputs,
+                  Workspace &workspace) const {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      workspace.err_msg_ = "[NeuralNetwork::PredictBatch] Network not init";
+      return NOT_INIT;
+    }
+    if (inputs.cols() != layer_[0]) {
+      workspace.err_msg_ = "[NeuralNetwork::PredictBatch] Invalid data input";
+      return INVALID_DATA;
+    }
+    auto &batch_output = workspace.batch_output_;
+    batch_output.resize(layer_.size());
+    batch_output[0] = inputs;
+    auto rc = ForwardPropagationBatch(batch_output, workspace.sparse_,
+                                      workspace.err_msg_);
     if (rc != SUCCESS) {
       return rc;
     }
-    result = neuron_output_[layer_.size() - 1];
+    outputs = batch_output[layer_.size() - 1];
     return SUCCESS;
   }
 
-  RC CalcLoss(const std::vector<std::vector<double>> &data,
-              const std::vector<std::vector<double>> &target, double &loss) {
+  RC CalcLoss(const std::vector<std::vector<T>> &data,
+              const std::vector<std::vector<T>> &target, T &loss) {
     if (network_status_ != NETWORK_STATUS_INIT) {
       err_msg_ = "[NeuralNetwork::Train] Network not init";
       return NOT_INIT;
@@ -160,27 +525,89 @@ public:
       err_msg_ = "[NeuralNetwork::Train] Invalid data input in size";
       return INVALID_DATA;
     }
-    double loss_sum = 0;
+    T loss_sum = 0;
     for (int i = 0; i < data.size(); i++) {
-      auto rc = ForwardPropagation(data[i]);
+      auto rc = ForwardPropagation(data[i].data(), data[i].size(), nullptr,
+                                   workspace_);
       if (rc != SUCCESS) {
+        err_msg_ = workspace_.err_msg_;
         return rc;
       }
       loss_sum += loss_function_->AverageLoss(
-          target[i], neuron_output_[layer_.size() - 1]);
+          target[i], workspace_.neuron_output_[layer_.size() - 1]);
+    }
+    loss = loss_sum / data.size();
+    return SUCCESS;
+  }
+  RC CalcLoss(const Dataset &data, T &loss) {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      err_msg_ = "[NeuralNetwork::CalcLoss] Network not init";
+      return NOT_INIT;
+    }
+    if (!DatasetMatch(data) || data.size() == 0) {
+      err_msg_ = "[NeuralNetwork::CalcLoss] Invalid data input";
+      return INVALID_DATA;
+    }
+    AlignedVector<T> input(layer_[0]), output(layer_[layer_.size() - 1]),
+        target(output.size());
+    T loss_sum = 0;
+    for (int i = 0; i < data.size(); i++) {
+      data.LoadSample(i, input.data());
+      data.LoadTarget(i, target.data());
+      auto rc = ForwardPropagation(input.data(), input.size(), output.data(),
+                                   workspace_);
+      if (rc != SUCCESS) {
+        err_msg_ = workspace_.err_msg_;
+        return rc;
+      }
+      loss_sum += loss_function_->AverageLoss(target, output);
     }
     loss = loss_sum / data.size();
     return SUCCESS;
   }
 
+  // batched forward of batch_num sample per task on the thread pool, loss,
+  // top-1 accuracy and confusion matrix come out of one sweep
+  RC Evaluate(const std::vector<std::vector<T>> &data,
+              const std::vector<std::vector<T>> &target, EvaluateResult &result,
+              int batch_num = 256) {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      err_msg_ = "[NeuralNetwork::Evaluate] Network not init";
+      return NOT_INIT;
+    }
+    if (data.size() != target.size()) {
+      err_msg_ = "[NeuralNetwork::Evaluate] Invalid data input in size";
+      return INVALID_DATA;
+    }
+    return EvaluateSample(VectorSample(data, target), result, batch_num);
+  }
+
+  RC Evaluate(const Dataset &data, EvaluateResult &result,
+              int batch_num = 256) {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      err_msg_ = "[NeuralNetwork::Evaluate] Network not init";
+      return NOT_INIT;
+    }
+    if (!DatasetMatch(data)) {
+      err_msg_ = "[NeuralNetwork::Evaluate] Dataset not match network";
+      return INVALID_DATA;
+    }
+    return EvaluateSample(DatasetSample(data), result, batch_num);
+  }
+
   RC ExportNetworkParam(NetworkParam &param, NetworkOption &option) {
     if (network_status_ != NETWORK_STATUS_INIT) {
       err_msg_ = "[NeuralNetwork::ExportNetworkParam] Network not init";
       return NOT_INIT;
     }
     param.layer_ = layer_;
-    param.neuron_bias_ = neuron_bias_;
-    param.neuron_weight_ = neuron_weight_;
+    param.neuron_bias_.resize(layer_.size());
+    param.neuron_weight_.resize(layer_.size());
+    for (int i = 0; i < layer_.size(); i++) {
+      param.neuron_bias_[i].assign(neuron_bias_[i].begin(),
+                                   neuron_bias_[i].end());
+      param.neuron_weight_[i] = neuron_weight_[i].ToVector();
+    }
 
     option.learning_rate_ = learning_rate_;
     option.rand_seed_ = rand_seed_;
@@ -189,6 +616,7 @@ public:
     option.activate_type_ = activate_function_->GetActivateType();
     option.softmax_type_ = softmax_function_->GetSoftmaxType();
     option.optimizer_type_ = optimizer_function_->GetOptimizerType();
+    optimizer_function_->ExportState(param.optimizer_state_);
     return SUCCESS;
   }
 
@@ -202,29 +630,55 @@ public:
       err_msg_ = "[NeuralNetwork::ImportNetworkParam] Invalid layer size";
       return INVALID_DATA;
     }
-    layer_ = param.layer_;
-    neuron_bias_ = param.neuron_bias_;
-    neuron_weight_ = param.neuron_weight_;
+    if (param.neuron_bias_.size() != param.layer_.size() ||
+        param.neuron_weight_.size() != param.layer_.size()) {
+      err_msg_ = "[NeuralNetwork::ImportNetworkParam] Invalid param size";
+      return INVALID_DATA;
+    }
+    InitParamWithLayer(param.layer_);
+    for (int i = 0; i < layer_.size(); i++) {
+      if (param.neuron_bias_[i].size() != layer_[i]) {
+        err_msg_ = "[NeuralNetwork::ImportNetworkParam] Invalid bias size";
+        return INVALID_DATA;
+      }
+      neuron_bias_[i].assign(param.neuron_bias_[i].begin(),
+                             param.neuron_bias_[i].end());
+      if (i == 0) {
+        continue;
+      }
+      if (!neuron_weight_[i].Assign(param.neuron_weight_[i]) ||
+          neuron_weight_[i].rows() != layer_[i] ||
+          neuron_weight_[i].cols() != layer_[i - 1]) {
+        err_msg_ = "[NeuralNetwork::ImportNetworkParam] Invalid weight size";
+        return INVALID_DATA;
+      }
+    }
     learning_rate_ = option.learning_rate_;
     rand_seed_ = option.rand_seed_;
 
-    loss_function_ = LossFactory::Create(option.loss_type_);
-    activate_function_ = ActivateFactory::Create(option.activate_type_);
-    softmax_function_ = SoftmaxFactory::Create(option.softmax_type_);
-    param_init_function_ = ParamInitFactory::Create(PARAM_INIT_ZERO);
+    loss_function_ = LossFactory::Create<T>(option.loss_type_);
+    activate_function_ = ActivateFactory::Create<T>(option.activate_type_);
+    softmax_function_ = SoftmaxFactory::Create<T>(option.softmax_type_);
+    ApplyMathAccuracy();
+    param_init_function_ = ParamInitFactory::Create<T>(PARAM_INIT_ZERO);
     optimizer_function_ =
-        OptimizerFactory::Create(option.optimizer_type_, layer_);
-
-    for (int i = 0; i < layer_.size(); i++) {
-      neuron_output_.push_back(std::vector<double>(layer_[i], 0));
-      neuron_delta_.push_back(std::vector<double>(layer_[i], 0));
+        OptimizerFactory::Create<T>(option.optimizer_type_, layer_);
+    if (optimizer_function_ == nullptr) {
+      err_msg_ = "[NeuralNetwork::ImportNetworkParam] Invalid optimizer type";
+      return INVALID_DATA;
+    }
+    optimizer_function_->set_state_precision(state_precision_);
+    if (!param.optimizer_state_.empty() &&
+        !optimizer_function_->ImportState(param.optimizer_state_)) {
+      err_msg_ = "[NeuralNetwork::ImportNetworkParam] Invalid optimizer state";
+      return INVALID_DATA;
     }
 
     network_status_ = NETWORK_STATUS_INIT;
     return SUCCESS;
   }
 
-  RC Clone(const NeuralNetwork &old) {
+  RC Clone(const BasicNeuralNetwork &old) {
     if (network_status_ != NETWORK_STATUS_UNINIT) {
       err_msg_ = "[NeuralNetwork::Clone] Network has init";
       return ALREADY_INIT;
@@ -233,21 +687,31 @@ public:
     layer_ = old.layer_;
     neuron_bias_ = old.neuron_bias_;
     neuron_weight_ = old.neuron_weight_;
-    neuron_delta_ = old.neuron_delta_;
-    neuron_output_ = old.neuron_output_;
     learning_rate_ = old.learning_rate_;
     rand_seed_ = old.rand_seed_;
+    train_mode_ = old.train_mode_;
     network_status_ = old.network_status_;
 
-    loss_function_ = LossFactory::Create(old.loss_function_->GetLossType());
+    loss_function_ = LossFactory::Create<T>(old.loss_function_->GetLossType());
+    math_accuracy_ = old.math_accuracy_;
+    train_precision_ = old.train_precision_;
+    loss_scale_ = old.loss_scale_;
+    dynamic_loss_scale_ = old.dynamic_loss_scale_;
+    loss_scale_step_ = 0;
+    sparse_input_ = old.sparse_input_;
+    lazy_momentum_ = old.lazy_momentum_;
     activate_function_ =
-        ActivateFactory::Create(old.activate_function_->GetActivateType());
+        ActivateFactory::Create<T>(old.activate_function_->GetActivateType());
     softmax_function_ =
-        SoftmaxFactory::Create(old.softmax_function_->GetSoftmaxType());
+        SoftmaxFactory::Create<T>(old.softmax_function_->GetSoftmaxType());
+    ApplyMathAccuracy();
     param_init_function_ =
-        ParamInitFactory::Create(old.param_init_function_->GetParamInitType());
-    optimizer_function_ = OptimizerFactory::Create(
-        old.optimizer_function_->GetOptimizerType(), layer_);
+        ParamInitFactory::Create<T>(old.param_init_function_->GetParamInitType());
+    optimizer_function_ = OptimizerFactory::Create<T>(
+        old.optimizer_function_->GetOptimizerType(), layer_,
+        old.optimizer_function_->weight_decay());
+    state_precision_ = old.state_precision_;
+    optimizer_function_->set_state_precision(state_precision_);
 
     network_status_ = NETWORK_STATUS_INIT;
     return SUCCESS;
@@ -255,20 +719,69 @@ public:
 
 public:
   inline std::string err_msg() { return err_msg_; }
-  inline double learning_rate() { return learning_rate_; }
+  inline T learning_rate() { return learning_rate_; }
   inline int rand_seed() { return rand_seed_; }
   inline NetworkStatus network_status() { return network_status_; }
-  inline const std::vector<std::vector<std::vector<double>>> &neuron_weight() {
+  // neuron_weight()[layer] is a rows x cols view, [layer][row][col] to index
+  inline const std::vector<Matrix> &neuron_weight() {
     return neuron_weight_;
   }
-  inline const std::vector<std::vector<double>> &neuron_bias() {
+  inline const std::vector<AlignedVector<T>> &neuron_bias() {
     return neuron_bias_;
   }
 
-  inline void set_learning_rate(double rate) { learning_rate_ = rate; }
+  inline MathAccuracy math_accuracy() { return math_accuracy_; }
+  inline TrainMode train_mode() { return train_mode_; }
+  inline TrainPrecision train_precision() { return train_precision_; }
+  inline bool sparse_input() { return sparse_input_; }
+  inline bool lazy_momentum() { return lazy_momentum_; }
+  inline T loss_scale() { return loss_scale_; }
+  inline bool dynamic_loss_scale() { return dynamic_loss_scale_; }
+  inline StatePrecision optimizer_state_precision() {
+    return state_precision_;
+  }
+
+  inline void set_learning_rate(T rate) { learning_rate_ = rate; }
+  // accuracy tier of exp/sigmoid/tanh/softmax, not a model param so it is not in
+  // NetworkOption and the file format stay the same
+  inline void set_math_accuracy(MathAccuracy accuracy) {
+    math_accuracy_ = accuracy;
+    ApplyMathAccuracy();
+  }
   inline void set_random_seed(int seed) { rand_seed_ = seed; }
+  inline void set_train_mode(TrainMode mode) { train_mode_ = mode; }
+  inline void set_train_precision(TrainPrecision precision) {
+    train_precision_ = precision;
+  }
+  // batched forward and backward of the first layer only multiply the input
+  // columns that are nonzero somewhere in the batch, for 0/1 pixel or one
+  // hot feature. a batch denser than kSparseDensity stay on the dense path.
+  // sgd then step only those columns when the gradient is not reduced
+  // between threads, the same weights as the dense step
+  inline void set_sparse_input(bool sparse) { sparse_input_ = sparse; }
+  // with sparse input, momentum also step only the nonzero columns and hold
+  // the velocity of the others instead of decaying and applying it. faster,
+  // but the weights then differ from the dense and multi thread training
+  inline void set_lazy_momentum(bool lazy) { lazy_momentum_ = lazy; }
+  // the output delta is multiplied by scale before back propagation and the
+  // gradient divided by it before the step, so a small delta survive bf16
+  inline void set_loss_scale(T scale) { loss_scale_ = scale; }
+  // a step with inf or nan gradient is skipped and halve the scale, every
+  // kLossScaleWindow good step double it. only sync training adjust it
+  inline void set_dynamic_loss_scale(bool dynamic) {
+    dynamic_loss_scale_ = dynamic;
+    loss_scale_step_ = 0;
+  }
+  // storage of the optimizer moments, the weights keep T. like math accuracy
+  // it is not saved, the file always hold the state in double. reset the state
+  inline void set_optimizer_state_precision(StatePrecision precision) {
+    state_precision_ = precision;
+    if (optimizer_function_ != nullptr) {
+      optimizer_function_->set_state_precision(precision);
+    }
+  }
   inline RC set_loss_function(LossType type) {
-    loss_function_ = LossFactory::Create(type);
+    loss_function_ = LossFactory::Create<T>(type);
     if (loss_function_ == nullptr) {
       err_msg_ = "[NeuralNetwork::set_loss_function] Invalid loss type";
       return INVALID_DATA;
@@ -276,23 +789,25 @@ public:
     return SUCCESS;
   }
   inline RC set_activate_function(ActivateType type) {
-    activate_function_ = ActivateFactory::Create(type);
+    activate_function_ = ActivateFactory::Create<T>(type);
     if (activate_function_ == nullptr) {
       err_msg_ = "[NeuralNetwork::set_activate_function] Invalid activate type";
       return INVALID_DATA;
     }
+    ApplyMathAccuracy();
     return SUCCESS;
   }
   inline RC set_softmax_function(SoftmaxType type) {
-    softmax_function_ = SoftmaxFactory::Create(type);
+    softmax_function_ = SoftmaxFactory::Create<T>(type);
     if (softmax_function_ == nullptr) {
       err_msg_ = "[NeuralNetwork::set_softmax_function] Invalid softmax type";
       return INVALID_DATA;
     }
+    ApplyMathAccuracy();
     return SUCCESS;
   }
   inline RC set_param_init_function(ParamInitType type) {
-    param_init_function_ = ParamInitFactory::Create(type);
+    param_init_function_ = ParamInitFactory::Create<T>(type);
     if (param_init_function_ == nullptr) {
       err_msg_ =
           "[NeuralNetwork::set_param_init_function] Invalid param_init type";
@@ -301,211 +816,633 @@ public:
     param_init_function_->InitParam(neuron_weight_, neuron_bias_);
     return SUCCESS;
   }
-  inline RC set_optimizer_function(OptimizerType type) {
-    optimizer_function_ = OptimizerFactory::Create(type, layer_);
+  // weight_decay is the decoupled decay of OPTIMIZER_ADAMW. like math
+  // accuracy it is not saved, an imported adamw network use the default
+  inline RC set_optimizer_function(OptimizerType type,
+                                   T weight_decay = kAdamWWeightDecay) {
+    optimizer_function_ =
+        OptimizerFactory::Create<T>(type, layer_, weight_decay);
     if (optimizer_function_ == nullptr) {
       err_msg_ =
           "[NeuralNetwork::set_optimizer_function] Invalid optimizer type";
       return INVALID_DATA;
     }
+    optimizer_function_->set_state_precision(state_precision_);
     return SUCCESS;
   }
 
 private:
-  double CalcDelta(const double deriv_target, const double out) {
-    return deriv_target * activate_function_->DerivActivate(out);
+  template <typename Sample>
+  RC EvaluateSample(const Sample &data, EvaluateResult &result,
+                    int batch_num) {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      err_msg_ = "[NeuralNetwork::Evaluate] Network not init";
+      return NOT_INIT;
+    }
+    if (data.size() == 0 || batch_num <= 0) {
+      err_msg_ = "[NeuralNetwork::Evaluate] Invalid data input in size";
+      return INVALID_DATA;
+    }
+    int class_num = layer_[layer_.size() - 1];
+    int chunk_num = (data.size() + batch_num - 1) / batch_num;
+    int task_num = std::min(chunk_num, ThreadPool::Global().thread_num());
+    std::vector<EvaluateBuffer> buffer(task_num);
+    std::vector<RC> task_rc(task_num, SUCCESS);
+    ParallelRun(task_num, [&](int task) {
+      buffer[task].confusion_matrix_.assign(class_num,
+                                            std::vector<int>(class_num, 0));
+      for (int i = task; i < chunk_num && task_rc[task] == SUCCESS;
+           i += task_num) {
+        int begin = i * batch_num;
+        int size = std::min<int>(batch_num, data.size() - begin);
+        task_rc[task] = EvaluateBatch(data, begin, size, buffer[task]);
+      }
+    });
+
+    // merge in task order so the result not depend on scheduling
+    T loss_sum = 0;
+    int right_count = 0;
+    result.confusion_matrix_.assign(class_num, std::vector<int>(class_num, 0));
+    for (int i = 0; i < task_num; i++) {
+      if (task_rc[i] != SUCCESS) {
+        err_msg_ = buffer[i].workspace_.err_msg_;
+        return task_rc[i];
+      }
+      loss_sum += buffer[i].loss_sum_;
+      right_count += buffer[i].right_count_;
+      for (int j = 0; j < class_num; j++) {
+        for (int k = 0; k < class_num; k++) {
+          result.confusion_matrix_[j][k] += buffer[i].confusion_matrix_[j][k];
+        }
+      }
+    }
+    result.loss_ = loss_sum / data.size();
+    result.accuracy_ = right_count * 1.0 / data.size();
+    return SUCCESS;
+  }
+
+  void ApplyMathAccuracy() {
+    if (activate_function_ != nullptr) {
+      activate_function_->set_math_accuracy(math_accuracy_);
+    }
+    if (softmax_function_ != nullptr) {
+      softmax_function_->set_math_accuracy(math_accuracy_);
+    }
   }
 
   void InitParamWithLayer(const std::vector<int> &layer) {
     layer_ = layer;
-    neuron_output_.resize(layer.size());
-    neuron_delta_.resize(layer.size());
     neuron_bias_.resize(layer.size());
     neuron_weight_.resize(layer.size());
 
     for (int i = 0; i < layer.size(); i++) {
-      for (int j = 0; j < layer[i]; j++) {
-        neuron_bias_[i].push_back(0);
-        neuron_delta_[i].push_back(0);
-        neuron_output_[i].push_back(0);
-        if (i != 0) {
-          neuron_weight_[i].push_back(std::vector<double>(layer[i - 1], 0));
-        }
+      neuron_bias_[i].assign(layer[i], 0);
+      if (i != 0) {
+        neuron_weight_[i].Resize(layer[i], layer[i - 1]);
       }
     }
   }
 
-  RC UpdateNeuronOutput(const std::pair<int, int> &neuron_pos,
-                        const std::vector<double> &input) {
-    auto [x, y] = neuron_pos;
-    double result = neuron_bias_[x][y];
-    if (x >= layer_.size() || x < 0 || y >= layer_[x] || y < 0) {
-      err_msg_ = "[NeuralNetwork::UpdateNeuronOutput] Invalid data input";
+  // output = activate(weight * input + bias), softmax output layer keep
+  // the raw logits for Normalize
+  RC UpdateLayerOutput(int layer, const T *input, T *output,
+                       std::string &err_msg) const {
+    if (layer <= 0 || layer >= layer_.size()) {
+      err_msg = "[NeuralNetwork::UpdateLayerOutput] Invalid data input";
       return INVALID_DATA;
     }
-    if (x == 0) {
-      neuron_output_[x][y] = input[y];
+    std::copy(neuron_bias_[layer].begin(), neuron_bias_[layer].end(), output);
+    kernel::Gemv<T>(false, layer_[layer], layer_[layer - 1], 1,
+                    neuron_weight_[layer].data(), layer_[layer - 1], input, 1,
+                    output);
+    if (layer == layer_.size() - 1 &&
+        softmax_function_->GetSoftmaxType() != SOFTMAX_NONE) {
       return SUCCESS;
     }
-    for (int i = 0; i < layer_[x - 1]; i++) {
-      result += neuron_weight_[x][y][i] * neuron_output_[x - 1][i];
+    Span<T> all(output, layer_[layer]);
+    activate_function_->Activate(all, all);
+    return SUCCESS;
+  }
+
+  bool DatasetMatch(const Dataset &data) const {
+    return layer_.size() >= 2 && data.sample_size() == layer_[0] &&
+           data.class_num() == layer_[layer_.size() - 1];
+  }
+
+  // size the gradient on first use, no allocation after that
+  void PrepareTrainBuffer(TrainBuffer &buffer) const {
+    buffer.batch_output_.resize(layer_.size());
+    buffer.batch_delta_.resize(layer_.size());
+    buffer.weight_grad_.resize(layer_.size());
+    buffer.bias_grad_.resize(layer_.size());
+    for (int i = 1; i < layer_.size(); i++) {
+      if (buffer.weight_grad_[i].rows() != layer_[i] ||
+          buffer.weight_grad_[i].cols() != layer_[i - 1]) {
+        buffer.weight_grad_[i].Resize(layer_[i], layer_[i - 1]);
+      }
+      if (buffer.bias_grad_[i].size() != layer_[i]) {
+        buffer.bias_grad_[i].assign(layer_[i], 0);
+      }
+    }
+  }
+
+  // run on a worker thread, only write into the buffer
+  template <typename Sample>
+  RC CalcBatchGradient(const Sample &data, const std::vector<int> &index_pos,
+                       int begin, int size, TrainBuffer &buffer) const {
+    auto rc = LoadBatch(data, index_pos, begin, size, buffer);
+    if (rc != SUCCESS) {
+      return rc;
+    }
+    rc = ForwardPropagationBatch(buffer.batch_output_, buffer.sparse_,
+                                 buffer.err_msg_);
+    if (rc != SUCCESS) {
+      return rc;
+    }
+    return BackPropagationBatch(buffer);
+  }
+
+  template <typename Sample>
+  RC LoadBatch(const Sample &data, const std::vector<int> &index_pos,
+               int begin, int size, TrainBuffer &buffer) const {
+    int last_layer = layer_.size() - 1;
+    buffer.batch_output_[0].Resize(size, layer_[0]);
+    buffer.batch_target_.Resize(size, layer_[last_layer]);
+    for (int i = 0; i < size; i++) {
+      if (!data.Load(index_pos[begin + i], layer_[0], layer_[last_layer],
+                     buffer.batch_output_[0].Row(i),
+                     buffer.batch_target_.Row(i))) {
+        buffer.err_msg_ = "[NeuralNetwork::LoadBatch] Invalid data input";
+        return INVALID_DATA;
+      }
     }
-    result = activate_function_->Activate(result);
-    neuron_output_[x][y] = result;
     return SUCCESS;
   }
 
-  RC UpdateNeuronOutputSoftMax() {
-    if (layer_.size() < 2) {
-      err_msg_ =
-          "[NeuralNetwork::UpdateNeuronOutputSoftMax] Invalid data input";
+  // size the buffer on first use, no allocation after that. the input
+  // layer is read from caller memory so slot 0 stay empty
+  void PrepareWorkspace(Workspace &workspace) const {
+    auto &neuron_output = workspace.neuron_output_;
+    neuron_output.resize(layer_.size());
+    for (int i = 1; i < layer_.size(); i++) {
+      if (neuron_output[i].size() != layer_[i]) {
+        neuron_output[i].assign(layer_[i], 0);
+      }
+    }
+  }
+
+  // result may be nullptr, then the output stay in the workspace
+  RC ForwardPropagation(const T *data, int size, T *result,
+                        Workspace &workspace) const {
+    if (layer_.size() < 2 || size != layer_[0]) {
+      workspace.err_msg_ =
+          "[NeuralNetwork::ForwardPropagation] Invalid data input";
       return INVALID_DATA;
     }
-    std::vector<double> output;
-    int now_layer = layer_.size() - 1;
-    int last_layer = layer_.size() - 2;
-    for (int i = 0; i < layer_[now_layer]; i++) {
-      double now = neuron_bias_[now_layer][i];
-      for (int j = 0; j < layer_[last_layer]; j++) {
-        now += neuron_weight_[now_layer][i][j] * neuron_output_[last_layer][j];
+    PrepareWorkspace(workspace);
+    auto &neuron_output = workspace.neuron_output_;
+    int last_layer = layer_.size() - 1;
+    const T *input = data;
+    T *output = nullptr;
+    for (int i = 1; i < layer_.size(); i++) {
+      output = (i == last_layer && result != nullptr) ? result
+                                                      : neuron_output[i].data();
+      auto rc = UpdateLayerOutput(i, input, output, workspace.err_msg_);
+      if (rc != SUCCESS) {
+        return rc;
       }
-      output.push_back(now);
+      input = output;
+    }
+    // update if exist softmax
+    if (softmax_function_->GetSoftmaxType() != SOFTMAX_NONE) {
+      Span<T> all(output, layer_[last_layer]);
+      softmax_function_->Normalize(all, all);
     }
-    softmax_function_->Normalize(output, neuron_output_[now_layer]);
     return SUCCESS;
   }
 
-  void ClearNeuronDelta() {
-    for (int i = 0; i < layer_.size(); i++) {
-      for (int j = 0; j < layer_[i]; j++) {
-        neuron_delta_[i][j] = 0;
+  // keep the columns of input with a nonzero value and the same columns of
+  // the first layer weight, return false and clear the column list when the
+  // batch is too dense for the gather to pay off
+  bool GatherSparseInput(const Matrix &input, SparseBuffer &sparse) const {
+    auto &column = sparse.column_;
+    auto &nonzero = sparse.nonzero_;
+    column.clear();
+    if (!sparse_input_) {
+      return false;
+    }
+    int cols = input.cols();
+    nonzero.assign(cols, 0);
+    for (int i = 0; i < input.rows(); i++) {
+      const T *row = input.Row(i);
+      for (int j = 0; j < cols; j++) {
+        nonzero[j] |= row[j] != 0;
+      }
+    }
+    for (int j = 0; j < cols; j++) {
+      if (nonzero[j]) {
+        column.push_back(j);
       }
     }
+    if (column.size() > cols * kSparseDensity) {
+      column.clear();
+      return false;
+    }
+    // an all zero batch still need one column for the matmul shape
+    if (column.empty()) {
+      column.push_back(0);
+    }
+    int size = column.size();
+    sparse.input_.Reshape(input.rows(), size);
+    for (int i = 0; i < input.rows(); i++) {
+      const T *from = input.Row(i);
+      T *to = sparse.input_.Row(i);
+      for (int j = 0; j < size; j++) {
+        to[j] = from[column[j]];
+      }
+    }
+    auto &weight = neuron_weight_[1];
+    sparse.weight_.Reshape(weight.rows(), size);
+    for (int i = 0; i < weight.rows(); i++) {
+      const T *from = weight.Row(i);
+      T *to = sparse.weight_.Row(i);
+      for (int j = 0; j < size; j++) {
+        to[j] = from[column[j]];
+      }
+    }
+    return true;
   }
 
-  RC UpdateNeuronDelta(const std::pair<int, int> &neuron_pos,
-                       const std::vector<double> &target) {
-    auto [x, y] = neuron_pos;
-    double result = 0;
-    if (x < 0 || x >= layer_.size() || y < 0 || y >= layer_[x]) {
-      err_msg_ = "[NeuralNetwork::UpdateNeuronDelta] Invalid data input";
+  // batch_output[0] must hold the N x layer_[0] input before call
+  RC ForwardPropagationBatch(std::vector<Matrix> &batch_output,
+                             SparseBuffer &sparse,
+                             std::string &err_msg) const {
+    if (batch_output.size() != layer_.size() ||
+        batch_output[0].cols() != layer_[0]) {
+      err_msg = "[NeuralNetwork::ForwardPropagationBatch] Invalid data input";
       return INVALID_DATA;
     }
-    double deriv_target = 0;
-    if (x == layer_.size() - 1) {
-      if (softmax_function_->GetSoftmaxType() == SOFTMAX_NONE) {
-        deriv_target = (double)(loss_function_->DerivLoss(
-                           target[y], neuron_output_[x][y])) /
-                       (double)target.size();
-        result = CalcDelta(deriv_target, neuron_output_[x][y]);
+    int last_layer = layer_.size() - 1;
+    bool use_softmax = softmax_function_->GetSoftmaxType() != SOFTMAX_NONE;
+    bool bf16 = train_precision_ == TRAIN_PRECISION_BF16;
+    for (int i = 1; i < layer_.size(); i++) {
+      auto &output = batch_output[i];
+      if (i == 1 && GatherSparseInput(batch_output[0], sparse)) {
+        kernel::MatMul(sparse.input_, false, sparse.weight_, true, output,
+                       bf16);
       } else {
-        result = softmax_function_->CalcDelta(neuron_output_[x][y], target[y],
-                                              loss_function_);
+        kernel::MatMul(batch_output[i - 1], false, neuron_weight_[i], true,
+                       output, bf16);
       }
-    } else {
-      for (int i = 0; i < layer_[x + 1]; i++) {
-        deriv_target += neuron_weight_[x + 1][i][y] * neuron_delta_[x + 1][i];
+      for (int j = 0; j < output.rows(); j++) {
+        T *row = output.Row(j);
+        for (int k = 0; k < layer_[i]; k++) {
+          row[k] += neuron_bias_[i][k];
+        }
+      }
+      if (!(use_softmax && i == last_layer)) {
+        Span<T> all(output.data(), output.size());
+        activate_function_->Activate(all, all);
       }
-      result = CalcDelta(deriv_target, neuron_output_[x][y]);
     }
-    neuron_delta_[x][y] = result;
+    // softmax normalize each sample's logits in place
+    if (use_softmax) {
+      softmax_function_->Normalize(batch_output[last_layer]);
+    }
     return SUCCESS;
   }
 
-  RC UpdateAllNeuron() {
-    if (layer_.size() == 0) {
-      err_msg_ = "[NeuralNetwork::UpdateAllNeuron] Invalid data input";
+  template <typename Sample>
+  RC EvaluateBatch(const Sample &data, int begin, int size,
+                   EvaluateBuffer &buffer) const {
+    auto &workspace = buffer.workspace_;
+    auto &batch_output = workspace.batch_output_;
+    auto &target = buffer.target_;
+    int last_layer = layer_.size() - 1;
+    batch_output.resize(layer_.size());
+    batch_output[0].Reshape(size, layer_[0]);
+    target.Reshape(size, layer_[last_layer]);
+    for (int i = 0; i < size; i++) {
+      if (!data.Load(begin + i, layer_[0], layer_[last_layer],
+                     batch_output[0].Row(i), target.Row(i))) {
+        workspace.err_msg_ = "[NeuralNetwork::Evaluate] Invalid data input";
+        return INVALID_DATA;
+      }
+    }
+    auto rc = ForwardPropagationBatch(batch_output, workspace.sparse_,
+                                      workspace.err_msg_);
+    if (rc != SUCCESS) {
+      return rc;
+    }
+    auto &output = batch_output[last_layer];
+    for (int i = 0; i < size; i++) {
+      auto expect = target[i];
+      buffer.loss_sum_ += loss_function_->AverageLoss(expect, output[i]);
+      int predict = std::max_element(output[i].begin(), output[i].end()) -
+                    output[i].begin();
+      int label = std::max_element(expect.begin(), expect.end()) -
+                  expect.begin();
+      buffer.right_count_ += predict == label;
+      buffer.confusion_matrix_[label][predict]++;
+    }
+    return SUCCESS;
+  }
+
+  // ForwardPropagationBatch has run before, target is in batch_target_
+  RC BackPropagationBatch(TrainBuffer &buffer) const {
+    auto &batch_output = buffer.batch_output_;
+    auto &batch_delta = buffer.batch_delta_;
+    auto &batch_target = buffer.batch_target_;
+    int last_layer = layer_.size() - 1;
+    auto &last_output = batch_output[last_layer];
+    if (layer_.size() < 2 || batch_target.rows() != last_output.rows() ||
+        batch_target.cols() != last_output.cols()) {
+      buffer.err_msg_ =
+          "[NeuralNetwork::BackPropagationBatch] Invalid data input";
       return INVALID_DATA;
     }
-    for (int i = 0; i < layer_.size(); i++) {
-      for (int j = 0; j < layer_[i]; j++) {
-        auto rc = UpdateSingleNeuron({i, j});
-        if (rc != SUCCESS) {
-          return rc;
+
+    // delta of output layer
+    auto &last_delta = batch_delta[last_layer];
+    last_delta.Resize(last_output.rows(), last_output.cols());
+    bool use_softmax = softmax_function_->GetSoftmaxType() != SOFTMAX_NONE;
+    for (int i = 0; i < last_output.rows(); i++) {
+      for (int j = 0; j < last_output.cols(); j++) {
+        T output = last_output(i, j), target = batch_target(i, j);
+        if (use_softmax) {
+          last_delta(i, j) =
+              softmax_function_->CalcDelta(output, target, loss_function_);
+        } else {
+          last_delta(i, j) = loss_function_->DerivLoss(target, output) /
+                             (T)last_output.cols();
+        }
+      }
+    }
+    if (!use_softmax) {
+      activate_function_->DerivActivate(
+          Span<const T>(last_output.data(), last_output.size()),
+          Span<T>(last_delta.data(), last_delta.size()));
+    }
+    if (loss_scale_ != 1) {
+      for (auto &value : last_delta) {
+        value *= loss_scale_;
+      }
+    }
+    bool bf16 = train_precision_ == TRAIN_PRECISION_BF16;
+
+    // delta of hidden layer, delta[i] = delta[i + 1] * weight[i + 1]
+    for (int i = last_layer - 1; i > 0; i--) {
+      auto &delta = batch_delta[i];
+      kernel::MatMul(batch_delta[i + 1], false, neuron_weight_[i + 1], false,
+                     delta, bf16);
+      activate_function_->DerivActivate(
+          Span<const T>(batch_output[i].data(), batch_output[i].size()),
+          Span<T>(delta.data(), delta.size()));
+    }
+
+    // sum gradient of all sample in batch
+    buffer.gathered_grad_ = false;
+    for (int i = 1; i < layer_.size(); i++) {
+      if (i == 1 && !buffer.sparse_.column_.empty()) {
+        // every other column had zero input in the whole batch
+        kernel::MatMul(batch_delta[1], true, buffer.sparse_.input_, false,
+                       buffer.sparse_.weight_grad_, bf16);
+        buffer.gathered_grad_ = buffer.keep_gathered_;
+        if (!buffer.gathered_grad_) {
+          ScatterSparseGradient(buffer.sparse_, buffer.weight_grad_[1]);
+        }
+      } else {
+        kernel::MatMul(batch_delta[i], true, batch_output[i - 1], false,
+                       buffer.weight_grad_[i], bf16);
+      }
+      auto &bias_grad = buffer.bias_grad_[i];
+      std::fill(bias_grad.begin(), bias_grad.end(), 0);
+      for (int j = 0; j < batch_delta[i].rows(); j++) {
+        const T *delta_row = batch_delta[i].Row(j);
+        for (int k = 0; k < layer_[i]; k++) {
+          bias_grad[k] += delta_row[k];
         }
       }
     }
     return SUCCESS;
   }
 
-  RC UpdateSingleNeuron(const std::pair<int, int> &neuron_pos) {
-    auto [x, y] = neuron_pos;
-    if (x >= layer_.size() || x < 0 || y >= layer_[x] || y < 0) {
-      err_msg_ = "[NeuralNetwork::UpdateNeuron] Invalid data input";
-      return INVALID_DATA;
+  // full first layer gradient from the gathered one, zero elsewhere
+  void ScatterSparseGradient(const SparseBuffer &sparse,
+                             Matrix &weight_grad) const {
+    weight_grad.Fill(0);
+    auto &column = sparse.column_;
+    for (int i = 0; i < weight_grad.rows(); i++) {
+      const T *from = sparse.weight_grad_.Row(i);
+      T *to = weight_grad.Row(i);
+      for (int j = 0; j < column.size(); j++) {
+        to[column[j]] = from[j];
+      }
     }
-    if (x == 0) {
-      return SUCCESS;
+  }
+
+  bool GradientFinite(const TrainBuffer &buffer) {
+    auto finite = [](const T *data, std::size_t size) {
+      return std::all_of(data, data + size,
+                         [](T value) { return std::isfinite(value); });
+    };
+    for (int i = 1; i < layer_.size(); i++) {
+      auto &weight_grad = i == 1 && buffer.gathered_grad_
+                              ? buffer.sparse_.weight_grad_
+                              : buffer.weight_grad_[i];
+      auto &bias_grad = buffer.bias_grad_[i];
+      if (!finite(weight_grad.data(), weight_grad.size()) ||
+          !finite(bias_grad.data(), bias_grad.size())) {
+        return false;
+      }
     }
-    double delta = neuron_delta_[x][y];
-    double change_value =
-        optimizer_function_->CalcChangeValue(delta, learning_rate_, neuron_pos);
-    for (int i = 0; i < layer_[x - 1]; i++) {
-      double delta_weight = delta * neuron_output_[x - 1][i];
-      neuron_weight_[x][y][i] -= optimizer_function_->CalcChangeValue(
-          delta_weight, learning_rate_, neuron_pos, i);
+    return true;
+  }
+
+  // pairwise sum the gradient of every worker into worker 0, each thread
+  // own a slice of the element so the add order is fixed
+  void ReduceGradient(int worker_num) {
+    if (worker_num <= 1) {
+      return;
     }
-    neuron_bias_[x][y] -= change_value;
-    return SUCCESS;
+    auto reduce = [&](int layer, bool weight, int begin, int end) {
+      for (int stride = 1; stride < worker_num; stride *= 2) {
+        for (int w = 0; w + stride < worker_num; w += 2 * stride) {
+          T *to = weight ? train_buffer_[w].weight_grad_[layer].data()
+                         : train_buffer_[w].bias_grad_[layer].data();
+          const T *from =
+              weight ? train_buffer_[w + stride].weight_grad_[layer].data()
+                     : train_buffer_[w + stride].bias_grad_[layer].data();
+          for (int k = begin; k < end; k++) {
+            to[k] += from[k];
+          }
+        }
+      }
+    };
+    ParallelRun(worker_num, [&](int worker) {
+      for (int i = 1; i < layer_.size(); i++) {
+        int weight_size = layer_[i] * layer_[i - 1];
+        reduce(i, true, (std::size_t)weight_size * worker / worker_num,
+               (std::size_t)weight_size * (worker + 1) / worker_num);
+        reduce(i, false, layer_[i] * worker / worker_num,
+               layer_[i] * (worker + 1) / worker_num);
+      }
+    });
   }
 
-  RC ForwardPropagation(const std::vector<double> &data) {
-    if (layer_.size() == 0 || data.size() != layer_[0]) {
-      err_msg_ = "[NeuralNetwork::ForwardPropagation] Invalid data input";
+  // apply optimizer once with the batch average gradient, dynamic_scale
+  // check the gradient and adjust the loss scale. optimizer and its state
+  // must not be shared with another thread
+  RC UpdateAllNeuronBatch(TrainBuffer &buffer, OptimizerFunction<T> &optimizer,
+                          int batch_size, bool dynamic_scale) {
+    if (layer_.size() == 0 || batch_size <= 0) {
+      err_msg_ = "[NeuralNetwork::UpdateAllNeuronBatch] Invalid data input";
       return INVALID_DATA;
     }
-    for (int i = 0; i < layer_.size(); i++) {
-      for (int j = 0; j < layer_[i]; j++) {
-        auto rc = UpdateNeuronOutput({i, j}, data);
-        if (rc != SUCCESS) {
-          return rc;
+    if (dynamic_scale && !GradientFinite(buffer)) {
+      loss_scale_ = std::max<T>(loss_scale_ / 2, 1);
+      loss_scale_step_ = 0;
+      return SUCCESS;
+    }
+    T scale = 1.0 / (batch_size * loss_scale_);
+    for (int i = 1; i < layer_.size(); i++) {
+      Span<T> weight(neuron_weight_[i].data(), neuron_weight_[i].size());
+      auto &weight_grad = buffer.weight_grad_[i];
+      auto &state = optimizer.weight_state(i);
+      // a gathered gradient step only its column when the optimizer can
+      bool updated = false;
+      if (i == 1 && buffer.gathered_grad_) {
+        auto &sparse = buffer.sparse_;
+        updated = optimizer.UpdateColumn(weight, layer_[0], sparse.column_,
+                                         sparse.weight_grad_.data(), state,
+                                         learning_rate_, scale, lazy_momentum_);
+        if (!updated) {
+          ScatterSparseGradient(sparse, weight_grad);
         }
       }
-    }
-    // update if exist softmax
-    if (softmax_function_->GetSoftmaxType() != SOFTMAX_NONE) {
-      auto rc = UpdateNeuronOutputSoftMax();
-      if (rc != SUCCESS) {
-        return rc;
+      if (!updated) {
+        optimizer.Update(weight,
+                         Span<const T>(weight_grad.data(), weight_grad.size()),
+                         state, learning_rate_, scale);
       }
+      optimizer.Update(neuron_bias_[i], buffer.bias_grad_[i],
+                       optimizer.bias_state(i), learning_rate_, scale);
+    }
+    if (dynamic_scale && ++loss_scale_step_ == kLossScaleWindow) {
+      loss_scale_ *= 2;
+      loss_scale_step_ = 0;
     }
     return SUCCESS;
   }
 
-  RC BackPropagation(const std::vector<double> &input,
-                     const std::vector<double> &target) {
-    if (layer_.size() == 0 || target.size() != layer_[layer_.size() - 1]) {
-      err_msg_ = "[NeuralNetwork::BackPropagation] Invalid data input";
-      return INVALID_DATA;
+  // every worker own a contiguous shard of index_pos and run step worker,
+  // worker + worker_num, ... it read and write the shared weight without
+  // lock, so concurrent update may overwrite each other by design. the
+  // optimizer state is not shared: worker 0 step the network's own, every
+  // other worker a copy of it taken at the start and dropped at the end, so
+  // the adam step count and moments are never raced. callback run on worker
+  // 0 while the others keep going
+  template <typename Sample>
+  RC TrainAsync(const Sample &data, const EpochCallback &each_epoch_call,
+                const std::vector<int> &index_pos, int epoch_num,
+                int batch_num, int worker_num) {
+    int shard_size = index_pos.size() / worker_num;
+    int max_batch_num = shard_size / batch_num;
+    std::atomic<bool> stop(false);
+    std::vector<RC> worker_rc(worker_num, SUCCESS);
+    std::vector<std::shared_ptr<OptimizerFunction<T>>> optimizer(
+        worker_num, optimizer_function_);
+    std::vector<T> state;
+    optimizer_function_->ExportState(state);
+    for (int i = 1; i < worker_num; i++) {
+      optimizer[i] = OptimizerFactory::Create<T>(
+          optimizer_function_->GetOptimizerType(), layer_,
+          optimizer_function_->weight_decay());
+      optimizer[i]->set_state_precision(state_precision_);
+      optimizer[i]->ImportState(state);
     }
-    // ForwardPropagation has run before
-    for (int i = layer_.size() - 1; i >= 0; i--) {
-      for (int j = 0; j < layer_[i]; j++) {
-        auto rc = UpdateNeuronDelta({i, j}, target);
+    ParallelRun(worker_num, [&](int worker) {
+      std::vector<int> shard(index_pos.begin() + shard_size * worker,
+                             index_pos.begin() + shard_size * (worker + 1));
+      auto &buffer = train_buffer_[worker];
+      buffer.keep_gathered_ = true;
+      for (int i = worker, step = 0; i < epoch_num && !stop;
+           i += worker_num, step++) {
+        if (step % max_batch_num == 0) {
+          Random::RandomShuffle(shard);
+        }
+        auto rc = CalcBatchGradient(data, shard,
+                                    (step % max_batch_num) * batch_num,
+                                    batch_num, buffer);
+        if (rc == SUCCESS) {
+          rc = UpdateAllNeuronBatch(buffer, *optimizer[worker], batch_num,
+                                    false);
+        }
         if (rc != SUCCESS) {
-          return rc;
+          worker_rc[worker] = rc;
+          stop = true;
+          return;
         }
+        auto early_stop = false;
+        if (worker == 0 && each_epoch_call != nullptr) {
+          each_epoch_call(*this, i, early_stop);
+          if (early_stop) {
+            stop = true;
+          }
+        }
+      }
+    });
+    for (int i = 0; i < worker_num; i++) {
+      if (worker_rc[i] != SUCCESS) {
+        err_msg_ = train_buffer_[i].err_msg_;
+        return worker_rc[i];
       }
     }
     return SUCCESS;
   }
 
+  // run func(0..num-1) on the global pool, at most pool size run at once
+  static void ParallelRun(int num, const std::function<void(int)> &func) {
+    ThreadPool::Global().ParallelFor(0, num, 1, [&](int begin, int end) {
+      for (int i = begin; i < end; i++) {
+        func(i);
+      }
+    });
+  }
+
 private:
-  std::shared_ptr<LossFunction> loss_function_ = nullptr;
-  std::shared_ptr<ActivateFunction> activate_function_ = nullptr;
-  std::shared_ptr<SoftmaxFunction> softmax_function_ = nullptr;
-  std::shared_ptr<ParamInitFunction> param_init_function_ = nullptr;
-  std::shared_ptr<OptimizerFunction> optimizer_function_ = nullptr;
+  std::shared_ptr<LossFunction<T>> loss_function_ = nullptr;
+  std::shared_ptr<ActivateFunction<T>> activate_function_ = nullptr;
+  std::shared_ptr<SoftmaxFunction<T>> softmax_function_ = nullptr;
+  std::shared_ptr<ParamInitFunction<T>> param_init_function_ = nullptr;
+  std::shared_ptr<OptimizerFunction<T>> optimizer_function_ = nullptr;
 
   NetworkStatus network_status_ = NETWORK_STATUS_UNINIT;
   int rand_seed_ = 0;
-  double learning_rate_ = 0.1;
+  T learning_rate_ = 0.1;
+  MathAccuracy math_accuracy_ = MATH_ACCURACY_EXACT;
+  StatePrecision state_precision_ = STATE_PRECISION_FULL;
+  TrainMode train_mode_ = TRAIN_MODE_SYNC;
+  TrainPrecision train_precision_ = TRAIN_PRECISION_FULL;
+  bool sparse_input_ = false;
+  bool lazy_momentum_ = false;
+  T loss_scale_ = 1;
+  bool dynamic_loss_scale_ = false;
+  // good step since the last change of loss scale
+  int loss_scale_step_ = 0;
   std::vector<int> layer_;
-  std::vector<std::vector<double>> neuron_bias_;
-  std::vector<std::vector<std::vector<double>>> neuron_weight_;
-  std::vector<std::vector<double>> neuron_output_;
-  std::vector<std::vector<double>> neuron_delta_;
+  // weight of layer i is a layer_[i] x layer_[i - 1] row-major matrix
+  std::vector<Matrix> neuron_weight_;
+  std::vector<AlignedVector<T>> neuron_bias_;
+  // buffer of the non-const Predict and CalcLoss
+  Workspace workspace_;
+  // one per training thread, buffer 0 also hold the reduced gradient
+  std::vector<TrainBuffer> train_buffer_;
   std::string err_msg_;
 };
 
+// float halve the memory traffic and double the simd lane of every kernel
+using NeuralNetwork = BasicNeuralNetwork<double>;
+using FloatNeuralNetwork = BasicNeuralNetwork<float>;
+
 } // namespace deeplearning
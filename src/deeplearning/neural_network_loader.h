@@ -1,10 +1,13 @@
 #pragma once
 #include "neural_network.h"
+#include "quantized_network.h"
 #include <fstream>
 
 namespace deeplearning {
 
-class NeuralNetworkLoader {
+// file always store value as double, so a model can move between
+// NeuralNetwork and FloatNeuralNetwork
+template <typename T> class BasicNeuralNetworkLoader {
 public:
   enum RC {
     SUCCESS,
@@ -12,9 +15,13 @@ public:
     INPORT_ERROR,
   };
 
+  using NetworkParam = typename BasicNeuralNetwork<T>::NetworkParam;
+  using NetworkOption = typename BasicNeuralNetwork<T>::NetworkOption;
+  using QuantizedParam = typename BasicQuantizedNetwork<T>::QuantizedParam;
+
 public:
-  static RC ExportParamToFile(const NeuralNetwork::NetworkParam &param,
-                              const NeuralNetwork::NetworkOption &option,
+  static RC ExportParamToFile(const NetworkParam &param,
+                              const NetworkOption &option,
                               const std::string &filename) {
     std::ofstream ofs(filename, std::ios::binary | std::ios::trunc);
     if (!ofs.is_open()) {
@@ -46,9 +53,9 @@ public:
     // write neuron bias
     for (int i = 0; i < param.neuron_bias_.size(); i++) {
       for (int j = 0; j < param.neuron_bias_[i].size(); j++) {
+        double value = param.neuron_bias_[i][j];
         auto is_success =
-            ofs.write((const char *)&param.neuron_bias_[i][j], sizeof(double))
-                .good();
+            ofs.write((const char *)&value, sizeof(double)).good();
         if (!is_success) {
           ofs.close();
           return EXPORT_ERROR;
@@ -59,10 +66,9 @@ public:
     for (int i = 1; i < param.neuron_weight_.size(); i++) {
       for (int j = 0; j < param.neuron_weight_[i].size(); j++) {
         for (int k = 0; k < param.neuron_weight_[i][j].size(); k++) {
+          double value = param.neuron_weight_[i][j][k];
           auto is_success =
-              ofs.write((const char *)&param.neuron_weight_[i][j][k],
-                        sizeof(double))
-                  .good();
+              ofs.write((const char *)&value, sizeof(double)).good();
           if (!is_success) {
             ofs.close();
             return EXPORT_ERROR;
@@ -70,13 +76,25 @@ public:
         }
       }
     }
+    // write optimizer state, size first
+    long long state_size = param.optimizer_state_.size();
+    is_success =
+        ofs.write((const char *)&state_size, sizeof(state_size)).good();
+    for (int i = 0; i < state_size && is_success; i++) {
+      double value = param.optimizer_state_[i];
+      is_success = ofs.write((const char *)&value, sizeof(double)).good();
+    }
+    if (!is_success) {
+      ofs.close();
+      return EXPORT_ERROR;
+    }
 
     ofs.close();
     return SUCCESS;
   }
 
-  static RC ImportParamFromFile(NeuralNetwork::NetworkParam &param,
-                                NeuralNetwork::NetworkOption &option,
+  static RC ImportParamFromFile(NetworkParam &param,
+                                NetworkOption &option,
                                 const std::string &filename) {
     std::ifstream ifs(filename, std::ios::binary);
     if (!ifs.is_open()) {
@@ -112,12 +130,13 @@ public:
     for (int i = 0; i < msg.neuron_bias_size_; i++) {
       param.neuron_bias_[i].resize(param.layer_[i]);
       for (int j = 0; j < param.layer_[i]; j++) {
-        auto is_success =
-            ifs.read((char *)&param.neuron_bias_[i][j], sizeof(double)).good();
+        double value = 0;
+        auto is_success = ifs.read((char *)&value, sizeof(double)).good();
         if (!is_success) {
           ifs.close();
           return INPORT_ERROR;
         }
+        param.neuron_bias_[i][j] = value;
       }
     }
     // read neuron weight
@@ -127,21 +146,153 @@ public:
       for (int j = 0; j < param.layer_[i]; j++) {
         param.neuron_weight_[i][j].resize(param.layer_[i - 1]);
         for (int k = 0; k < param.layer_[i - 1]; k++) {
-          auto is_success =
-              ifs.read((char *)&param.neuron_weight_[i][j][k], sizeof(double))
-                  .good();
+          double value = 0;
+          auto is_success = ifs.read((char *)&value, sizeof(double)).good();
           if (!is_success) {
             ifs.close();
             return INPORT_ERROR;
           }
+          param.neuron_weight_[i][j][k] = value;
         }
       }
     }
+    // read optimizer state, file of older version end before it
+    long long state_size = 0;
+    param.optimizer_state_.clear();
+    if (ifs.read((char *)&state_size, sizeof(state_size)).good()) {
+      // bounded by the file before the allocation
+      if (state_size < 0 ||
+          state_size > RemainByte(ifs) / (long long)sizeof(double)) {
+        ifs.close();
+        return INPORT_ERROR;
+      }
+      param.optimizer_state_.resize(state_size);
+      for (int i = 0; i < state_size; i++) {
+        double value = 0;
+        if (!ifs.read((char *)&value, sizeof(double)).good()) {
+          ifs.close();
+          return INPORT_ERROR;
+        }
+        param.optimizer_state_[i] = value;
+      }
+    }
     ifs.close();
     return SUCCESS;
   }
 
+  // quantized file keep the int8 weight as is, scale and bias are float, about
+  // a quarter of the float model and an eighth of the double one
+  static RC ExportQuantizedToFile(const QuantizedParam &param,
+                                  const std::string &filename) {
+    std::ofstream ofs(filename, std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) {
+      return EXPORT_ERROR;
+    }
+    QuantizedSizeMsg msg(param);
+    auto is_success = ofs.write((const char *)&msg, sizeof(msg)).good();
+    for (int i = 0; i < param.layer_.size() && is_success; i++) {
+      is_success =
+          ofs.write((const char *)&param.layer_[i], sizeof(int)).good();
+    }
+    for (int i = 1; i < param.layer_.size() && is_success; i++) {
+      is_success =
+          ofs.write((const char *)&param.input_scale_[i], sizeof(float)) &&
+          ofs.write((const char *)&param.input_zero_point_[i], sizeof(int)) &&
+          ofs.write((const char *)param.weight_scale_[i].data(),
+                    sizeof(float) * param.weight_scale_[i].size()) &&
+          ofs.write((const char *)param.bias_[i].data(),
+                    sizeof(float) * param.bias_[i].size()) &&
+          ofs.write((const char *)param.weight_[i].data(),
+                    param.weight_[i].size());
+    }
+    ofs.close();
+    return is_success ? SUCCESS : EXPORT_ERROR;
+  }
+
+  static RC ImportQuantizedFromFile(QuantizedParam &param,
+                                    const std::string &filename) {
+    std::ifstream ifs(filename, std::ios::binary);
+    if (!ifs.is_open()) {
+      return INPORT_ERROR;
+    }
+    QuantizedSizeMsg msg;
+    auto is_success = ifs.read((char *)&msg, sizeof(msg)).good();
+    if (!is_success || msg.magic_ != kQuantizedMagic || msg.layer_size_ < 2 ||
+        msg.layer_size_ > RemainByte(ifs) / (long long)sizeof(int)) {
+      ifs.close();
+      return INPORT_ERROR;
+    }
+    param.loss_type_ = (LossType)msg.loss_type_;
+    param.activate_type_ = (ActivateType)msg.activate_type_;
+    param.softmax_type_ = (SoftmaxType)msg.softmax_type_;
+    param.layer_.resize(msg.layer_size_);
+    for (int i = 0; i < msg.layer_size_ && is_success; i++) {
+      is_success = ifs.read((char *)&param.layer_[i], sizeof(int)).good() &&
+                   param.layer_[i] > 0;
+    }
+    int layer_size = msg.layer_size_;
+    // every size is checked against the rest of the file before a buffer is
+    // allocated, a corrupt layer can not ask for gigabytes
+    long long remain = is_success ? RemainByte(ifs) : 0;
+    for (int i = 1; i < layer_size && is_success; i++) {
+      // input scale, zero point, weight scale and bias, then int8 weight
+      long long need = sizeof(float) + sizeof(int) +
+                       (long long)param.layer_[i] *
+                           (2 * (long long)sizeof(float) + param.layer_[i - 1]);
+      is_success = need <= remain;
+      remain -= need;
+    }
+    param.weight_.assign(layer_size, {});
+    param.weight_scale_.assign(layer_size, {});
+    param.bias_.assign(layer_size, {});
+    param.input_scale_.assign(layer_size, 1);
+    param.input_zero_point_.assign(layer_size, 0);
+    for (int i = 1; i < layer_size && is_success; i++) {
+      param.weight_scale_[i].resize(param.layer_[i]);
+      param.bias_[i].resize(param.layer_[i]);
+      param.weight_[i].resize((std::size_t)param.layer_[i] *
+                              param.layer_[i - 1]);
+      is_success =
+          ifs.read((char *)&param.input_scale_[i], sizeof(float)) &&
+          ifs.read((char *)&param.input_zero_point_[i], sizeof(int)) &&
+          ifs.read((char *)param.weight_scale_[i].data(),
+                   sizeof(float) * param.layer_[i]) &&
+          ifs.read((char *)param.bias_[i].data(),
+                   sizeof(float) * param.layer_[i]) &&
+          ifs.read((char *)param.weight_[i].data(), param.weight_[i].size());
+    }
+    ifs.close();
+    return is_success ? SUCCESS : INPORT_ERROR;
+  }
+
 private:
+  // byte from the read position to the end of file
+  static long long RemainByte(std::ifstream &ifs) {
+    auto pos = ifs.tellg();
+    ifs.seekg(0, std::ios::end);
+    long long remain = (long long)(ifs.tellg() - pos);
+    ifs.seekg(pos);
+    return remain;
+  }
+
+  static constexpr int kQuantizedMagic = 0x38514c44; // "DLQ8"
+
+  struct QuantizedSizeMsg {
+    int magic_;
+    int loss_type_;
+    int activate_type_;
+    int softmax_type_;
+    int layer_size_;
+    QuantizedSizeMsg() = default;
+    QuantizedSizeMsg(const QuantizedParam &param) {
+      magic_ = kQuantizedMagic;
+      loss_type_ = param.loss_type_;
+      activate_type_ = param.activate_type_;
+      softmax_type_ = param.softmax_type_;
+      layer_size_ = param.layer_.size();
+    }
+  };
+
   struct ParamSizeMsg {
     double learning_rate_;
     int rand_seed_;
@@ -149,7 +300,7 @@ private:
     int neuron_bias_size_;
     int neuron_weight_size_;
     ParamSizeMsg() = default;
-    ParamSizeMsg(const NeuralNetwork::NetworkParam &param) {
+    ParamSizeMsg(const NetworkParam &param) {
       layer_size_ = param.layer_.size();
       neuron_bias_size_ = param.neuron_bias_.size();
       neuron_weight_size_ = param.neuron_weight_.size();
@@ -157,4 +308,7 @@ private:
   };
 };
 
+using NeuralNetworkLoader = BasicNeuralNetworkLoader<double>;
+using FloatNeuralNetworkLoader = BasicNeuralNetworkLoader<float>;
+
 } // namespace deeplearning
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../kernel/dispatch.h"
+#include "optimizer_base.h"
+#include <cmath>
+#include <vector>
+
+namespace deeplearning {
+
+// one fused adam step, moment_[0] is the first moment and moment_[1] the
+// second, weight_decay is decoupled from the gradient as in adamw
+template <typename T>
+void AdamStep(Span<T> weight, Span<const T> grad, OptimizerState<T> &state,
+              T learning_rate, T grad_scale, T weight_decay) {
+  const T beta1 = 0.9, beta2 = 0.999;
+  state.step_++;
+  kernel::AdaptiveParam<T> param;
+  param.grad_scale_ = grad_scale;
+  param.beta1_ = beta1;
+  param.beta2_ = beta2;
+  param.step_size_ = learning_rate / (1 - std::pow(beta1, (T)state.step_));
+  param.correction2_ = 1 / std::sqrt(1 - std::pow(beta2, (T)state.step_));
+  param.eps_ = 1e-8;
+  param.decay_ = learning_rate * weight_decay;
+  kernel::GetKernelTable<T>().adam_update_(
+      weight.size(), param, grad.data(), state.moment_[0].data(),
+      state.moment_[1].data(), weight.data());
+}
+
+template <typename T> class AdamOptimizer : public OptimizerFunction<T> {
+public:
+  AdamOptimizer(const std::vector<int> &layer)
+      : OptimizerFunction<T>(layer, 2) {}
+
+  void UpdateLayer(Span<T> weight, Span<const T> grad, OptimizerState<T> &state,
+                   T learning_rate, T grad_scale) override {
+    AdamStep<T>(weight, grad, state, learning_rate, grad_scale, 0);
+  }
+
+  OptimizerType GetOptimizerType() override { return OPTIMIZER_ADAM; }
+};
+
+// decoupled weight decay of adamw when none is given
+constexpr double kAdamWWeightDecay = 0.01;
+
+template <typename T> class AdamWOptimizer : public OptimizerFunction<T> {
+public:
+  AdamWOptimizer(const std::vector<int> &layer,
+                 T weight_decay = kAdamWWeightDecay)
+      : OptimizerFunction<T>(layer, 2), weight_decay_(weight_decay) {}
+
+  void UpdateLayer(Span<T> weight, Span<const T> grad, OptimizerState<T> &state,
+                   T learning_rate, T grad_scale) override {
+    AdamStep<T>(weight, grad, state, learning_rate, grad_scale, weight_decay_);
+  }
+
+  OptimizerType GetOptimizerType() override { return OPTIMIZER_ADAMW; }
+  T weight_decay() override { return weight_decay_; }
+  inline void set_weight_decay(T weight_decay) { weight_decay_ = weight_decay; }
+
+private:
+  T weight_decay_;
+};
+
+} // namespace deeplearning
@@ -1,51 +1,54 @@
 #pragma once
 
+#include "../kernel/dispatch.h"
 #include "optimizer_base.h"
 #include <vector>
 
 namespace deeplearning {
 
-class MomentumOptimizer : public OptimizerFunction {
+template <typename T> class MomentumOptimizer : public OptimizerFunction<T> {
 public:
-  MomentumOptimizer(const std::vector<int> &layer) : OptimizerFunction(layer) {
-    bias_velocity_.resize(layer.size());
-    weight_velocity_.resize(layer.size());
-
-    for (int i = 0; i < layer.size(); i++) {
-      bias_velocity_[i].resize(layer[i], 0);
-      if (i != 0) {
-        weight_velocity_[i].resize(layer[i]);
-        for (int j = 0; j < layer[i]; j++) {
-          weight_velocity_[i][j].resize(layer[i - 1], 0);
-        }
-      }
-    }
+  // moment_[0] is the velocity
+  MomentumOptimizer(const std::vector<int> &layer)
+      : OptimizerFunction<T>(layer, 1) {}
+
+  // velocity = momentum * velocity - learning_rate * grad, weight += velocity
+  void UpdateLayer(Span<T> weight, Span<const T> grad, OptimizerState<T> &state,
+                   T learning_rate, T grad_scale) override {
+    kernel::GetKernelTable<T>().momentum_update_(
+        weight.size(), learning_rate * grad_scale, momentum, grad.data(),
+        state.moment_[0].data(), weight.data());
   }
 
-  double CalcChangeValue(double delta, double learning_rate,
-                         const std::pair<int, int> &pos,
-                         int weight_pos = -1) override {
-    auto [x, y] = pos;
-    if (weight_pos == -1) {
-      // calc bias
-      bias_velocity_[x][y] =
-          momentum * bias_velocity_[x][y] - learning_rate * delta;
-      return -bias_velocity_[x][y];
-    } else {
-      // calc weight
-      weight_velocity_[x][y][weight_pos] =
-          momentum * weight_velocity_[x][y][weight_pos] - learning_rate * delta;
-      return -weight_velocity_[x][y][weight_pos];
+  // a skipped column still decay and apply its velocity in a dense step, so
+  // only the lazy update, which hold that velocity, can skip it. only full
+  // precision state, a reduced one is stored in chunk that a column subset
+  // can not address
+  bool UpdateColumn(Span<T> weight, int cols, const std::vector<int> &column,
+                    const T *grad, OptimizerState<T> &state, T learning_rate,
+                    T grad_scale, bool lazy) override {
+    if (!lazy || this->state_precision() != STATE_PRECISION_FULL) {
+      return false;
+    }
+    T rate = learning_rate * grad_scale;
+    int rows = weight.size() / cols, size = column.size();
+    for (int i = 0; i < rows; i++) {
+      T *row = weight.data() + (std::size_t)i * cols;
+      T *velocity = state.moment_[0].data() + (std::size_t)i * cols;
+      const T *grad_row = grad + (std::size_t)i * size;
+      for (int j = 0; j < size; j++) {
+        int k = column[j];
+        velocity[k] = momentum * velocity[k] - rate * grad_row[j];
+        row[k] += velocity[k];
+      }
     }
-    return 0;
+    return true;
   }
 
   OptimizerType GetOptimizerType() override { return OPTIMIZER_MOMENTUM; }
 
 private:
-  std::vector<std::vector<std::vector<double>>> weight_velocity_;
-  std::vector<std::vector<double>> bias_velocity_;
-  double momentum = 0.9;
+  T momentum = 0.9;
 };
 
 } // namespace deeplearning
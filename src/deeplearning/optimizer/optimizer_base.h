@@ -1,4 +1,9 @@
 #pragma once
+#include "../util/matrix.h"
+#include "../util/reduced_float.h"
+#include "../util/span.h"
+#include <algorithm>
+#include <cstdint>
 #include <utility>
 #include <vector>
 
@@ -7,18 +12,267 @@ namespace deeplearning {
 enum OptimizerType {
   OPTIMIZER_SGD,
   OPTIMIZER_MOMENTUM,
+  OPTIMIZER_ADAM,
+  OPTIMIZER_ADAMW,
+  OPTIMIZER_RMSPROP,
 };
 
-class OptimizerFunction {
+// storage type of the optimizer moments, the weights always stay in T.
+// STATE_PRECISION_FLOAT is the same as full for a float network
+enum StatePrecision {
+  STATE_PRECISION_FULL,
+  STATE_PRECISION_FLOAT,
+  STATE_PRECISION_BF16,
+  STATE_PRECISION_FP16,
+};
+
+// what an optimizer keep for one parameter buffer, every moment has the same
+// size as the buffer. only one of the moment vector is used, by precision
+template <typename T> struct OptimizerState {
+  std::vector<AlignedVector<T>> moment_;
+  std::vector<AlignedVector<float>> float_moment_;
+  // bf16 or fp16 bits
+  std::vector<AlignedVector<std::uint16_t>> half_moment_;
+  // element count of each moment
+  std::size_t moment_size_ = 0;
+  // update count, for the bias correction of adam
+  int step_ = 0;
+};
+
+template <typename T> class OptimizerFunction {
 public:
-  OptimizerFunction(const std::vector<int> &layer) : layer_(layer) {}
-  virtual double CalcChangeValue(double delta, double learning_rate,
-                                 const std::pair<int, int> &pos,
-                                 int weight_pos = -1) = 0;
+  using Scalar = T;
+
+  // moment_num is the state count per parameter, 0 for a stateless one
+  OptimizerFunction(const std::vector<int> &layer, int moment_num = 0)
+      : layer_(layer), moment_num_(moment_num) {
+    set_state_precision(STATE_PRECISION_FULL);
+  }
+
+  // step a whole contiguous weight or bias buffer with grad * grad_scale in
+  // one pass, the moments of state must be in full precision
+  virtual void UpdateLayer(Span<T> weight, Span<const T> grad,
+                           OptimizerState<T> &state, T learning_rate,
+                           T grad_scale) = 0;
   virtual OptimizerType GetOptimizerType() = 0;
+  // step only column[j] of a row-major weight with cols column, grad is the
+  // rows x column.size() gradient of those column. for the sparse first
+  // layer, the update then cost the nonzero column and not the whole matrix.
+  // false when the optimizer must see every column, then nothing is changed.
+  // lazy let an optimizer with state hold the state of a skipped column
+  // instead of stepping it, the result then differ from the dense step
+  virtual bool UpdateColumn(Span<T> weight, int cols,
+                            const std::vector<int> &column, const T *grad,
+                            OptimizerState<T> &state, T learning_rate,
+                            T grad_scale, bool lazy) {
+    return false;
+  }
+  // decoupled decay per unit learning rate, 0 for all but adamw
+  virtual T weight_decay() { return 0; }
+
+  // UpdateLayer on state stored in any precision, state come from
+  // weight_state or bias_state of the same layer. reduced state is widen a
+  // chunk at a time into a per thread buffer and rounded back stochastically
+  void Update(Span<T> weight, Span<const T> grad, OptimizerState<T> &state,
+              T learning_rate, T grad_scale) {
+    if (state_precision_ == STATE_PRECISION_FULL || moment_num_ == 0) {
+      UpdateLayer(weight, grad, state, learning_rate, grad_scale);
+      return;
+    }
+    constexpr int chunk = 1024;
+    thread_local OptimizerState<T> buffer;
+    thread_local RoundingRandom random;
+    buffer.moment_.resize(moment_num_, AlignedVector<T>(chunk));
+    int step = state.step_;
+    for (int begin = 0; begin < weight.size(); begin += chunk) {
+      int len = std::min(chunk, weight.size() - begin);
+      for (int m = 0; m < moment_num_; m++) {
+        LoadMoment(state, m, begin, len, buffer.moment_[m].data());
+      }
+      // every chunk is the same step of the whole buffer
+      buffer.step_ = step;
+      UpdateLayer(weight.SubSpan(begin, len), grad.SubSpan(begin, len), buffer,
+                  learning_rate, grad_scale);
+      for (int m = 0; m < moment_num_; m++) {
+        StoreMoment(buffer.moment_[m].data(), begin, len, random, state, m);
+      }
+    }
+    state.step_ = weight.empty() ? step : buffer.step_;
+  }
+
+  // reallocate every state in the new storage, value and step is reset, so
+  // choose it before training or ImportState after it
+  void set_state_precision(StatePrecision precision) {
+    // a float network store float moment in the full vector
+    if (precision == STATE_PRECISION_FLOAT && sizeof(T) == sizeof(float)) {
+      precision = STATE_PRECISION_FULL;
+    }
+    state_precision_ = precision;
+    weight_state_.assign(layer_.size(), OptimizerState<T>());
+    bias_state_.assign(layer_.size(), OptimizerState<T>());
+    for (int i = 1; i < layer_.size(); i++) {
+      AllocState(weight_state_[i], (std::size_t)layer_[i] * layer_[i - 1]);
+      AllocState(bias_state_[i], layer_[i]);
+    }
+  }
+  inline StatePrecision state_precision() { return state_precision_; }
+  // byte of every moment, the resident memory the optimizer add to training
+  std::size_t state_bytes() {
+    std::size_t bytes = 0;
+    for (int i = 1; i < layer_.size(); i++) {
+      for (auto *buffer : {&weight_state_[i], &bias_state_[i]}) {
+        bytes += moment_num_ * MomentSize(*buffer) * ElementBytes();
+      }
+    }
+    return bytes;
+  }
+
+  inline OptimizerState<T> &weight_state(int layer) {
+    return weight_state_[layer];
+  }
+  inline OptimizerState<T> &bias_state(int layer) { return bias_state_[layer]; }
+
+  // flatten every state, layer by layer weight then bias, each as step
+  // followed by its moments. a stateless optimizer still write the step
+  void ExportState(std::vector<T> &state) {
+    state.clear();
+    for (int i = 1; i < layer_.size(); i++) {
+      for (auto *buffer : {&weight_state_[i], &bias_state_[i]}) {
+        state.push_back(buffer->step_);
+        std::size_t size = MomentSize(*buffer);
+        for (int m = 0; m < moment_num_; m++) {
+          state.resize(state.size() + size);
+          LoadMoment(*buffer, m, 0, size, state.data() + state.size() - size);
+        }
+      }
+    }
+  }
+  // false if the size not match this optimizer and layer
+  bool ImportState(const std::vector<T> &state) {
+    std::size_t size = 0;
+    for (int i = 1; i < layer_.size(); i++) {
+      for (auto *buffer : {&weight_state_[i], &bias_state_[i]}) {
+        size += 1 + moment_num_ * MomentSize(*buffer);
+      }
+    }
+    if (size != state.size()) {
+      return false;
+    }
+    RoundingRandom random;
+    const T *pos = state.data();
+    for (int i = 1; i < layer_.size(); i++) {
+      for (auto *buffer : {&weight_state_[i], &bias_state_[i]}) {
+        buffer->step_ = *pos++;
+        std::size_t size = MomentSize(*buffer);
+        for (int m = 0; m < moment_num_; m++) {
+          StoreMoment(pos, 0, size, random, *buffer, m);
+          pos += size;
+        }
+      }
+    }
+    return true;
+  }
 
 protected:
+  void AllocState(OptimizerState<T> &state, std::size_t size) {
+    switch (state_precision_) {
+    case STATE_PRECISION_FULL:
+      state.moment_.assign(moment_num_, AlignedVector<T>(size));
+      break;
+    case STATE_PRECISION_FLOAT:
+      state.float_moment_.assign(moment_num_, AlignedVector<float>(size));
+      break;
+    default:
+      state.half_moment_.assign(moment_num_,
+                                AlignedVector<std::uint16_t>(size));
+      break;
+    }
+    state.moment_size_ = size;
+  }
+
+  std::size_t ElementBytes() {
+    switch (state_precision_) {
+    case STATE_PRECISION_FULL:
+      return sizeof(T);
+    case STATE_PRECISION_FLOAT:
+      return sizeof(float);
+    default:
+      return sizeof(std::uint16_t);
+    }
+  }
+
+  inline std::size_t MomentSize(const OptimizerState<T> &state) {
+    return state.moment_size_;
+  }
+
+  // widen moment[begin, begin + len) of state into output
+  void LoadMoment(const OptimizerState<T> &state, int moment, std::size_t begin,
+                  std::size_t len, T *output) {
+    switch (state_precision_) {
+    case STATE_PRECISION_FULL: {
+      const T *input = state.moment_[moment].data() + begin;
+      std::copy(input, input + len, output);
+      break;
+    }
+    case STATE_PRECISION_FLOAT: {
+      const float *input = state.float_moment_[moment].data() + begin;
+      std::copy(input, input + len, output);
+      break;
+    }
+    case STATE_PRECISION_BF16: {
+      const std::uint16_t *input = state.half_moment_[moment].data() + begin;
+      for (std::size_t i = 0; i < len; i++) {
+        output[i] = Bf16ToFloat(input[i]);
+      }
+      break;
+    }
+    case STATE_PRECISION_FP16: {
+      const std::uint16_t *input = state.half_moment_[moment].data() + begin;
+      for (std::size_t i = 0; i < len; i++) {
+        output[i] = Fp16ToFloat(input[i]);
+      }
+      break;
+    }
+    }
+  }
+
+  // round input back into moment[begin, begin + len) of state
+  void StoreMoment(const T *input, std::size_t begin, std::size_t len,
+                   RoundingRandom &random, OptimizerState<T> &state,
+                   int moment) {
+    switch (state_precision_) {
+    case STATE_PRECISION_FULL:
+      std::copy(input, input + len, state.moment_[moment].data() + begin);
+      break;
+    case STATE_PRECISION_FLOAT: {
+      float *output = state.float_moment_[moment].data() + begin;
+      for (std::size_t i = 0; i < len; i++) {
+        output[i] = RoundToFloat(input[i], random.Next());
+      }
+      break;
+    }
+    case STATE_PRECISION_BF16: {
+      std::uint16_t *output = state.half_moment_[moment].data() + begin;
+      for (std::size_t i = 0; i < len; i++) {
+        output[i] = FloatToBf16(input[i], random.Next());
+      }
+      break;
+    }
+    case STATE_PRECISION_FP16: {
+      std::uint16_t *output = state.half_moment_[moment].data() + begin;
+      for (std::size_t i = 0; i < len; i++) {
+        output[i] = FloatToFp16(input[i], random.Next());
+      }
+      break;
+    }
+    }
+  }
+
   std::vector<int> layer_;
+  int moment_num_;
+  StatePrecision state_precision_ = STATE_PRECISION_FULL;
+  std::vector<OptimizerState<T>> weight_state_;
+  std::vector<OptimizerState<T>> bias_state_;
 };
 
 } // namespace deeplearning
@@ -1,20 +1,31 @@
 #pragma once
 
+#include "optimizer/adam_optimizer.h"
 #include "optimizer/momentum_optimizer.h"
 #include "optimizer/optimizer_base.h"
+#include "optimizer/rmsprop_optimizer.h"
 #include "optimizer/sgd_optimizer.h"
 #include <vector>
 namespace deeplearning {
 
 class OptimizerFactory {
 public:
-  static std::shared_ptr<OptimizerFunction>
-  Create(OptimizerType optimizer_type, const std::vector<int> &layer) {
+  // weight_decay is used by OPTIMIZER_ADAMW only
+  template <typename T = double>
+  static std::shared_ptr<OptimizerFunction<T>>
+  Create(OptimizerType optimizer_type, const std::vector<int> &layer,
+         T weight_decay = kAdamWWeightDecay) {
     switch (optimizer_type) {
     case OPTIMIZER_SGD:
-      return std::make_shared<SGDOptimizer>(layer);
+      return std::make_shared<SGDOptimizer<T>>(layer);
     case OPTIMIZER_MOMENTUM:
-      return std::make_shared<MomentumOptimizer>(layer);
+      return std::make_shared<MomentumOptimizer<T>>(layer);
+    case OPTIMIZER_ADAM:
+      return std::make_shared<AdamOptimizer<T>>(layer);
+    case OPTIMIZER_ADAMW:
+      return std::make_shared<AdamWOptimizer<T>>(layer, weight_decay);
+    case OPTIMIZER_RMSPROP:
+      return std::make_shared<RMSPropOptimizer<T>>(layer);
     default:
       return nullptr;
     }
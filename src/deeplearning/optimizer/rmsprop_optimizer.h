@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../kernel/dispatch.h"
+#include "optimizer_base.h"
+#include <vector>
+
+namespace deeplearning {
+
+template <typename T> class RMSPropOptimizer : public OptimizerFunction<T> {
+public:
+  // moment_[0] is the running average of the squared gradient
+  RMSPropOptimizer(const std::vector<int> &layer)
+      : OptimizerFunction<T>(layer, 1) {}
+
+  // v = decay * v + (1 - decay) * grad^2, weight -= rate * grad / sqrt(v)
+  void UpdateLayer(Span<T> weight, Span<const T> grad, OptimizerState<T> &state,
+                   T learning_rate, T grad_scale) override {
+    state.step_++;
+    kernel::AdaptiveParam<T> param = {};
+    param.grad_scale_ = grad_scale;
+    param.beta2_ = decay;
+    param.step_size_ = learning_rate;
+    param.correction2_ = 1;
+    param.eps_ = 1e-8;
+    kernel::GetKernelTable<T>().rmsprop_update_(weight.size(), param,
+                                                grad.data(),
+                                                state.moment_[0].data(),
+                                                weight.data());
+  }
+
+  OptimizerType GetOptimizerType() override { return OPTIMIZER_RMSPROP; }
+
+private:
+  T decay = 0.99;
+};
+
+} // namespace deeplearning
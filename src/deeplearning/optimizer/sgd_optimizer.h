@@ -1,16 +1,35 @@
 #pragma once
 
+#include "../kernel/dispatch.h"
 #include "optimizer_base.h"
 
 namespace deeplearning {
 
-class SGDOptimizer : public OptimizerFunction {
+template <typename T> class SGDOptimizer : public OptimizerFunction<T> {
 public:
-  SGDOptimizer(const std::vector<int> &layer) : OptimizerFunction(layer) {}
-  double CalcChangeValue(double delta, double learning_rate,
-                         const std::pair<int, int> &pos,
-                         int weight_pos = -1) override {
-    return learning_rate * delta;
+  SGDOptimizer(const std::vector<int> &layer) : OptimizerFunction<T>(layer) {}
+
+  // weight -= learning_rate * grad, the scale fold into the rate
+  void UpdateLayer(Span<T> weight, Span<const T> grad, OptimizerState<T> &,
+                   T learning_rate, T grad_scale) override {
+    kernel::GetKernelTable<T>().sgd_update_(
+        weight.size(), learning_rate * grad_scale, grad.data(), weight.data());
+  }
+
+  // a zero gradient leave the weight as is, so skipping it is exact
+  bool UpdateColumn(Span<T> weight, int cols, const std::vector<int> &column,
+                    const T *grad, OptimizerState<T> &, T learning_rate,
+                    T grad_scale, bool) override {
+    T rate = learning_rate * grad_scale;
+    int rows = weight.size() / cols, size = column.size();
+    for (int i = 0; i < rows; i++) {
+      T *row = weight.data() + (std::size_t)i * cols;
+      const T *grad_row = grad + (std::size_t)i * size;
+      for (int j = 0; j < size; j++) {
+        row[column[j]] -= rate * grad_row[j];
+      }
+    }
+    return true;
   }
 
   OptimizerType GetOptimizerType() override { return OPTIMIZER_SGD; }
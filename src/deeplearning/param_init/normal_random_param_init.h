@@ -5,23 +5,22 @@
 
 namespace deeplearning {
 
-class NormalRandomParamInitFunction : public ParamInitFunction {
+template <typename T>
+class NormalRandomParamInitFunction : public ParamInitFunction<T> {
 public:
   NormalRandomParamInitFunction() : mean_(0.0), stddev_(1.0) {};
   NormalRandomParamInitFunction(double mean, double stddev)
       : mean_(mean), stddev_(stddev) {}
 
-  void InitParam(std::vector<std::vector<std::vector<double>>> &weight,
-                 std::vector<std::vector<double>> &bias) override {
+  void InitParam(std::vector<Matrix<T>> &weight,
+                 std::vector<AlignedVector<T>> &bias) override {
     std::random_device rd;
     std::mt19937 gen(rd());
-    std::normal_distribution<double> distr(mean_, stddev_);
+    std::normal_distribution<T> distr(mean_, stddev_);
 
     for (auto &w : weight) {
       for (auto &w_ : w) {
-        for (auto &w__ : w_) {
-          w__ = distr(gen);
-        }
+        w_ = distr(gen);
       }
     }
     for (auto &b : bias) {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "../util/matrix.h"
 #include <vector>
 namespace deeplearning {
 
@@ -11,10 +12,10 @@ enum ParamInitType {
   PARAM_INIT_HE,
 };
 
-class ParamInitFunction {
+template <typename T> class ParamInitFunction {
 public:
-  virtual void InitParam(std::vector<std::vector<std::vector<double>>> &weight,
-                         std::vector<std::vector<double>> &bias) = 0;
+  virtual void InitParam(std::vector<Matrix<T>> &weight,
+                         std::vector<AlignedVector<T>> &bias) = 0;
   virtual ParamInitType GetParamInitType() = 0;
 };
 
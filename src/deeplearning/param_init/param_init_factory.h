@@ -11,19 +11,20 @@ namespace deeplearning {
 
 class ParamInitFactory {
 public:
-  static std::shared_ptr<ParamInitFunction>
+  template <typename T = double>
+  static std::shared_ptr<ParamInitFunction<T>>
   Create(ParamInitType param_init_type) {
     switch (param_init_type) {
     case PARAM_INIT_ZERO:
-      return std::make_shared<ZeroParamInitFunction>();
+      return std::make_shared<ZeroParamInitFunction<T>>();
     case PARAM_INIT_UNIFORM_RANDOM:
-      return std::make_shared<UniformRandomParamInitFunction>();
+      return std::make_shared<UniformRandomParamInitFunction<T>>();
     case PARAM_INIT_NORMAL_RANDOM:
-      return std::make_shared<NormalRandomParamInitFunction>();
+      return std::make_shared<NormalRandomParamInitFunction<T>>();
     case PARAM_INIT_XAVIER:
-      return std::make_shared<XavierParamInitFunction>();
+      return std::make_shared<XavierParamInitFunction<T>>();
     case PARAM_INIT_HE:
-      return std::make_shared<HeParamInitFunction>();
+      return std::make_shared<HeParamInitFunction<T>>();
     default:
       return nullptr;
     }
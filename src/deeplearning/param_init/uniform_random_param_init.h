@@ -5,23 +5,22 @@
 
 namespace deeplearning {
 
-class UniformRandomParamInitFunction : public ParamInitFunction {
+template <typename T>
+class UniformRandomParamInitFunction : public ParamInitFunction<T> {
 public:
   UniformRandomParamInitFunction() : min_(-0.5), max_(0.5) {};
   UniformRandomParamInitFunction(double min, double max)
       : min_(min), max_(max) {}
 
-  void InitParam(std::vector<std::vector<std::vector<double>>> &weight,
-                 std::vector<std::vector<double>> &bias) override {
+  void InitParam(std::vector<Matrix<T>> &weight,
+                 std::vector<AlignedVector<T>> &bias) override {
     std::random_device rd;
     std::mt19937 gen(rd());
-    std::uniform_real_distribution<double> distr(min_, max_);
+    std::uniform_real_distribution<T> distr(min_, max_);
 
     for (auto &w : weight) {
       for (auto &w_ : w) {
-        for (auto &w__ : w_) {
-          w__ = distr(gen);
-        }
+        w_ = distr(gen);
       }
     }
     for (auto &b : bias) {
@@ -5,23 +5,23 @@
 
 namespace deeplearning {
 
-class XavierParamInitFunction : public ParamInitFunction {
+template <typename T>
+class XavierParamInitFunction : public ParamInitFunction<T> {
 public:
-  void InitParam(std::vector<std::vector<std::vector<double>>> &weight,
-                 std::vector<std::vector<double>> &bias) override {
+  void InitParam(std::vector<Matrix<T>> &weight,
+                 std::vector<AlignedVector<T>> &bias) override {
     if (weight.size() != bias.size()) {
       return;
     }
 
+    // uniform in +-sqrt(6 / (fan_in + fan_out)), the cols and rows of layer i
     for (int i = 1; i < weight.size(); i++) {
-      double limit = std::sqrt(6.0 / (weight[i - 1].size() + weight[i].size()));
+      double limit = std::sqrt(6.0 / (weight[i].cols() + weight[i].rows()));
       std::random_device rd;
       std::mt19937 gen(rd());
-      std::uniform_real_distribution<double> dis(-limit, limit);
+      std::uniform_real_distribution<T> dis(-limit, limit);
       for (auto &w : weight[i]) {
-        for (auto &w_ : w) {
-          w_ = dis(gen);
-        }
+        w = dis(gen);
       }
       for (auto &b : bias[i]) {
         b = dis(gen);
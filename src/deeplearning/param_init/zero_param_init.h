@@ -3,14 +3,13 @@
 #include "param_init_base.h"
 namespace deeplearning {
 
-class ZeroParamInitFunction : public ParamInitFunction {
+template <typename T>
+class ZeroParamInitFunction : public ParamInitFunction<T> {
 public:
-  void InitParam(std::vector<std::vector<std::vector<double>>> &weight,
-                  std::vector<std::vector<double>> &bias) override {
+  void InitParam(std::vector<Matrix<T>> &weight,
+                 std::vector<AlignedVector<T>> &bias) override {
     for (auto &w : weight) {
-      for (auto &w_ : w) {
-        std::fill(w_.begin(), w_.end(), 0.0);
-      }
+      w.Fill(0.0);
     }
     for (auto &b : bias) {
       std::fill(b.begin(), b.end(), 0.0);
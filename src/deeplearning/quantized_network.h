@@ -0,0 +1,435 @@
+#pragma once
+#include "activate/activate_factory.h"
+#include "kernel/gemm.h"
+#include "loss/loss_factory.h"
+#include "neural_network.h"
+#include "softmax/softmax_factory.h"
+#include "util/matrix.h"
+#include "util/thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace deeplearning {
+
+// int8 inference engine of a trained network. weights are int8 with one
+// scale per output neuron, the input of each layer is quantize to u8 with a
+// scale and zero point found by calibration, and the dot product run in
+// int32 on the int8_gemv_ kernel. activation, bias and softmax stay in T
+template <typename T> class BasicQuantizedNetwork {
+public:
+  enum RC {
+    SUCCESS,
+    INVALID_DATA,
+    NOT_INIT,
+  };
+  using Network = BasicNeuralNetwork<T>;
+  using NetworkParam = typename Network::NetworkParam;
+  using NetworkOption = typename Network::NetworkOption;
+  using EvaluateResult = typename Network::EvaluateResult;
+  using Matrix = deeplearning::Matrix<T>;
+
+  // quantized input stop at 127, so a maddubs pair sum 2 * 127 * 127 never
+  // saturate int16 and every isa give the same integer
+  static constexpr int kInputMax = 127;
+  // sample per task chunk of PredictBatch and Evaluate
+  static constexpr int kPredictChunk = 64;
+
+  struct QuantizedParam {
+    std::vector<int> layer_;
+    LossType loss_type_;
+    ActivateType activate_type_;
+    SoftmaxType softmax_type_;
+    // layer_[i] x layer_[i - 1] row-major, weight = weight_ * weight_scale_
+    std::vector<std::vector<std::int8_t>> weight_;
+    std::vector<std::vector<float>> weight_scale_;
+    std::vector<std::vector<float>> bias_;
+    // input of layer i is round(x / input_scale_) + input_zero_point_
+    std::vector<float> input_scale_;
+    std::vector<int> input_zero_point_;
+  };
+
+  // buffer of one forward pass, one per thread for the const Predict
+  class Workspace {
+  public:
+    inline std::string err_msg() { return err_msg_; }
+
+  private:
+    friend class BasicQuantizedNetwork;
+    AlignedVector<std::uint8_t> input_;
+    std::vector<std::int32_t> dot_;
+    std::vector<AlignedVector<T>> neuron_output_;
+    // last layer output of Evaluate
+    std::vector<T> output_;
+    std::string err_msg_;
+  };
+
+public:
+  BasicQuantizedNetwork() = default;
+  BasicQuantizedNetwork(const BasicQuantizedNetwork &) = delete;
+  BasicQuantizedNetwork &operator=(const BasicQuantizedNetwork &) = delete;
+
+  // post training quantization of an exported network. calibration is a
+  // sample of real input, the float forward pass over it give the range of
+  // every layer input
+  RC Quantize(const NetworkParam &param, const NetworkOption &option,
+              const std::vector<std::vector<T>> &calibration) {
+    auto &layer = param.layer_;
+    if (layer.size() < 2 || param.neuron_weight_.size() != layer.size() ||
+        param.neuron_bias_.size() != layer.size() || calibration.empty()) {
+      err_msg_ = "[QuantizedNetwork::Quantize] Invalid data input";
+      return INVALID_DATA;
+    }
+    auto activate = ActivateFactory::Create<T>(option.activate_type_);
+    auto softmax = SoftmaxFactory::Create<T>(option.softmax_type_);
+    if (activate == nullptr || softmax == nullptr) {
+      err_msg_ = "[QuantizedNetwork::Quantize] Invalid option";
+      return INVALID_DATA;
+    }
+
+    QuantizedParam quantized;
+    quantized.layer_ = layer;
+    quantized.loss_type_ = option.loss_type_;
+    quantized.activate_type_ = option.activate_type_;
+    quantized.softmax_type_ = option.softmax_type_;
+    quantized.weight_.resize(layer.size());
+    quantized.weight_scale_.resize(layer.size());
+    quantized.bias_.resize(layer.size());
+    quantized.input_scale_.assign(layer.size(), 1);
+    quantized.input_zero_point_.assign(layer.size(), 0);
+
+    Matrix input(calibration.size(), layer[0]), output, weight;
+    for (int i = 0; i < calibration.size(); i++) {
+      if (calibration[i].size() != layer[0]) {
+        err_msg_ = "[QuantizedNetwork::Quantize] Invalid calibration size";
+        return INVALID_DATA;
+      }
+      std::copy(calibration[i].begin(), calibration[i].end(), input.Row(i));
+    }
+    bool use_softmax = option.softmax_type_ != SOFTMAX_NONE;
+    for (int i = 1; i < layer.size(); i++) {
+      if (param.neuron_weight_[i].size() != layer[i] ||
+          param.neuron_bias_[i].size() != layer[i]) {
+        err_msg_ = "[QuantizedNetwork::Quantize] Invalid param size";
+        return INVALID_DATA;
+      }
+      // asymmetric range of the input, 0 must stay exact for the padding
+      T min = std::min<T>(0, *std::min_element(input.begin(), input.end()));
+      T max = std::max<T>(0, *std::max_element(input.begin(), input.end()));
+      float scale = max > min ? (max - min) / kInputMax : 1;
+      quantized.input_scale_[i] = scale;
+      quantized.input_zero_point_[i] = std::lround(-min / scale);
+
+      // symmetric per row weight
+      weight.Resize(layer[i], layer[i - 1]);
+      quantized.weight_[i].resize((std::size_t)layer[i] * layer[i - 1]);
+      quantized.weight_scale_[i].resize(layer[i]);
+      quantized.bias_[i].assign(param.neuron_bias_[i].begin(),
+                                param.neuron_bias_[i].end());
+      for (int j = 0; j < layer[i]; j++) {
+        auto &row = param.neuron_weight_[i][j];
+        if (row.size() != layer[i - 1]) {
+          err_msg_ = "[QuantizedNetwork::Quantize] Invalid param size";
+          return INVALID_DATA;
+        }
+        T row_max = 0;
+        for (T value : row) {
+          row_max = std::max<T>(row_max, std::fabs(value));
+        }
+        float row_scale = row_max > 0 ? row_max / 127 : 1;
+        quantized.weight_scale_[i][j] = row_scale;
+        std::int8_t *out =
+            &quantized.weight_[i][(std::size_t)j * layer[i - 1]];
+        for (int k = 0; k < layer[i - 1]; k++) {
+          long value = std::lround(row[k] / row_scale);
+          out[k] = std::max<long>(-127, std::min<long>(127, value));
+        }
+        std::copy(row.begin(), row.end(), weight.Row(j));
+      }
+
+      // float forward of the calibration batch for the next range
+      kernel::MatMul(input, false, weight, true, output);
+      for (int j = 0; j < output.rows(); j++) {
+        T *row = output.Row(j);
+        for (int k = 0; k < layer[i]; k++) {
+          row[k] += param.neuron_bias_[i][k];
+        }
+      }
+      if (!(use_softmax && i == layer.size() - 1)) {
+        Span<T> all(output.data(), output.size());
+        activate->Activate(all, all);
+      }
+      std::swap(input, output);
+    }
+    return ImportQuantizedParam(quantized);
+  }
+
+  RC ExportQuantizedParam(QuantizedParam &param) {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      err_msg_ = "[QuantizedNetwork::ExportQuantizedParam] Network not init";
+      return NOT_INIT;
+    }
+    param = param_;
+    return SUCCESS;
+  }
+
+  RC ImportQuantizedParam(const QuantizedParam &param) {
+    auto &layer = param.layer_;
+    if (layer.size() < 2 || param.weight_.size() != layer.size() ||
+        param.weight_scale_.size() != layer.size() ||
+        param.bias_.size() != layer.size() ||
+        param.input_scale_.size() != layer.size() ||
+        param.input_zero_point_.size() != layer.size()) {
+      err_msg_ = "[QuantizedNetwork::ImportQuantizedParam] Invalid data input";
+      return INVALID_DATA;
+    }
+    for (int i = 1; i < layer.size(); i++) {
+      if (param.weight_[i].size() != (std::size_t)layer[i] * layer[i - 1] ||
+          param.weight_scale_[i].size() != layer[i] ||
+          param.bias_[i].size() != layer[i] ||
+          param.input_zero_point_[i] < 0 ||
+          param.input_zero_point_[i] > kInputMax) {
+        err_msg_ =
+            "[QuantizedNetwork::ImportQuantizedParam] Invalid param size";
+        return INVALID_DATA;
+      }
+    }
+    auto loss = LossFactory::Create<T>(param.loss_type_);
+    auto activate = ActivateFactory::Create<T>(param.activate_type_);
+    auto softmax = SoftmaxFactory::Create<T>(param.softmax_type_);
+    if (loss == nullptr || activate == nullptr || softmax == nullptr) {
+      err_msg_ = "[QuantizedNetwork::ImportQuantizedParam] Invalid type";
+      return INVALID_DATA;
+    }
+    loss_function_ = loss;
+    activate_function_ = activate;
+    softmax_function_ = softmax;
+    param_ = param;
+
+    // rows padded to kInt8Align with zero. the zero point term is
+    // zp * row sum, fold it with the bias into one offset per row
+    padded_size_.assign(layer.size(), 0);
+    weight_.assign(layer.size(), AlignedVector<std::int8_t>());
+    scale_.assign(layer.size(), std::vector<T>());
+    offset_.assign(layer.size(), std::vector<T>());
+    for (int i = 1; i < layer.size(); i++) {
+      int padded = (layer[i - 1] + kernel::kInt8Align - 1) /
+                   kernel::kInt8Align * kernel::kInt8Align;
+      padded_size_[i] = padded;
+      weight_[i].assign((std::size_t)layer[i] * padded, 0);
+      scale_[i].resize(layer[i]);
+      offset_[i].resize(layer[i]);
+      for (int j = 0; j < layer[i]; j++) {
+        const std::int8_t *row =
+            &param.weight_[i][(std::size_t)j * layer[i - 1]];
+        std::copy(row, row + layer[i - 1],
+                  &weight_[i][(std::size_t)j * padded]);
+        std::int32_t row_sum = 0;
+        for (int k = 0; k < layer[i - 1]; k++) {
+          row_sum += row[k];
+        }
+        T scale = (T)param.input_scale_[i] * param.weight_scale_[i][j];
+        scale_[i][j] = scale;
+        offset_[i][j] = param.bias_[i][j] -
+                        scale * param.input_zero_point_[i] * row_sum;
+      }
+    }
+    network_status_ = NETWORK_STATUS_INIT;
+    return SUCCESS;
+  }
+
+  RC Predict(const std::vector<T> &data, std::vector<T> &result) {
+    result.resize(param_.layer_.empty() ? 0 : param_.layer_.back());
+    auto rc = Predict(Span<const T>(data), Span<T>(result), workspace_);
+    if (rc != SUCCESS) {
+      err_msg_ = workspace_.err_msg_;
+    }
+    return rc;
+  }
+
+  // const version, one workspace per thread, result must hold last layer size
+  RC Predict(Span<const T> data, Span<T> result, Workspace &workspace) const {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      workspace.err_msg_ = "[QuantizedNetwork::Predict] Network not init";
+      return NOT_INIT;
+    }
+    auto &layer = param_.layer_;
+    int last_layer = layer.size() - 1;
+    if (data.size() != layer[0] || result.size() != layer[last_layer]) {
+      workspace.err_msg_ = "[QuantizedNetwork::Predict] Invalid data input";
+      return INVALID_DATA;
+    }
+    auto &table = kernel::GetKernelTable<T>();
+    workspace.neuron_output_.resize(layer.size());
+    const T *input = data.data();
+    for (int i = 1; i < layer.size(); i++) {
+      // size in local, the uint8 store may alias anything read through a
+      // pointer and stop the loop from vectorizing
+      int input_size = layer[i - 1], output_size = layer[i];
+      workspace.input_.assign(padded_size_[i], 0);
+      // round half up by truncate after the clamp, no lround call per value
+      float inverse = 1 / param_.input_scale_[i];
+      float offset = param_.input_zero_point_[i] + 0.5f;
+      std::uint8_t *quantized_input = workspace.input_.data();
+      for (int k = 0; k < input_size; k++) {
+        float value = (float)input[k] * inverse + offset;
+        value = std::max(0.0f, std::min(kInputMax + 0.5f, value));
+        quantized_input[k] = (int)value;
+      }
+      workspace.dot_.resize(output_size);
+      std::int32_t *dot = workspace.dot_.data();
+      table.int8_gemv_(output_size, padded_size_[i], quantized_input,
+                       weight_[i].data(), padded_size_[i], dot);
+
+      T *output = i == last_layer ? result.data() : nullptr;
+      if (output == nullptr) {
+        workspace.neuron_output_[i].resize(output_size);
+        output = workspace.neuron_output_[i].data();
+      }
+      const T *scale = scale_[i].data(), *offset_value = offset_[i].data();
+      for (int j = 0; j < output_size; j++) {
+        output[j] = (T)dot[j] * scale[j] + offset_value[j];
+      }
+      Span<T> all(output, layer[i]);
+      if (i == last_layer &&
+          softmax_function_->GetSoftmaxType() != SOFTMAX_NONE) {
+        softmax_function_->Normalize(all, all);
+      } else {
+        activate_function_->Activate(all, all);
+      }
+      input = output;
+    }
+    return SUCCESS;
+  }
+
+  // every row of inputs is a sample, spread over the thread pool
+  RC PredictBatch(const Matrix &inputs, Matrix &outputs) {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      err_msg_ = "[QuantizedNetwork::PredictBatch] Network not init";
+      return NOT_INIT;
+    }
+    if (inputs.cols() != param_.layer_[0]) {
+      err_msg_ = "[QuantizedNetwork::PredictBatch] Invalid data input";
+      return INVALID_DATA;
+    }
+    outputs.Reshape(inputs.rows(), param_.layer_.back());
+    return ParallelPredict(inputs.rows(), [&](int i, Workspace &workspace) {
+      return Predict(inputs[i], outputs[i], workspace);
+    });
+  }
+
+  // loss, accuracy and confusion matrix as NeuralNetwork::Evaluate, compare
+  // the two to get the accuracy lost by quantization
+  RC Evaluate(const std::vector<std::vector<T>> &data,
+              const std::vector<std::vector<T>> &target,
+              EvaluateResult &result) {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      err_msg_ = "[QuantizedNetwork::Evaluate] Network not init";
+      return NOT_INIT;
+    }
+    int class_num = param_.layer_.back();
+    if (data.size() != target.size() || data.empty()) {
+      err_msg_ = "[QuantizedNetwork::Evaluate] Invalid data input in size";
+      return INVALID_DATA;
+    }
+    for (int i = 0; i < data.size(); i++) {
+      if (data[i].size() != param_.layer_[0] || target[i].size() != class_num) {
+        err_msg_ = "[QuantizedNetwork::Evaluate] Invalid data input";
+        return INVALID_DATA;
+      }
+    }
+    std::vector<T> loss(data.size());
+    std::vector<int> label(data.size()), predict(data.size());
+    auto rc = ParallelPredict(data.size(), [&](int i, Workspace &workspace) {
+      auto &output = workspace.output_;
+      output.resize(class_num);
+      auto rc = Predict(Span<const T>(data[i]), Span<T>(output), workspace);
+      if (rc != SUCCESS) {
+        return rc;
+      }
+      loss[i] = loss_function_->AverageLoss(target[i], output);
+      predict[i] =
+          std::max_element(output.begin(), output.end()) - output.begin();
+      label[i] = std::max_element(target[i].begin(), target[i].end()) -
+                 target[i].begin();
+      return SUCCESS;
+    });
+    if (rc != SUCCESS) {
+      return rc;
+    }
+
+    // sum in sample order so the result not depend on scheduling
+    T loss_sum = 0;
+    int right_count = 0;
+    result.confusion_matrix_.assign(class_num, std::vector<int>(class_num, 0));
+    for (int i = 0; i < data.size(); i++) {
+      loss_sum += loss[i];
+      right_count += predict[i] == label[i];
+      result.confusion_matrix_[label[i]][predict[i]]++;
+    }
+    result.loss_ = loss_sum / data.size();
+    result.accuracy_ = right_count * 1.0 / data.size();
+    return SUCCESS;
+  }
+
+public:
+  inline std::string err_msg() { return err_msg_; }
+  inline const std::vector<int> &layer() { return param_.layer_; }
+
+private:
+  // func(i, workspace) for every sample i, chunk of kPredictChunk spread
+  // over the pool with one workspace per task. the first task in task order
+  // that fail give the rc and err_msg_, a failed task stop at that sample
+  template <typename Func> RC ParallelPredict(int size, const Func &func) {
+    int chunk_num = (size + kPredictChunk - 1) / kPredictChunk;
+    int task_num = std::min(chunk_num, ThreadPool::Global().thread_num());
+    std::vector<Workspace> workspace(task_num);
+    std::vector<RC> task_rc(task_num, SUCCESS);
+    ThreadPool::Global().ParallelFor(0, task_num, 1, [&](int begin, int end) {
+      for (int task = begin; task < end; task++) {
+        auto &rc = task_rc[task];
+        for (int chunk = task; chunk < chunk_num && rc == SUCCESS;
+             chunk += task_num) {
+          int last = std::min(size, (chunk + 1) * kPredictChunk);
+          for (int i = chunk * kPredictChunk; i < last && rc == SUCCESS; i++) {
+            rc = func(i, workspace[task]);
+          }
+        }
+      }
+    });
+    for (int i = 0; i < task_num; i++) {
+      if (task_rc[i] != SUCCESS) {
+        err_msg_ = workspace[i].err_msg_;
+        return task_rc[i];
+      }
+    }
+    return SUCCESS;
+  }
+
+  enum NetworkStatus {
+    NETWORK_STATUS_UNINIT,
+    NETWORK_STATUS_INIT,
+  };
+
+  QuantizedParam param_;
+  // padded copy of param_.weight_ that the kernel read
+  std::vector<AlignedVector<std::int8_t>> weight_;
+  std::vector<int> padded_size_;
+  // output = dot * scale_ + offset_
+  std::vector<std::vector<T>> scale_;
+  std::vector<std::vector<T>> offset_;
+  std::shared_ptr<LossFunction<T>> loss_function_ = nullptr;
+  std::shared_ptr<ActivateFunction<T>> activate_function_ = nullptr;
+  std::shared_ptr<SoftmaxFunction<T>> softmax_function_ = nullptr;
+  NetworkStatus network_status_ = NETWORK_STATUS_UNINIT;
+  Workspace workspace_;
+  std::string err_msg_;
+};
+
+using QuantizedNetwork = BasicQuantizedNetwork<double>;
+using FloatQuantizedNetwork = BasicQuantizedNetwork<float>;
+
+} // namespace deeplearning
@@ -4,14 +4,11 @@
 #include <memory>
 namespace deeplearning {
 
-class NoneSoftmax : public SoftmaxFunction {
+template <typename T> class NoneSoftmax : public SoftmaxFunction<T> {
 public:
-  void Normalize(const std::vector<double> &, std::vector<double> &) override {
-    return;
-  }
-  double CalcDelta(double, double, std::shared_ptr<LossFunction>) override {
-    return 0;
-  }
+  void Normalize(Span<const T>, Span<T>) override { return; }
+  void Normalize(Matrix<T> &) override { return; }
+  T CalcDelta(T, T, std::shared_ptr<LossFunction<T>>) override { return 0; }
   SoftmaxType GetSoftmaxType() override { return SOFTMAX_NONE; }
 
 private:
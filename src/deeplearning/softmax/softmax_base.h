@@ -1,6 +1,9 @@
 #pragma once
 
+#include "kernel/math_accuracy.h"
 #include "loss/loss_base.h"
+#include "util/matrix.h"
+#include "util/span.h"
 #include <memory>
 #include <utility>
 #include <vector>
@@ -11,13 +14,27 @@ enum SoftmaxType {
   SOFTMAX_STD,
 };
 
-class SoftmaxFunction {
+template <typename T> class SoftmaxFunction {
 public:
-  virtual void Normalize(const std::vector<double> &input,
-                         std::vector<double> &output) = 0;
-  virtual double CalcDelta(double output, double target,
-                           std::shared_ptr<LossFunction> loss_function) = 0;
+  virtual void Normalize(Span<const T> input, Span<T> output) = 0;
+  // batch version, normalize every row of the logits matrix in place
+  virtual void Normalize(Matrix<T> &logits) {
+    for (int i = 0; i < logits.rows(); i++) {
+      Normalize(logits[i], logits[i]);
+    }
+  }
+  virtual T CalcDelta(T output, T target,
+                      std::shared_ptr<LossFunction<T>> loss_function) = 0;
   virtual SoftmaxType GetSoftmaxType() = 0;
+
+  // tier of the exp inside Normalize
+  inline MathAccuracy math_accuracy() { return math_accuracy_; }
+  inline void set_math_accuracy(MathAccuracy accuracy) {
+    math_accuracy_ = accuracy;
+  }
+
+protected:
+  MathAccuracy math_accuracy_ = MATH_ACCURACY_EXACT;
 };
 
 } // namespace deeplearning
@@ -9,12 +9,13 @@ namespace deeplearning {
 
 class SoftmaxFactory {
 public:
-  static std::shared_ptr<SoftmaxFunction> Create(SoftmaxType softmax_type) {
+  template <typename T = double>
+  static std::shared_ptr<SoftmaxFunction<T>> Create(SoftmaxType softmax_type) {
     switch (softmax_type) {
     case SOFTMAX_NONE:
-      return std::make_shared<NoneSoftmax>();
+      return std::make_shared<NoneSoftmax<T>>();
     case SOFTMAX_STD:
-      return std::make_shared<StdSoftmax>();
+      return std::make_shared<StdSoftmax<T>>();
     default:
       return nullptr;
     }
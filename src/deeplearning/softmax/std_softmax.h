@@ -1,27 +1,27 @@
 #pragma once
 
+#include "../kernel/dispatch.h"
 #include "softmax_base.h"
-#include <cmath>
 #include <memory>
 namespace deeplearning {
 
-class StdSoftmax : public SoftmaxFunction {
+template <typename T> class StdSoftmax : public SoftmaxFunction<T> {
 public:
-  void Normalize(const std::vector<double> &input,
-                 std::vector<double> &output) override {
-    long double sum = 0;
-    for (int i = 0; i < input.size(); i++) {
-      sum += std::exp(input[i]);
-    }
-    if (sum == 0 || input.size() != output.size()) {
+  // output = e^(input - max) / sum, input may alias output and no buffer is
+  // allocated
+  void Normalize(Span<const T> input, Span<T> output) override {
+    if (input.size() != output.size()) {
       return;
     }
-    for (int i = 0; i < input.size(); i++) {
-      output[i] = std::exp(input[i]) / sum;
-    }
+    kernel::GetKernelTable<T>().softmax_[this->math_accuracy_](
+        1, input.size(), input.data(), output.data());
+  }
+  void Normalize(Matrix<T> &logits) override {
+    kernel::GetKernelTable<T>().softmax_[this->math_accuracy_](
+        logits.rows(), logits.cols(), logits.data(), logits.data());
   }
-  double CalcDelta(double output, double target,
-                   std::shared_ptr<LossFunction> loss_function) override {
+  T CalcDelta(T output, T target,
+              std::shared_ptr<LossFunction<T>> loss_function) override {
     switch (loss_function->GetLossType()) {
     case LOSS_MSE:
       return output - target;
@@ -0,0 +1,509 @@
+#pragma once
+#include "neural_network.h"
+#include "softmax/std_softmax.h"
+#include "util/span.h"
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+namespace deeplearning {
+
+// StaticNeuralNetwork fix the topology and the activate/loss/optimizer at
+// compile time, e.g.
+//   StaticNeuralNetwork<SigmoidActivate<double>, MSELoss<double>,
+//                       SGDOptimizer<double>, 784, 128, 10>
+// every loop bound is constexpr and every policy call is direct, so the
+// compiler can unroll and vectorize the hot loop. param and option use the
+// same struct as NeuralNetwork, a model can be moved between them with
+// Export/ImportNetworkParam or NeuralNetworkLoader.
+// all buffer is inline std::array, new a large topology on heap
+template <typename Activation, typename Loss, typename Optimizer,
+          int... Layers>
+class StaticNeuralNetwork {
+public:
+  using Scalar = typename Activation::Scalar;
+  static_assert(std::is_same<Scalar, typename Loss::Scalar>::value &&
+                    std::is_same<Scalar, typename Optimizer::Scalar>::value,
+                "policy must share one scalar type");
+  static_assert(sizeof...(Layers) >= 2, "need input and output layer");
+
+  enum RC {
+    SUCCESS,
+    INVALID_DATA,
+    NOT_INIT,
+    ALREADY_INIT,
+  };
+  enum NetworkStatus {
+    NETWORK_STATUS_UNINIT,
+    NETWORK_STATUS_INIT,
+  };
+  using NetworkParam = typename BasicNeuralNetwork<Scalar>::NetworkParam;
+  using NetworkOption = typename BasicNeuralNetwork<Scalar>::NetworkOption;
+
+  static constexpr int kLayerNum = sizeof...(Layers);
+  static constexpr std::array<int, kLayerNum> kLayer = {Layers...};
+  static constexpr int kInputSize = kLayer[0];
+  static constexpr int kOutputSize = kLayer[kLayerNum - 1];
+
+public:
+  StaticNeuralNetwork()
+      : optimizer_(std::vector<int>(kLayer.begin(), kLayer.end())) {}
+  ~StaticNeuralNetwork() = default;
+  StaticNeuralNetwork(const StaticNeuralNetwork &) = delete;
+  StaticNeuralNetwork &operator=(const StaticNeuralNetwork &) = delete;
+
+  RC Init() {
+    if (network_status_ != NETWORK_STATUS_UNINIT) {
+      err_msg_ = "[StaticNeuralNetwork::Init] Network has init";
+      return ALREADY_INIT;
+    }
+    learning_rate_ = 0.1;
+    rand_seed_ = 0;
+    softmax_type_ = SOFTMAX_NONE;
+    neuron_weight_.fill(0);
+    neuron_bias_.fill(0);
+    weight_grad_.fill(0);
+    bias_grad_.fill(0);
+    network_status_ = NETWORK_STATUS_INIT;
+    return SUCCESS;
+  }
+
+  RC Train(const std::vector<std::vector<Scalar>> &data,
+           const std::vector<std::vector<Scalar>> &target,
+           std::function<void(StaticNeuralNetwork &network, int epoch_num,
+                              bool &early_stop)>
+               each_epoch_call = nullptr,
+           int epoch_num = 0, int batch_num = 1, Scalar learning_rate = 0) {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      err_msg_ = "[StaticNeuralNetwork::Train] Network not init";
+      return NOT_INIT;
+    }
+    if (data.size() != target.size() || batch_num <= 0 ||
+        batch_num > data.size()) {
+      err_msg_ = "[StaticNeuralNetwork::Train] Invalid data input in size";
+      return INVALID_DATA;
+    }
+    for (int i = 0; i < data.size(); i++) {
+      if (data[i].size() != kInputSize || target[i].size() != kOutputSize) {
+        err_msg_ = "[StaticNeuralNetwork::Train] Invalid data input";
+        return INVALID_DATA;
+      }
+    }
+
+    // init learning_rate
+    if (learning_rate != 0) {
+      learning_rate_ = learning_rate;
+    } else {
+      learning_rate_ = (learning_rate_ != 0) ? learning_rate_ : 0.1;
+    }
+
+    std::vector<int> index_pos(data.size());
+    for (int i = 0; i < data.size(); i++) {
+      index_pos[i] = i;
+    }
+    auto max_batch_num = data.size() / batch_num;
+
+    epoch_num = epoch_num == 0 ? data.size() : epoch_num;
+    for (int i = 0; i < epoch_num; i++) {
+      auto init_batch_num = (i % max_batch_num) * batch_num;
+      if (i % max_batch_num == 0) {
+        Random::RandomShuffle(index_pos);
+      }
+
+      // accumulate gradient of the whole batch, then update once
+      for (int j = 0; j < batch_num; j++) {
+        auto pos = index_pos[init_batch_num + j];
+        ForwardPropagation(data[pos].data());
+        BackPropagation(target[pos].data());
+      }
+      UpdateAllNeuron(batch_num);
+
+      // callback
+      auto early_stop = false;
+      if (each_epoch_call != nullptr) {
+        each_epoch_call(*this, i, early_stop);
+        if (early_stop) {
+          break;
+        }
+      }
+    }
+    return SUCCESS;
+  }
+
+  RC Predict(const std::vector<Scalar> &data, std::vector<Scalar> &result) {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      err_msg_ = "[StaticNeuralNetwork::Predict] Network not init";
+      return NOT_INIT;
+    }
+    if (data.size() != kInputSize) {
+      err_msg_ = "[StaticNeuralNetwork::Predict] Invalid data input";
+      return INVALID_DATA;
+    }
+    ForwardPropagation(data.data());
+    auto output = LayerOutput(kLayerNum - 1);
+    result.assign(output, output + kOutputSize);
+    return SUCCESS;
+  }
+
+  RC Predict(const std::array<Scalar, kInputSize> &data,
+             std::array<Scalar, kOutputSize> &result) {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      err_msg_ = "[StaticNeuralNetwork::Predict] Network not init";
+      return NOT_INIT;
+    }
+    ForwardPropagation(data.data());
+    auto output = LayerOutput(kLayerNum - 1);
+    std::copy(output, output + kOutputSize, result.begin());
+    return SUCCESS;
+  }
+
+  RC CalcLoss(const std::vector<std::vector<Scalar>> &data,
+              const std::vector<std::vector<Scalar>> &target, Scalar &loss) {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      err_msg_ = "[StaticNeuralNetwork::CalcLoss] Network not init";
+      return NOT_INIT;
+    }
+    if (data.size() != target.size() || data.size() == 0) {
+      err_msg_ = "[StaticNeuralNetwork::CalcLoss] Invalid data input in size";
+      return INVALID_DATA;
+    }
+    Scalar loss_sum = 0;
+    for (int i = 0; i < data.size(); i++) {
+      if (data[i].size() != kInputSize || target[i].size() != kOutputSize) {
+        err_msg_ = "[StaticNeuralNetwork::CalcLoss] Invalid data input";
+        return INVALID_DATA;
+      }
+      ForwardPropagation(data[i].data());
+      loss_sum += loss_.AverageLoss(
+          target[i], Span<const Scalar>(LayerOutput(kLayerNum - 1),
+                                        kOutputSize));
+    }
+    loss = loss_sum / data.size();
+    return SUCCESS;
+  }
+
+  RC ExportNetworkParam(NetworkParam &param, NetworkOption &option) {
+    if (network_status_ != NETWORK_STATUS_INIT) {
+      err_msg_ = "[StaticNeuralNetwork::ExportNetworkParam] Network not init";
+      return NOT_INIT;
+    }
+    param.layer_.assign(kLayer.begin(), kLayer.end());
+    param.neuron_bias_.resize(kLayerNum);
+    param.neuron_weight_.resize(kLayerNum);
+    for (int i = 0; i < kLayerNum; i++) {
+      auto bias = &neuron_bias_[NeuronOffset(i)];
+      param.neuron_bias_[i].assign(bias, bias + kLayer[i]);
+      param.neuron_weight_[i].clear();
+      if (i == 0) {
+        continue;
+      }
+      param.neuron_weight_[i].resize(kLayer[i]);
+      for (int j = 0; j < kLayer[i]; j++) {
+        auto weight = LayerWeight(i) + j * kLayer[i - 1];
+        param.neuron_weight_[i][j].assign(weight, weight + kLayer[i - 1]);
+      }
+    }
+
+    option.learning_rate_ = learning_rate_;
+    option.rand_seed_ = rand_seed_;
+    option.loss_type_ = loss_.GetLossType();
+    option.activate_type_ = activate_.GetActivateType();
+    option.softmax_type_ = softmax_type_;
+    option.optimizer_type_ = optimizer_.GetOptimizerType();
+    optimizer_.ExportState(param.optimizer_state_);
+    return SUCCESS;
+  }
+
+  RC ImportNetworkParam(const NetworkParam &param,
+                        const NetworkOption &option) {
+    if (network_status_ != NETWORK_STATUS_UNINIT) {
+      err_msg_ = "[StaticNeuralNetwork::ImportNetworkParam] Network has init";
+      return ALREADY_INIT;
+    }
+    if (param.layer_ != std::vector<int>(kLayer.begin(), kLayer.end()) ||
+        param.neuron_bias_.size() != kLayerNum ||
+        param.neuron_weight_.size() != kLayerNum) {
+      err_msg_ = "[StaticNeuralNetwork::ImportNetworkParam] Layer mismatch";
+      return INVALID_DATA;
+    }
+    // policy is compiled in, the file must be trained with the same one
+    if (option.loss_type_ != loss_.GetLossType() ||
+        option.activate_type_ != activate_.GetActivateType() ||
+        option.optimizer_type_ != optimizer_.GetOptimizerType()) {
+      err_msg_ = "[StaticNeuralNetwork::ImportNetworkParam] Policy mismatch";
+      return INVALID_DATA;
+    }
+    for (int i = 0; i < kLayerNum; i++) {
+      if (param.neuron_bias_[i].size() != kLayer[i]) {
+        err_msg_ = "[StaticNeuralNetwork::ImportNetworkParam] Invalid bias";
+        return INVALID_DATA;
+      }
+      std::copy(param.neuron_bias_[i].begin(), param.neuron_bias_[i].end(),
+                &neuron_bias_[NeuronOffset(i)]);
+      if (i == 0) {
+        continue;
+      }
+      if (param.neuron_weight_[i].size() != kLayer[i]) {
+        err_msg_ = "[StaticNeuralNetwork::ImportNetworkParam] Invalid weight";
+        return INVALID_DATA;
+      }
+      for (int j = 0; j < kLayer[i]; j++) {
+        auto &row = param.neuron_weight_[i][j];
+        if (row.size() != kLayer[i - 1]) {
+          err_msg_ =
+              "[StaticNeuralNetwork::ImportNetworkParam] Invalid weight";
+          return INVALID_DATA;
+        }
+        std::copy(row.begin(), row.end(), LayerWeight(i) + j * kLayer[i - 1]);
+      }
+    }
+    if (!param.optimizer_state_.empty() &&
+        !optimizer_.ImportState(param.optimizer_state_)) {
+      err_msg_ = "[StaticNeuralNetwork::ImportNetworkParam] Invalid state";
+      return INVALID_DATA;
+    }
+    learning_rate_ = option.learning_rate_;
+    rand_seed_ = option.rand_seed_;
+    softmax_type_ = option.softmax_type_;
+    weight_grad_.fill(0);
+    bias_grad_.fill(0);
+
+    network_status_ = NETWORK_STATUS_INIT;
+    return SUCCESS;
+  }
+
+public:
+  inline std::string err_msg() { return err_msg_; }
+  inline Scalar learning_rate() { return learning_rate_; }
+  inline int rand_seed() { return rand_seed_; }
+  inline NetworkStatus network_status() { return network_status_; }
+  inline MathAccuracy math_accuracy() { return activate_.math_accuracy(); }
+  inline StatePrecision optimizer_state_precision() {
+    return optimizer_.state_precision();
+  }
+
+  inline void set_learning_rate(Scalar rate) { learning_rate_ = rate; }
+  inline void set_random_seed(int seed) { rand_seed_ = seed; }
+  inline void set_math_accuracy(MathAccuracy accuracy) {
+    activate_.set_math_accuracy(accuracy);
+    softmax_.set_math_accuracy(accuracy);
+  }
+  // reset the optimizer state, see NeuralNetwork
+  inline void set_optimizer_state_precision(StatePrecision precision) {
+    optimizer_.set_state_precision(precision);
+  }
+  inline RC set_softmax_function(SoftmaxType type) {
+    if (type != SOFTMAX_NONE && type != SOFTMAX_STD) {
+      err_msg_ = "[StaticNeuralNetwork::set_softmax_function] Invalid type";
+      return INVALID_DATA;
+    }
+    softmax_type_ = type;
+    return SUCCESS;
+  }
+  // reuse the runtime param init, then copy into the static buffer
+  inline RC set_param_init_function(ParamInitType type) {
+    auto param_init = ParamInitFactory::Create<Scalar>(type);
+    if (param_init == nullptr) {
+      err_msg_ = "[StaticNeuralNetwork::set_param_init_function] Invalid type";
+      return INVALID_DATA;
+    }
+    std::vector<Matrix<Scalar>> weight(kLayerNum);
+    std::vector<AlignedVector<Scalar>> bias(kLayerNum);
+    for (int i = 0; i < kLayerNum; i++) {
+      bias[i].assign(kLayer[i], 0);
+      if (i != 0) {
+        weight[i].Resize(kLayer[i], kLayer[i - 1]);
+      }
+    }
+    param_init->InitParam(weight, bias);
+    for (int i = 0; i < kLayerNum; i++) {
+      std::copy(bias[i].begin(), bias[i].end(), &neuron_bias_[NeuronOffset(i)]);
+      if (i != 0) {
+        std::copy(weight[i].begin(), weight[i].end(), LayerWeight(i));
+      }
+    }
+    return SUCCESS;
+  }
+
+private:
+  static constexpr int NeuronOffset(int layer) {
+    int offset = 0;
+    for (int i = 0; i < layer; i++) {
+      offset += kLayer[i];
+    }
+    return offset;
+  }
+  // weight of layer i is a kLayer[i] x kLayer[i - 1] row-major block
+  static constexpr int WeightOffset(int layer) {
+    int offset = 0;
+    for (int i = 1; i < layer; i++) {
+      offset += kLayer[i] * kLayer[i - 1];
+    }
+    return offset;
+  }
+  static constexpr int kNeuronSize = NeuronOffset(kLayerNum);
+  static constexpr int kWeightSize = WeightOffset(kLayerNum);
+  // independent partial sum so the dot product vectorize without fast-math
+  static constexpr int kDotLane = 8;
+
+  inline Scalar *LayerOutput(int layer) {
+    return &neuron_output_[NeuronOffset(layer)];
+  }
+  inline Scalar *LayerWeight(int layer) {
+    return &neuron_weight_[WeightOffset(layer)];
+  }
+
+  template <int N> static Scalar Dot(const Scalar *left, const Scalar *right) {
+    Scalar sum[kDotLane] = {};
+    constexpr int kBody = N / kDotLane * kDotLane;
+    for (int i = 0; i < kBody; i += kDotLane) {
+      for (int j = 0; j < kDotLane; j++) {
+        sum[j] += left[i + j] * right[i + j];
+      }
+    }
+    for (int i = kBody; i < N; i++) {
+      sum[i - kBody] += left[i] * right[i];
+    }
+    Scalar result = 0;
+    for (int j = 0; j < kDotLane; j++) {
+      result += sum[j];
+    }
+    return result;
+  }
+
+  // output = activate(weight * last_output + bias), softmax output layer
+  // keep the raw logits for normalize
+  template <int L> void ForwardLayer() {
+    constexpr int kRows = kLayer[L], kCols = kLayer[L - 1];
+    const Scalar *input = &neuron_output_[NeuronOffset(L - 1)];
+    const Scalar *weight = &neuron_weight_[WeightOffset(L)];
+    const Scalar *bias = &neuron_bias_[NeuronOffset(L)];
+    Scalar *output = &neuron_output_[NeuronOffset(L)];
+    for (int i = 0; i < kRows; i++) {
+      output[i] = bias[i] + Dot<kCols>(weight + i * kCols, input);
+    }
+    if (L != kLayerNum - 1 || softmax_type_ == SOFTMAX_NONE) {
+      activate_.Activate(Span<const Scalar>(output, kRows),
+                         Span<Scalar>(output, kRows));
+    }
+    if constexpr (L + 1 < kLayerNum) {
+      ForwardLayer<L + 1>();
+    }
+  }
+
+  void ForwardPropagation(const Scalar *data) {
+    std::copy(data, data + kInputSize, neuron_output_.begin());
+    ForwardLayer<1>();
+    if (softmax_type_ != SOFTMAX_NONE) {
+      Span<Scalar> output(LayerOutput(kLayerNum - 1), kOutputSize);
+      softmax_.Normalize(output, output);
+    }
+  }
+
+  // delta[L] = (delta[L + 1] * weight[L + 1]) . activate'(output[L])
+  template <int L> void BackwardLayer() {
+    constexpr int kRows = kLayer[L + 1], kCols = kLayer[L];
+    const Scalar *next_delta = &neuron_delta_[NeuronOffset(L + 1)];
+    const Scalar *weight = &neuron_weight_[WeightOffset(L + 1)];
+    const Scalar *output = &neuron_output_[NeuronOffset(L)];
+    Scalar *delta = &neuron_delta_[NeuronOffset(L)];
+    std::fill(delta, delta + kCols, 0);
+    for (int i = 0; i < kRows; i++) {
+      const Scalar *weight_row = weight + i * kCols;
+      for (int j = 0; j < kCols; j++) {
+        delta[j] += next_delta[i] * weight_row[j];
+      }
+    }
+    activate_.DerivActivate(Span<const Scalar>(output, kCols),
+                            Span<Scalar>(delta, kCols));
+    if constexpr (L > 1) {
+      BackwardLayer<L - 1>();
+    }
+  }
+
+  // sum gradient of current sample into weight_grad_ and bias_grad_
+  template <int L> void AccumulateGrad() {
+    constexpr int kRows = kLayer[L], kCols = kLayer[L - 1];
+    const Scalar *delta = &neuron_delta_[NeuronOffset(L)];
+    const Scalar *input = &neuron_output_[NeuronOffset(L - 1)];
+    Scalar *weight_grad = &weight_grad_[WeightOffset(L)];
+    Scalar *bias_grad = &bias_grad_[NeuronOffset(L)];
+    for (int i = 0; i < kRows; i++) {
+      Scalar *grad_row = weight_grad + i * kCols;
+      for (int j = 0; j < kCols; j++) {
+        grad_row[j] += delta[i] * input[j];
+      }
+      bias_grad[i] += delta[i];
+    }
+    if constexpr (L + 1 < kLayerNum) {
+      AccumulateGrad<L + 1>();
+    }
+  }
+
+  // ForwardPropagation has run on the same sample before
+  void BackPropagation(const Scalar *target) {
+    const Scalar *output = LayerOutput(kLayerNum - 1);
+    Scalar *delta = &neuron_delta_[NeuronOffset(kLayerNum - 1)];
+    for (int i = 0; i < kOutputSize; i++) {
+      if (softmax_type_ != SOFTMAX_NONE) {
+        // same as StdSoftmax::CalcDelta for mse and cross entropy
+        delta[i] = output[i] - target[i];
+      } else {
+        delta[i] = loss_.DerivLoss(target[i], output[i]) / (Scalar)kOutputSize;
+      }
+    }
+    if (softmax_type_ == SOFTMAX_NONE) {
+      activate_.DerivActivate(Span<const Scalar>(output, kOutputSize),
+                              Span<Scalar>(delta, kOutputSize));
+    }
+    if constexpr (kLayerNum > 2) {
+      BackwardLayer<kLayerNum - 2>();
+    }
+    AccumulateGrad<1>();
+  }
+
+  // apply optimizer once with the batch average gradient, then clear it
+  void UpdateAllNeuron(int batch_size) {
+    Scalar scale = 1.0 / batch_size;
+    for (int i = 1; i < kLayerNum; i++) {
+      int weight_size = kLayer[i] * kLayer[i - 1];
+      Scalar *weight_grad = &weight_grad_[WeightOffset(i)];
+      Scalar *bias_grad = &bias_grad_[NeuronOffset(i)];
+      optimizer_.Update(Span<Scalar>(LayerWeight(i), weight_size),
+                        Span<const Scalar>(weight_grad, weight_size),
+                        optimizer_.weight_state(i), learning_rate_, scale);
+      optimizer_.Update(
+          Span<Scalar>(&neuron_bias_[NeuronOffset(i)], kLayer[i]),
+          Span<const Scalar>(bias_grad, kLayer[i]), optimizer_.bias_state(i),
+          learning_rate_, scale);
+      std::fill(weight_grad, weight_grad + weight_size, 0);
+      std::fill(bias_grad, bias_grad + kLayer[i], 0);
+    }
+  }
+
+private:
+  // held by value, the dynamic type is known so every call is bound
+  // directly, the policy class need not be final and can still be derived
+  Activation activate_;
+  Loss loss_;
+  Optimizer optimizer_;
+  StdSoftmax<Scalar> softmax_;
+  SoftmaxType softmax_type_ = SOFTMAX_NONE;
+
+  NetworkStatus network_status_ = NETWORK_STATUS_UNINIT;
+  int rand_seed_ = 0;
+  Scalar learning_rate_ = 0.1;
+  // every layer packed back to back, see NeuronOffset and WeightOffset
+  alignas(kCacheLineSize) std::array<Scalar, kWeightSize> neuron_weight_ = {};
+  alignas(kCacheLineSize) std::array<Scalar, kWeightSize> weight_grad_ = {};
+  alignas(kCacheLineSize) std::array<Scalar, kNeuronSize> neuron_bias_ = {};
+  alignas(kCacheLineSize) std::array<Scalar, kNeuronSize> bias_grad_ = {};
+  alignas(kCacheLineSize) std::array<Scalar, kNeuronSize> neuron_output_ = {};
+  alignas(kCacheLineSize) std::array<Scalar, kNeuronSize> neuron_delta_ = {};
+  std::string err_msg_;
+};
+
+} // namespace deeplearning
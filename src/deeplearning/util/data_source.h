@@ -0,0 +1,383 @@
+#pragma once
+#include "dataset.h"
+#include "random.h"
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace deeplearning {
+
+// batch stream for Train when the data do not fit in memory. a pass read
+// every sample once, Reset start the next one
+template <typename T> class DataSource {
+public:
+  virtual ~DataSource() = default;
+  // back to the first sample, false on error
+  virtual bool Reset() = 0;
+  // write up to max_size sample as rows of sample_size() into data and of
+  // target_size() into target. return the count, less than max_size only at
+  // the end of a pass, -1 on error
+  virtual int NextBatch(int max_size, T *data, T *target) = 0;
+  // sample of one pass, -1 when unknown
+  virtual long long SizeHint() const { return -1; }
+  virtual int sample_size() const = 0;
+  virtual int target_size() const = 0;
+  virtual std::string err_msg() const { return ""; }
+};
+
+// a record file is a RecordHeader then size_ record of the same size, each
+// an encoded Dataset row and a label byte, so a pass is one sequential read
+struct RecordHeader {
+  std::uint32_t magic_;
+  std::int32_t format_;
+  std::int32_t sample_size_;
+  std::int32_t class_num_;
+  double scale_;
+  std::int64_t size_;
+};
+// "DLR1"
+constexpr std::uint32_t kRecordMagic = 0x31524c44;
+
+// append record one at a time, the data never has to be in memory at once
+class RecordWriter {
+public:
+  enum RC {
+    SUCCESS,
+    FILE_OPEN_ERROR,
+    INVALID_DATA,
+  };
+  static constexpr std::size_t kFlushBytes = 1 << 20;
+
+public:
+  RecordWriter() = default;
+  ~RecordWriter() { Close(); }
+
+  RC Open(const std::string &filename, Dataset::Format format,
+          int sample_size, int class_num, double scale = 1) {
+    Close();
+    // the one row dataset encode Append and check the shape
+    if (row_.Init(format, 1, sample_size, class_num, scale) !=
+        Dataset::SUCCESS) {
+      err_msg_ = "[RecordWriter::Open] " + row_.err_msg();
+      return INVALID_DATA;
+    }
+    file_.open(filename, std::ios::binary | std::ios::trunc);
+    if (!file_.is_open()) {
+      err_msg_ = "[RecordWriter::Open] File open error: " + filename;
+      return FILE_OPEN_ERROR;
+    }
+    header_ = {kRecordMagic, (std::int32_t)format, sample_size, class_num,
+               scale, 0};
+    row_bytes_ = Dataset::RowBytes(format, sample_size);
+    file_.write((const char *)&header_, sizeof(header_));
+    buffer_.clear();
+    return SUCCESS;
+  }
+
+  // one byte per feature, the same as Dataset::SetSample
+  RC Append(const std::uint8_t *value, int label) {
+    if (!file_.is_open()) {
+      err_msg_ = "[RecordWriter::Append] File not open";
+      return INVALID_DATA;
+    }
+    row_.SetSample(0, value);
+    return AppendRow(row_.row(0), label);
+  }
+
+  // a row already encoded in the format of the file
+  RC AppendRow(const std::uint8_t *row, int label) {
+    if (!file_.is_open() || label < 0 || label >= header_.class_num_) {
+      err_msg_ = "[RecordWriter::AppendRow] Invalid data input";
+      return INVALID_DATA;
+    }
+    buffer_.insert(buffer_.end(), row, row + row_bytes_);
+    buffer_.push_back(label);
+    header_.size_++;
+    if (buffer_.size() >= kFlushBytes) {
+      file_.write((const char *)buffer_.data(), buffer_.size());
+      buffer_.clear();
+    }
+    return SUCCESS;
+  }
+
+  // flush and write the final count into the header
+  RC Close() {
+    if (!file_.is_open()) {
+      return SUCCESS;
+    }
+    file_.write((const char *)buffer_.data(), buffer_.size());
+    buffer_.clear();
+    file_.seekp(0);
+    file_.write((const char *)&header_, sizeof(header_));
+    bool good = file_.good();
+    file_.close();
+    if (!good) {
+      err_msg_ = "[RecordWriter::Close] File write error";
+      return FILE_OPEN_ERROR;
+    }
+    return SUCCESS;
+  }
+
+  static RC Write(const Dataset &data, const std::string &filename) {
+    RecordWriter writer;
+    auto rc = writer.Open(filename, data.format(), data.sample_size(),
+                          data.class_num(), data.scale());
+    for (int i = 0; i < data.size() && rc == SUCCESS; i++) {
+      rc = writer.AppendRow(data.row(i), data.label(i));
+    }
+    if (rc != SUCCESS) {
+      return rc;
+    }
+    return writer.Close();
+  }
+
+public:
+  inline std::string err_msg() const { return err_msg_; }
+
+private:
+  std::ofstream file_;
+  RecordHeader header_ = {};
+  int row_bytes_ = 0;
+  Dataset row_;
+  std::vector<std::uint8_t> buffer_;
+  std::string err_msg_;
+};
+
+// stream a record file chunk by chunk. two chunk are in memory, the one
+// batches are taken from and the next one, which the source's own reader
+// thread fill meanwhile, so training wait on the disk only when the disk is
+// the slower. the reader live as long as the source and only block on the
+// file, it never hold a worker of the compute pool. a chunk is a Dataset
+// view, sample decode as Dataset::LoadSample
+template <typename T> class RecordFileSource : public DataSource<T> {
+public:
+  enum RC {
+    SUCCESS,
+    FILE_OPEN_ERROR,
+    DATA_FORMAT_ERROR,
+  };
+
+public:
+  RecordFileSource() = default;
+  RecordFileSource(const RecordFileSource &) = delete;
+  RecordFileSource &operator=(const RecordFileSource &) = delete;
+  ~RecordFileSource() {
+    Wait();
+    if (reader_.joinable()) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      cv_.notify_all();
+      reader_.join();
+    }
+  }
+
+  // chunk_bytes is the size of one read. shuffle permute the record inside
+  // each chunk, the chunk themselves come in file order
+  RC Open(const std::string &filename, std::size_t chunk_bytes = 8 << 20,
+          bool shuffle = true) {
+    Wait();
+    file_.close();
+    file_.clear();
+    file_.open(filename, std::ios::binary);
+    if (!file_.is_open()) {
+      err_msg_ = "[RecordFileSource::Open] File open error: " + filename;
+      return FILE_OPEN_ERROR;
+    }
+    RecordHeader header;
+    if (!file_.read((char *)&header, sizeof(header)) ||
+        header.magic_ != kRecordMagic || header.format_ < 0 ||
+        header.format_ > Dataset::FORMAT_UINT8_BINARY ||
+        header.sample_size_ <= 0 || header.class_num_ <= 0 ||
+        header.class_num_ > 256 || header.size_ < 0) {
+      file_.close();
+      err_msg_ = "[RecordFileSource::Open] Invalid header: " + filename;
+      return DATA_FORMAT_ERROR;
+    }
+    format_ = (Dataset::Format)header.format_;
+    row_bytes_ = Dataset::RowBytes(format_, header.sample_size_);
+    record_bytes_ = row_bytes_ + 1;
+    file_.seekg(0, std::ios::end);
+    if ((std::int64_t)file_.tellg() !=
+        (std::int64_t)sizeof(header) + header.size_ * record_bytes_) {
+      file_.close();
+      err_msg_ = "[RecordFileSource::Open] File size not match: " + filename;
+      return DATA_FORMAT_ERROR;
+    }
+    header_ = header;
+    chunk_size_ = std::max<std::int64_t>(
+        1, std::min<std::int64_t>(chunk_bytes / record_bytes_, header.size_));
+    for (auto &chunk : chunk_) {
+      chunk.resize(chunk_size_ * record_bytes_);
+    }
+    shuffle_ = shuffle;
+    if (!reader_.joinable()) {
+      reader_ = std::thread([this]() { ReaderLoop(); });
+    }
+    return Reset() ? SUCCESS : DATA_FORMAT_ERROR;
+  }
+
+  bool Reset() override {
+    if (!file_.is_open()) {
+      err_msg_ = "[RecordFileSource::Reset] File not open";
+      return false;
+    }
+    Wait();
+    file_.clear();
+    file_.seekg(sizeof(RecordHeader));
+    read_count_ = 0;
+    order_.clear();
+    pos_ = 0;
+    StartRead();
+    return true;
+  }
+
+  int NextBatch(int max_size, T *data, T *target) override {
+    int count = 0;
+    while (count < max_size) {
+      if (pos_ == order_.size()) {
+        int chunk_count = NextChunk();
+        if (chunk_count < 0) {
+          return -1;
+        }
+        if (chunk_count == 0) {
+          break;
+        }
+      }
+      int index = order_[pos_++];
+      chunk_data_.LoadSample(index, data + (std::size_t)count * sample_size());
+      chunk_data_.LoadTarget(index,
+                             target + (std::size_t)count * target_size());
+      count++;
+    }
+    return count;
+  }
+
+  long long SizeHint() const override { return header_.size_; }
+  int sample_size() const override { return header_.sample_size_; }
+  int target_size() const override { return header_.class_num_; }
+  std::string err_msg() const override { return err_msg_; }
+
+private:
+  // read the next chunk into the buffer not in use, nothing at the end
+  void StartRead() {
+    int count = std::min<std::int64_t>(chunk_size_,
+                                       header_.size_ - read_count_);
+    if (count == 0) {
+      return;
+    }
+    read_count_ += count;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      request_buffer_ = (char *)chunk_[1 - current_].data();
+      request_count_ = count;
+      request_ = true;
+      done_ = false;
+    }
+    reading_ = true;
+    cv_.notify_all();
+  }
+
+  // the chunk just read become current and the other one start loading,
+  // return its record count, 0 at the end of the pass
+  int NextChunk() {
+    int count = Wait();
+    if (count < 0) {
+      err_msg_ = "[RecordFileSource::NextBatch] File read error";
+      return -1;
+    }
+    if (count == 0) {
+      return 0;
+    }
+    current_ = 1 - current_;
+    const std::uint8_t *chunk = chunk_[current_].data();
+    ByteView sample = {chunk, count, row_bytes_, (std::size_t)record_bytes_};
+    ByteView label = {chunk + row_bytes_, count, 1,
+                      (std::size_t)record_bytes_};
+    if (chunk_data_.InitView(format_, sample, label, header_.sample_size_,
+                             header_.class_num_, header_.scale_,
+                             nullptr) != Dataset::SUCCESS) {
+      err_msg_ = "[RecordFileSource::NextBatch] " + chunk_data_.err_msg();
+      return -1;
+    }
+    order_.resize(count);
+    std::iota(order_.begin(), order_.end(), 0);
+    if (shuffle_) {
+      Random::RandomShuffle(order_);
+    }
+    pos_ = 0;
+    StartRead();
+    return count;
+  }
+
+  // record count of the read in flight, -1 on error, 0 if there is none
+  int Wait() {
+    if (!reading_) {
+      return 0;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return done_; });
+    reading_ = false;
+    return read_result_;
+  }
+
+  // run one request at a time, the file is only touched here while reading_
+  void ReaderLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+      cv_.wait(lock, [this]() { return request_ || stop_; });
+      if (stop_) {
+        return;
+      }
+      request_ = false;
+      char *buffer = request_buffer_;
+      int count = request_count_;
+      lock.unlock();
+      bool good = file_.read(buffer, (std::size_t)count * record_bytes_).good();
+      lock.lock();
+      read_result_ = good ? count : -1;
+      done_ = true;
+      cv_.notify_all();
+    }
+  }
+
+private:
+  std::ifstream file_;
+  RecordHeader header_ = {};
+  Dataset::Format format_ = Dataset::FORMAT_UINT8;
+  int row_bytes_ = 0;
+  int record_bytes_ = 0;
+  // record per chunk
+  std::int64_t chunk_size_ = 0;
+  bool shuffle_ = true;
+  // record read or being read in this pass
+  std::int64_t read_count_ = 0;
+  std::vector<std::uint8_t> chunk_[2];
+  int current_ = 0;
+  // reader thread and the one request it serve, guarded by mutex_
+  std::thread reader_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  char *request_buffer_ = nullptr;
+  int request_count_ = 0;
+  int read_result_ = 0;
+  bool request_ = false;
+  bool done_ = false;
+  bool stop_ = false;
+  // a request is in flight, only used by the caller thread
+  bool reading_ = false;
+  // view of the current chunk and the order its record are taken in
+  Dataset chunk_data_;
+  std::vector<int> order_;
+  int pos_ = 0;
+  std::string err_msg_;
+};
+
+} // namespace deeplearning
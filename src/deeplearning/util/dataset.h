@@ -0,0 +1,248 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace deeplearning {
+
+// size_ row of item_size_ byte, stride_ byte apart, the memory is owned by
+// someone else, e.g. a mapped file
+struct ByteView {
+  const std::uint8_t *data_ = nullptr;
+  int size_ = 0;
+  int item_size_ = 0;
+  std::size_t stride_ = 0;
+
+  inline const std::uint8_t *Row(int index) const {
+    return data_ + (std::size_t)index * stride_;
+  }
+  // row [begin, end), still no copy
+  ByteView Slice(int begin, int end) const {
+    ByteView view = *this;
+    view.data_ = Row(begin);
+    view.size_ = end - begin;
+    return view;
+  }
+};
+
+// compact sample store for Train, CalcLoss and Predict. a sample is one row
+// of uint8, or one bit per feature for binarized data, and the target is a
+// class label. the row become T only when a batch is assembled: a uint8
+// value times scale, a bit 0 or scale. the target become one hot
+class Dataset {
+public:
+  enum RC {
+    SUCCESS,
+    INVALID_DATA,
+  };
+  enum Format {
+    FORMAT_UINT8,
+    // feature j of a row is bit j % 8 of byte j / 8
+    FORMAT_BIT,
+    // uint8 row read as 0 or scale, binarize without a packing pass so a
+    // mapped byte file can be used in place
+    FORMAT_UINT8_BINARY,
+  };
+
+public:
+  Dataset() = default;
+
+  // byte of one encoded sample
+  static int RowBytes(Format format, int sample_size) {
+    return format == FORMAT_BIT ? (sample_size + 7) / 8 : sample_size;
+  }
+
+  // size zeroed sample, fill them with SetSample and SetLabel
+  RC Init(Format format, int size, int sample_size, int class_num,
+          double scale = 1) {
+    if (size < 0 || sample_size <= 0 || class_num <= 0 || class_num > 256 ||
+        format < FORMAT_UINT8 || format > FORMAT_UINT8_BINARY) {
+      err_msg_ = "[Dataset::Init] Invalid data input";
+      return INVALID_DATA;
+    }
+    format_ = format;
+    size_ = size;
+    sample_size_ = sample_size;
+    class_num_ = class_num;
+    scale_ = scale;
+    stride_ = RowBytes(format, sample_size);
+    storage_.assign((std::size_t)size * stride_, 0);
+    label_storage_.assign(size, 0);
+    sample_view_ = ByteView();
+    label_view_ = ByteView();
+    owner_ = nullptr;
+    return SUCCESS;
+  }
+
+  // read only dataset over memory of owner, which the dataset and its copy
+  // keep alive. every label is checked once here, not on each batch
+  RC InitView(Format format, const ByteView &sample, const ByteView &label,
+              int sample_size, int class_num, double scale,
+              std::shared_ptr<const void> owner) {
+    if (sample_size <= 0 || class_num <= 0 || class_num > 256 ||
+        format < FORMAT_UINT8 || format > FORMAT_UINT8_BINARY ||
+        sample.size_ != label.size_ || label.item_size_ != 1 ||
+        sample.item_size_ != RowBytes(format, sample_size)) {
+      err_msg_ = "[Dataset::InitView] Invalid data input";
+      return INVALID_DATA;
+    }
+    for (int i = 0; i < label.size_; i++) {
+      if (*label.Row(i) >= class_num) {
+        err_msg_ = "[Dataset::InitView] Label out of range";
+        return INVALID_DATA;
+      }
+    }
+    format_ = format;
+    size_ = sample.size_;
+    sample_size_ = sample_size;
+    class_num_ = class_num;
+    scale_ = scale;
+    stride_ = sample.item_size_;
+    storage_.clear();
+    label_storage_.clear();
+    sample_view_ = sample;
+    label_view_ = label;
+    owner_ = owner;
+    return SUCCESS;
+  }
+
+  // encode nested vector, value is divided by scale and rounded into uint8,
+  // or set as a bit when at least half of scale. label is the max target
+  template <typename T>
+  RC Assign(const std::vector<std::vector<T>> &data,
+            const std::vector<std::vector<T>> &target, Format format,
+            double scale = 1) {
+    if (data.empty() || data.size() != target.size() || scale <= 0) {
+      err_msg_ = "[Dataset::Assign] Invalid data input in size";
+      return INVALID_DATA;
+    }
+    auto rc = Init(format, data.size(), data[0].size(), target[0].size(),
+                   scale);
+    if (rc != SUCCESS) {
+      return rc;
+    }
+    std::vector<std::uint8_t> row(sample_size_);
+    for (int i = 0; i < size_; i++) {
+      if (data[i].size() != sample_size_ || target[i].size() != class_num_) {
+        err_msg_ = "[Dataset::Assign] Invalid data input";
+        return INVALID_DATA;
+      }
+      for (int j = 0; j < sample_size_; j++) {
+        double value = std::round(data[i][j] / scale);
+        row[j] = std::max(0.0, std::min(255.0, value));
+      }
+      SetSample(i, row.data());
+      SetLabel(i, std::max_element(target[i].begin(), target[i].end()) -
+                      target[i].begin());
+    }
+    return SUCCESS;
+  }
+
+  // one byte per feature, a bit row set every nonzero byte
+  RC SetSample(int index, const std::uint8_t *value) {
+    if (index < 0 || index >= size_ || storage_.empty()) {
+      err_msg_ = "[Dataset::SetSample] Invalid index";
+      return INVALID_DATA;
+    }
+    std::uint8_t *row = storage_.data() + (std::size_t)index * stride_;
+    if (format_ != FORMAT_BIT) {
+      std::memcpy(row, value, sample_size_);
+      return SUCCESS;
+    }
+    std::fill(row, row + stride_, 0);
+    for (int j = 0; j < sample_size_; j++) {
+      row[j >> 3] |= (value[j] != 0) << (j & 7);
+    }
+    return SUCCESS;
+  }
+
+  RC SetLabel(int index, int label) {
+    if (index < 0 || index >= size_ || label < 0 || label >= class_num_ ||
+        label_storage_.empty()) {
+      err_msg_ = "[Dataset::SetLabel] Invalid data input";
+      return INVALID_DATA;
+    }
+    label_storage_[index] = label;
+    return SUCCESS;
+  }
+
+  // sample_size() value of sample index into out
+  template <typename T> void LoadSample(int index, T *out) const {
+    const std::uint8_t *row = Row(index);
+    T scale = scale_;
+    if (format_ == FORMAT_UINT8) {
+      for (int j = 0; j < sample_size_; j++) {
+        out[j] = row[j] * scale;
+      }
+      return;
+    }
+    if (format_ == FORMAT_UINT8_BINARY) {
+      for (int j = 0; j < sample_size_; j++) {
+        out[j] = (row[j] != 0) * scale;
+      }
+      return;
+    }
+    int j = 0;
+    for (; j + 8 <= sample_size_; j += 8) {
+      std::uint8_t bits = row[j >> 3];
+      for (int k = 0; k < 8; k++) {
+        out[j + k] = ((bits >> k) & 1) * scale;
+      }
+    }
+    for (; j < sample_size_; j++) {
+      out[j] = ((row[j >> 3] >> (j & 7)) & 1) * scale;
+    }
+  }
+
+  // class_num() value, one at the label
+  template <typename T> void LoadTarget(int index, T *out) const {
+    std::fill(out, out + class_num_, 0);
+    out[label(index)] = 1;
+  }
+
+public:
+  inline std::string err_msg() const { return err_msg_; }
+  inline int size() const { return size_; }
+  inline int sample_size() const { return sample_size_; }
+  inline int class_num() const { return class_num_; }
+  inline Format format() const { return format_; }
+  inline double scale() const { return scale_; }
+  inline int label(int index) const {
+    return storage_.empty() ? *label_view_.Row(index) : label_storage_[index];
+  }
+  // encoded sample, RowBytes(format(), sample_size()) byte
+  inline const std::uint8_t *row(int index) const { return Row(index); }
+  // byte of sample and label, for a view they are the owner's
+  inline std::size_t bytes() const {
+    return (std::size_t)size_ * stride_ + size_;
+  }
+
+private:
+  // owned storage is not a view so a copy never point into the original
+  inline const std::uint8_t *Row(int index) const {
+    return storage_.empty() ? sample_view_.Row(index)
+                            : storage_.data() + (std::size_t)index * stride_;
+  }
+
+private:
+  Format format_ = FORMAT_UINT8;
+  int size_ = 0;
+  int sample_size_ = 0;
+  int class_num_ = 0;
+  double scale_ = 1;
+  // byte of one sample row, the view may have a larger stride
+  std::size_t stride_ = 0;
+  // owned row, empty for a view
+  std::vector<std::uint8_t> storage_;
+  std::vector<std::uint8_t> label_storage_;
+  ByteView sample_view_;
+  ByteView label_view_;
+  std::shared_ptr<const void> owner_;
+  std::string err_msg_;
+};
+
+} // namespace deeplearning
@@ -0,0 +1,195 @@
+#pragma once
+#include "dataset.h"
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DEEPLEARNING_MMAP
+#endif
+
+namespace deeplearning {
+
+// whole file read only in memory. it is mapped where mmap exist, page come
+// from the page cache on first touch and a second process share them, else
+// the file is read once into a buffer
+class MappedFile {
+public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() {
+#ifdef DEEPLEARNING_MMAP
+    if (map_ != nullptr) {
+      munmap(map_, size_);
+    }
+#endif
+  }
+
+  bool Open(const std::string &filename) {
+#ifdef DEEPLEARNING_MMAP
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      return false;
+    }
+    size_ = st.st_size;
+    if (size_ > 0) {
+      void *map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map == MAP_FAILED) {
+        close(fd);
+        return false;
+      }
+      map_ = map;
+      data_ = (const std::uint8_t *)map;
+      // start the read ahead, training touch every page anyway
+      madvise(map_, size_, MADV_WILLNEED);
+    }
+    close(fd);
+    return true;
+#else
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+      return false;
+    }
+    buffer_.resize(file.tellg());
+    file.seekg(0);
+    if (!file.read((char *)buffer_.data(), buffer_.size())) {
+      return false;
+    }
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return true;
+#endif
+  }
+
+  inline const std::uint8_t *data() const { return data_; }
+  inline std::size_t size() const { return size_; }
+
+private:
+  const std::uint8_t *data_ = nullptr;
+  std::size_t size_ = 0;
+#ifdef DEEPLEARNING_MMAP
+  void *map_ = nullptr;
+#else
+  std::vector<std::uint8_t> buffer_;
+#endif
+};
+
+// IDX file, as used by mnist: two zero byte, the type, the dimension count,
+// then each dimension as big endian uint32 and the row major payload. only
+// the uint8 type is supported. the header is checked once in Open, after that
+// an item is a pointer into the mapped payload
+class IdxFile {
+public:
+  enum RC {
+    SUCCESS,
+    FILE_OPEN_ERROR,
+    DATA_FORMAT_ERROR,
+  };
+  static constexpr std::uint8_t kTypeUint8 = 0x08;
+
+public:
+  IdxFile() = default;
+
+  RC Open(const std::string &filename) {
+    auto file = std::make_shared<MappedFile>();
+    if (!file->Open(filename)) {
+      err_msg_ = "[IdxFile::Open] File open error: " + filename;
+      return FILE_OPEN_ERROR;
+    }
+    const std::uint8_t *head = file->data();
+    std::size_t size = file->size();
+    if (size < 4 || head[0] != 0 || head[1] != 0 || head[2] != kTypeUint8 ||
+        head[3] == 0 || size < 4 + 4 * (std::size_t)head[3]) {
+      err_msg_ = "[IdxFile::Open] Invalid header: " + filename;
+      return DATA_FORMAT_ERROR;
+    }
+    std::vector<int> dims(head[3]);
+    std::size_t offset = 4 + 4 * dims.size();
+    // byte of one item must fit an int, checked before each multiply so a
+    // forged dimension can not wrap it
+    std::size_t item_size = 1;
+    for (int i = 0; i < dims.size(); i++) {
+      const std::uint8_t *p = head + 4 + 4 * i;
+      std::uint32_t dim = (std::uint32_t)p[0] << 24 |
+                          (std::uint32_t)p[1] << 16 |
+                          (std::uint32_t)p[2] << 8 | p[3];
+      if (dim > 0x7fffffff ||
+          (i > 0 && (dim == 0 || dim > 0x7fffffff / item_size))) {
+        err_msg_ = "[IdxFile::Open] Invalid dimension: " + filename;
+        return DATA_FORMAT_ERROR;
+      }
+      dims[i] = dim;
+      item_size *= i > 0 ? dim : 1;
+    }
+    if ((size - offset) / item_size < (std::size_t)dims[0]) {
+      err_msg_ = "[IdxFile::Open] File truncated: " + filename;
+      return DATA_FORMAT_ERROR;
+    }
+    file_ = file;
+    dims_ = dims;
+    view_ = {file->data() + offset, dims[0], (int)item_size, item_size};
+    return SUCCESS;
+  }
+
+  // zero copy dataset over an image file and its label file, the files stay
+  // mapped as long as the dataset or a copy of it live
+  static RC OpenDataset(const std::string &image_file,
+                        const std::string &label_file, int class_num,
+                        Dataset::Format format, double scale,
+                        Dataset &dataset, std::string &err_msg) {
+    IdxFile image, label;
+    auto rc = image.Open(image_file);
+    if (rc != SUCCESS) {
+      err_msg = image.err_msg();
+      return rc;
+    }
+    rc = label.Open(label_file);
+    if (rc != SUCCESS) {
+      err_msg = label.err_msg();
+      return rc;
+    }
+    if (label.dims().size() != 1 || label.size() != image.size()) {
+      err_msg = "[IdxFile::OpenDataset] Label count not match image: " +
+                label_file;
+      return DATA_FORMAT_ERROR;
+    }
+    // both mapping live in the one owner
+    auto owner = std::make_shared<std::pair<IdxFile, IdxFile>>(image, label);
+    if (dataset.InitView(format, image.view(), label.view(),
+                         image.item_size(), class_num, scale,
+                         owner) != Dataset::SUCCESS) {
+      err_msg = dataset.err_msg();
+      return DATA_FORMAT_ERROR;
+    }
+    return SUCCESS;
+  }
+
+public:
+  inline std::string err_msg() const { return err_msg_; }
+  inline const std::vector<int> &dims() const { return dims_; }
+  // item along the first dimension, and the byte of each
+  inline int size() const { return view_.size_; }
+  inline int item_size() const { return view_.item_size_; }
+  inline ByteView view() const { return view_; }
+
+private:
+  std::shared_ptr<const MappedFile> file_;
+  std::vector<int> dims_;
+  ByteView view_;
+  std::string err_msg_;
+};
+
+} // namespace deeplearning
@@ -0,0 +1,115 @@
+#pragma once
+#include "span.h"
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace deeplearning {
+
+constexpr std::size_t kCacheLineSize = 64;
+
+// allocator keep every buffer start at cache line boundary
+template <typename T> class AlignedAllocator {
+public:
+  using value_type = T;
+  template <typename U> struct rebind {
+    using other = AlignedAllocator<U>;
+  };
+
+  AlignedAllocator() = default;
+  template <typename U> AlignedAllocator(const AlignedAllocator<U> &) {}
+
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(
+        ::operator new(n * sizeof(T), std::align_val_t(kCacheLineSize)));
+  }
+  void deallocate(T *ptr, std::size_t) {
+    ::operator delete(ptr, std::align_val_t(kCacheLineSize));
+  }
+
+  template <typename U> bool operator==(const AlignedAllocator<U> &) const {
+    return true;
+  }
+  template <typename U> bool operator!=(const AlignedAllocator<U> &) const {
+    return false;
+  }
+};
+
+template <typename T> using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// dense row-major matrix stored in one aligned buffer
+template <typename T> class Matrix {
+public:
+  Matrix() = default;
+  Matrix(int rows, int cols, T value = 0) { Resize(rows, cols, value); }
+
+  void Resize(int rows, int cols, T value = 0) {
+    rows_ = rows;
+    cols_ = cols;
+    data_.assign((std::size_t)rows * cols, value);
+  }
+  // change shape without clearing, kept value is unspecified
+  void Reshape(int rows, int cols) {
+    rows_ = rows;
+    cols_ = cols;
+    data_.resize((std::size_t)rows * cols);
+  }
+  void Fill(T value) { std::fill(data_.begin(), data_.end(), value); }
+
+  // copy from nested vector, return false if the shape is ragged
+  bool Assign(const std::vector<std::vector<T>> &value) {
+    int cols = value.empty() ? 0 : value[0].size();
+    for (auto &row : value) {
+      if (row.size() != cols) {
+        return false;
+      }
+    }
+    Resize(value.size(), cols);
+    for (int i = 0; i < rows_; i++) {
+      std::copy(value[i].begin(), value[i].end(), Row(i));
+    }
+    return true;
+  }
+  std::vector<std::vector<T>> ToVector() const {
+    std::vector<std::vector<T>> result(rows_);
+    for (int i = 0; i < rows_; i++) {
+      result[i].assign(Row(i), Row(i) + cols_);
+    }
+    return result;
+  }
+
+public:
+  inline int rows() const { return rows_; }
+  inline int cols() const { return cols_; }
+  inline int size() const { return data_.size(); }
+  inline bool empty() const { return data_.empty(); }
+  inline T *data() { return data_.data(); }
+  inline const T *data() const { return data_.data(); }
+  inline T *begin() { return data_.data(); }
+  inline T *end() { return data_.data() + data_.size(); }
+  inline const T *begin() const { return data_.data(); }
+  inline const T *end() const { return data_.data() + data_.size(); }
+
+  inline T *Row(int row) { return data_.data() + (std::size_t)row * cols_; }
+  inline const T *Row(int row) const {
+    return data_.data() + (std::size_t)row * cols_;
+  }
+  inline T &operator()(int row, int col) {
+    return data_[(std::size_t)row * cols_ + col];
+  }
+  inline const T &operator()(int row, int col) const {
+    return data_[(std::size_t)row * cols_ + col];
+  }
+  inline Span<T> operator[](int row) { return Span<T>(Row(row), cols_); }
+  inline Span<const T> operator[](int row) const {
+    return Span<const T>(Row(row), cols_);
+  }
+
+private:
+  int rows_ = 0;
+  int cols_ = 0;
+  AlignedVector<T> data_;
+};
+
+} // namespace deeplearning
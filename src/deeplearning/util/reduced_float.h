@@ -0,0 +1,124 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace deeplearning {
+
+// bit conversion between float and the 16 bit formats. bf16 is the high half
+// of a float, fp16 has 5 exponent and 10 mantissa bit. the encode take a
+// random 32 bit word, rounding up with probability equal to the dropped
+// fraction, so the rounding error is zero on average and a small update added
+// to a large value is not lost every time
+
+inline std::uint32_t FloatBits(float value) {
+  std::uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+inline float BitsFloat(std::uint32_t bits) {
+  float value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+inline float Bf16ToFloat(std::uint16_t value) {
+  return BitsFloat((std::uint32_t)value << 16);
+}
+
+inline std::uint16_t FloatToBf16(float value, std::uint32_t random) {
+  std::uint32_t bits = FloatBits(value);
+  if ((bits & 0x7f800000) == 0x7f800000) {
+    // inf keep, nan stay quiet after truncate
+    return (bits >> 16) | ((bits & 0xffff) ? 0x40 : 0);
+  }
+  // carry into the exponent is the correct rounding, up to inf at the top
+  return (bits + (random & 0xffff)) >> 16;
+}
+
+// round to nearest even, for the gemm operand where the error is one rounding
+inline std::uint16_t FloatToBf16(float value) {
+  std::uint32_t bits = FloatBits(value);
+  std::uint32_t rounded = (bits + 0x7fff + ((bits >> 16) & 1)) >> 16;
+  // select instead of branch so a packing loop can vectorize
+  std::uint32_t nan = (bits >> 16) | 0x40;
+  return (bits & 0x7fffffff) > 0x7f800000 ? nan : rounded;
+}
+
+inline float Fp16ToFloat(std::uint16_t value) {
+  std::uint32_t sign = (std::uint32_t)(value & 0x8000) << 16;
+  std::uint32_t exponent = (value >> 10) & 0x1f;
+  std::uint32_t mantissa = value & 0x3ff;
+  if (exponent == 0x1f) {
+    return BitsFloat(sign | 0x7f800000 | (mantissa << 13));
+  }
+  if (exponent == 0) {
+    // subnormal, mantissa * 2^-24
+    float result = std::ldexp((float)mantissa, -24);
+    return sign ? -result : result;
+  }
+  return BitsFloat(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+// out of range value saturate to the largest finite fp16 instead of inf,
+// an optimizer moment that overflow once would poison every later step
+inline std::uint16_t FloatToFp16(float value, std::uint32_t random) {
+  std::uint32_t bits = FloatBits(value);
+  std::uint16_t sign = (bits >> 16) & 0x8000;
+  std::uint32_t abs = bits & 0x7fffffff;
+  if (abs > 0x7f800000) {
+    return sign | 0x7e00;
+  }
+  // 65520 and above round to inf in ieee, clamp to 65504
+  if (abs >= 0x477ff000) {
+    return sign | 0x7bff;
+  }
+  if (abs < 0x38800000) {
+    // below 2^-14 the step is a fixed 2^-24
+    float scaled = std::ldexp(BitsFloat(abs), 24);
+    std::uint32_t floor = (std::uint32_t)scaled;
+    float fraction = scaled - floor;
+    floor += (random >> 8) * (1.0f / (1 << 24)) < fraction;
+    return sign | floor;
+  }
+  // rebias the exponent from 127 to 15 and round 13 dropped mantissa bit,
+  // carry from the mantissa move the exponent as it should
+  abs = abs - (112u << 23) + (random & 0x1fff);
+  std::uint32_t result = abs >> 13;
+  return sign | (result > 0x7bff ? 0x7bff : result);
+}
+
+inline float RoundToFloat(float value, std::uint32_t) { return value; }
+
+// double to the one of the two nearest float, chosen by the same rule
+inline float RoundToFloat(double value, std::uint32_t random) {
+  float lower = (float)value;
+  if (lower == value || !std::isfinite(lower)) {
+    return lower;
+  }
+  if (lower > value) {
+    lower = std::nextafter(lower, -INFINITY);
+  }
+  float upper = std::nextafter(lower, INFINITY);
+  double fraction = (value - lower) / ((double)upper - lower);
+  return (random >> 8) * (1.0 / (1 << 24)) < fraction ? upper : lower;
+}
+
+// xorshift32 for the rounding bit, cheap enough to call per element
+class RoundingRandom {
+public:
+  explicit RoundingRandom(std::uint32_t seed = 2463534242u)
+      : state_(seed ? seed : 1) {}
+  inline std::uint32_t Next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return state_;
+  }
+
+private:
+  std::uint32_t state_;
+};
+
+} // namespace deeplearning
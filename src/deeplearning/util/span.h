@@ -0,0 +1,39 @@
+#pragma once
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+namespace deeplearning {
+
+// non-owning view of a contiguous range, used for matrix rows and buffers
+template <typename T> class Span {
+public:
+  Span() = default;
+  Span(T *data, int size) : data_(data), size_(size) {}
+  template <typename Alloc>
+  Span(std::vector<typename std::remove_const<T>::type, Alloc> &vec)
+      : data_(vec.data()), size_(vec.size()) {}
+  template <typename Alloc, typename U = T,
+            typename = typename std::enable_if<std::is_const<U>::value>::type>
+  Span(const std::vector<typename std::remove_const<T>::type, Alloc> &vec)
+      : data_(vec.data()), size_(vec.size()) {}
+  template <typename U, typename = typename std::enable_if<
+                            std::is_convertible<U *, T *>::value>::type>
+  Span(const Span<U> &other) : data_(other.data()), size_(other.size()) {}
+
+  inline T &operator[](int pos) const { return data_[pos]; }
+  inline T *data() const { return data_; }
+  inline int size() const { return size_; }
+  inline bool empty() const { return size_ == 0; }
+  inline T *begin() const { return data_; }
+  inline T *end() const { return data_ + size_; }
+  inline Span<T> SubSpan(int offset, int size) const {
+    return Span<T>(data_ + offset, size);
+  }
+
+private:
+  T *data_ = nullptr;
+  int size_ = 0;
+};
+
+} // namespace deeplearning
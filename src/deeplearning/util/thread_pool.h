@@ -0,0 +1,231 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace deeplearning {
+
+// work stealing pool, every worker own a deque: it push and pop its own back
+// while idle worker steal from the front of the others. the thread wait in
+// ParallelFor also run task, so nested ParallelFor never deadlock
+class ThreadPool {
+public:
+  // env to size the global pool, total thread count include the caller
+  static constexpr const char *kThreadEnvName = "DEEPLEARNING_NUM_THREADS";
+
+  // thread_num count the caller thread too, 1 run everything inline
+  explicit ThreadPool(int thread_num, bool pin_affinity = false) {
+    thread_num_ = std::max(1, thread_num);
+    for (int i = 0; i < thread_num_; i++) {
+      queue_.emplace_back(new WorkQueue());
+    }
+    // queue 0 belong to the outside caller, worker i own queue i
+    for (int i = 1; i < thread_num_; i++) {
+      worker_.emplace_back([this, i, pin_affinity]() {
+        WorkerLoop(i, pin_affinity);
+      });
+    }
+  }
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      stop_ = true;
+    }
+    sleep_cv_.notify_all();
+    for (auto &worker : worker_) {
+      worker.join();
+    }
+  }
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // the process wide pool every part of the library use, it is created on
+  // first call and sized once: by Configure, else env, else core count
+  static ThreadPool &Global() {
+    static ThreadPool *pool = [] {
+      std::lock_guard<std::mutex> lock(ConfigMutex());
+      auto &config = GlobalConfig();
+      config.created_ = true;
+      int thread_num = config.thread_num_;
+      if (thread_num <= 0) {
+        const char *env = std::getenv(kThreadEnvName);
+        thread_num = env != nullptr ? std::atoi(env) : 0;
+      }
+      if (thread_num <= 0) {
+        thread_num = std::thread::hardware_concurrency();
+      }
+      // never destroyed, so no worker outlive it during static destruction
+      return new ThreadPool(thread_num, config.pin_affinity_);
+    }();
+    return *pool;
+  }
+
+  // size of the global pool, only work before its first use
+  static bool Configure(int thread_num, bool pin_affinity = false) {
+    std::lock_guard<std::mutex> lock(ConfigMutex());
+    auto &config = GlobalConfig();
+    if (config.created_ || thread_num <= 0) {
+      return false;
+    }
+    config.thread_num_ = thread_num;
+    config.pin_affinity_ = pin_affinity;
+    return true;
+  }
+
+  // func(chunk_begin, chunk_end) over [begin, end) cut in chunk of grain
+  // index, return after every chunk finish
+  void ParallelFor(int begin, int end, int grain,
+                   const std::function<void(int, int)> &func) {
+    if (begin >= end) {
+      return;
+    }
+    grain = std::max(1, grain);
+    int chunk_num = (end - begin + grain - 1) / grain;
+    if (chunk_num == 1 || thread_num_ == 1) {
+      func(begin, end);
+      return;
+    }
+    int self = CurrentWorker();
+    std::atomic<int> remain(chunk_num - 1);
+    for (int i = chunk_num - 1; i > 0; i--) {
+      int chunk_begin = begin + i * grain;
+      int chunk_end = std::min(end, chunk_begin + grain);
+      Push(self, [&func, &remain, chunk_begin, chunk_end]() {
+        func(chunk_begin, chunk_end);
+        remain--;
+      });
+    }
+    func(begin, std::min(end, begin + grain));
+    while (remain > 0) {
+      if (!RunOne(self)) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  inline int thread_num() const { return thread_num_; }
+
+private:
+  struct WorkQueue {
+    std::mutex mutex_;
+    std::deque<std::function<void()>> task_;
+  };
+  struct PoolConfig {
+    int thread_num_ = 0;
+    bool pin_affinity_ = false;
+    bool created_ = false;
+  };
+  struct WorkerSlot {
+    const ThreadPool *pool_ = nullptr;
+    int index_ = 0;
+  };
+
+  static PoolConfig &GlobalConfig() {
+    static PoolConfig config;
+    return config;
+  }
+  static std::mutex &ConfigMutex() {
+    static std::mutex mutex;
+    return mutex;
+  }
+  static WorkerSlot &CurrentSlot() {
+    thread_local WorkerSlot slot;
+    return slot;
+  }
+  // queue index of the calling thread, 0 if it is not a worker of this pool
+  int CurrentWorker() const {
+    auto &slot = CurrentSlot();
+    return slot.pool_ == this ? slot.index_ : 0;
+  }
+
+  // a worker keep its task local, the outside caller spread them
+  void Push(int self, std::function<void()> task) {
+    int index = self != 0 ? self : next_queue_++ % thread_num_;
+    {
+      std::lock_guard<std::mutex> lock(queue_[index]->mutex_);
+      queue_[index]->task_.push_back(std::move(task));
+    }
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex_);
+      pending_++;
+    }
+    sleep_cv_.notify_one();
+  }
+
+  // pop the back of the own queue, else steal the front of another
+  bool RunOne(int self) {
+    std::function<void()> task;
+    for (int i = 0; i < thread_num_ && !task; i++) {
+      auto &queue = *queue_[(self + i) % thread_num_];
+      std::lock_guard<std::mutex> lock(queue.mutex_);
+      if (queue.task_.empty()) {
+        continue;
+      }
+      if (i == 0) {
+        task = std::move(queue.task_.back());
+        queue.task_.pop_back();
+      } else {
+        task = std::move(queue.task_.front());
+        queue.task_.pop_front();
+      }
+    }
+    if (!task) {
+      return false;
+    }
+    pending_--;
+    task();
+    return true;
+  }
+
+  void WorkerLoop(int index, bool pin_affinity) {
+    CurrentSlot() = {this, index};
+    if (pin_affinity) {
+      PinToCore(index);
+    }
+    while (true) {
+      if (RunOne(index)) {
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleep_mutex_);
+      sleep_cv_.wait(lock, [this]() { return stop_ || pending_ > 0; });
+      if (stop_ && pending_ == 0) {
+        return;
+      }
+    }
+  }
+
+  // worker i run on core i, the caller keep core 0 to itself
+  static void PinToCore(int index) {
+#ifdef __linux__
+    int core_num = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(index % core_num, &cpu_set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+#endif
+  }
+
+private:
+  int thread_num_ = 1;
+  std::vector<std::unique_ptr<WorkQueue>> queue_;
+  std::vector<std::thread> worker_;
+  std::atomic<int> next_queue_{0};
+  std::atomic<int> pending_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable sleep_cv_;
+  bool stop_ = false;
+};
+
+} // namespace deeplearning
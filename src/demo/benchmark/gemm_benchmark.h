@@ -0,0 +1,59 @@
+#pragma once
+#include "kernel/gemm.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace benchmark {
+
+// gflops of the float gemm against the bf16 one on the training shape of a
+// 784-512-10 network with batch 256: forward, hidden delta and weight grad
+inline void GemmBenchmark() {
+  using namespace deeplearning::kernel;
+  auto &table = GetKernelTable<float>();
+  std::cout << "isa: " << CpuFeature::IsaName(table.isa_) << ", bf16: "
+            << (table.native_bf16_ ? "native" : "emulated") << std::endl;
+  struct Shape {
+    const char *name_;
+    bool trans_a_, trans_b_;
+    int m_, n_, k_;
+  };
+  std::vector<Shape> shapes = {{"forward", false, true, 256, 512, 784},
+                               {"delta", false, false, 256, 784, 512},
+                               {"weight grad", true, false, 512, 784, 256}};
+  std::mt19937 gen(1);
+  std::uniform_real_distribution<float> distr(-1, 1);
+  for (auto &shape : shapes) {
+    std::vector<float> a((std::size_t)shape.m_ * shape.k_),
+        b((std::size_t)shape.k_ * shape.n_), c((std::size_t)shape.m_ * shape.n_);
+    for (auto &value : a) {
+      value = distr(gen);
+    }
+    for (auto &value : b) {
+      value = distr(gen);
+    }
+    int lda = shape.trans_a_ ? shape.m_ : shape.k_;
+    int ldb = shape.trans_b_ ? shape.k_ : shape.n_;
+    for (auto gemm : {table.gemm_, table.gemm_bf16_}) {
+      const int repeat = 20;
+      gemm(shape.trans_a_, shape.trans_b_, shape.m_, shape.n_, shape.k_, 1,
+           a.data(), lda, b.data(), ldb, 0, c.data(), shape.n_);
+      auto begin = std::chrono::steady_clock::now();
+      for (int i = 0; i < repeat; i++) {
+        gemm(shape.trans_a_, shape.trans_b_, shape.m_, shape.n_, shape.k_, 1,
+             a.data(), lda, b.data(), ldb, 0, c.data(), shape.n_);
+      }
+      auto end = std::chrono::steady_clock::now();
+      double second = std::chrono::duration<double>(end - begin).count();
+      double gflops =
+          2.0 * shape.m_ * shape.n_ * shape.k_ * repeat / second / 1e9;
+      std::cout << shape.name_ << (gemm == table.gemm_ ? " float" : " bf16")
+                << ": " << std::fixed << std::setprecision(2) << gflops
+                << " gflops" << std::endl;
+    }
+  }
+}
+
+} // namespace benchmark
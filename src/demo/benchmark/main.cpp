@@ -0,0 +1,30 @@
+#include "gemm_benchmark.h"
+#include "math_benchmark.h"
+#include "quantize_benchmark.h"
+#include "train_benchmark.h"
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+
+using namespace std;
+
+// usage: benchmark [name], run every benchmark without name
+int main(int argc, char **argv) {
+  map<string, function<void()>> benchmark_list = {
+      {"gemm", benchmark::GemmBenchmark},
+      {"math", benchmark::MathBenchmark},
+      {"quantize", benchmark::QuantizeBenchmark},
+      {"sparse", benchmark::SparseBenchmark},
+      {"stream", benchmark::StreamBenchmark},
+      {"train", benchmark::TrainBenchmark},
+  };
+  for (auto &[name, func] : benchmark_list) {
+    if (argc >= 2 && name != argv[1]) {
+      continue;
+    }
+    cout << "==== " << name << " ====" << endl;
+    func();
+  }
+  return 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "kernel/dispatch.h"
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+
+// nanosecond per element of func(size, input, output), best of repeat
+template <typename T, typename Func>
+double NanoPerElement(Func func, const std::vector<T> &input,
+                      std::vector<T> &output) {
+  const int repeat = 50;
+  double best = 1e30;
+  for (int i = 0; i < repeat; i++) {
+    auto begin = std::chrono::steady_clock::now();
+    func(input.size(), input.data(), output.data());
+    auto end = std::chrono::steady_clock::now();
+    best = std::min(best,
+                    std::chrono::duration<double, std::nano>(end - begin)
+                        .count());
+  }
+  return best / input.size();
+}
+
+template <typename T> void RunMathBenchmark(const std::string &type_name) {
+  using namespace deeplearning;
+  using namespace deeplearning::kernel;
+  const int size = 1 << 16;
+  std::vector<T> input(size), output(size);
+  for (int i = 0; i < size; i++) {
+    input[i] = -10 + 20.0 * i / size;
+  }
+
+  auto libm_exp = [](int n, const T *in, T *out) {
+    for (int i = 0; i < n; i++) {
+      out[i] = std::exp(in[i]);
+    }
+  };
+  std::cout << type_name << " libm exp: " << std::setprecision(3)
+            << NanoPerElement<T>(libm_exp, input, output) << " ns"
+            << std::endl;
+
+  const char *accuracy_name[] = {"exact", "high", "fast"};
+  for (int i = CPU_ISA_SCALAR; i <= CpuFeature::DetectIsa(); i++) {
+    auto table = CreateKernelTable<T>((CpuIsa)i);
+    for (int accuracy = 0; accuracy < kMathAccuracyNum; accuracy++) {
+      std::cout << type_name << " " << CpuFeature::IsaName((CpuIsa)i) << " "
+                << accuracy_name[accuracy] << " exp: "
+                << NanoPerElement<T>(table.exp_[accuracy], input, output)
+                << " ns, sigmoid: "
+                << NanoPerElement<T>(table.sigmoid_[accuracy], input, output)
+                << " ns, tanh: "
+                << NanoPerElement<T>(table.tanh_[accuracy], input, output)
+                << " ns" << std::endl;
+    }
+  }
+}
+
+// per element cost of exp/sigmoid/tanh for every isa and accuracy tier
+inline void MathBenchmark() {
+  RunMathBenchmark<double>("double");
+  RunMathBenchmark<float>("float");
+}
+
+} // namespace benchmark
@@ -0,0 +1,93 @@
+#pragma once
+#include "neural_network.h"
+#include "quantized_network.h"
+#include "train_benchmark.h"
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace benchmark {
+
+// single sample predict of a float 784-256-10 network against its int8
+// quantized form, with model size and the accuracy delta on held out data
+inline void QuantizeBenchmark() {
+  using namespace deeplearning;
+  std::vector<std::vector<double>> data, target, test, test_target;
+  CreateSparseData(6000, data, target, 1);
+  CreateSparseData(2000, test, test_target, 2);
+  std::vector<std::vector<float>> float_data, float_test;
+  for (auto &sample : data) {
+    float_data.emplace_back(sample.begin(), sample.end());
+  }
+  for (auto &sample : test) {
+    float_test.emplace_back(sample.begin(), sample.end());
+  }
+  std::vector<std::vector<float>> float_target, float_test_target;
+  for (auto &sample : target) {
+    float_target.emplace_back(sample.begin(), sample.end());
+  }
+  for (auto &sample : test_target) {
+    float_test_target.emplace_back(sample.begin(), sample.end());
+  }
+
+  FloatNeuralNetwork network(std::vector<int>{784, 256, 10});
+  network.set_param_init_function(ParamInitType::PARAM_INIT_XAVIER);
+  network.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  network.set_loss_function(LossType::LOSS_CROSS_ENTROPY);
+  network.Train(float_data, float_target, nullptr, 1000, 32, 0.1);
+  FloatNeuralNetwork::NetworkParam param;
+  FloatNeuralNetwork::NetworkOption option;
+  network.ExportNetworkParam(param, option);
+  std::vector<std::vector<float>> calibration(float_data.begin(),
+                                              float_data.begin() + 500);
+  FloatQuantizedNetwork quantized;
+  if (quantized.Quantize(param, option, calibration) !=
+      FloatQuantizedNetwork::SUCCESS) {
+    std::cout << "quantize failed: " << quantized.err_msg() << std::endl;
+    return;
+  }
+
+  auto &table = kernel::GetKernelTable<float>();
+  std::cout << "isa: " << kernel::CpuFeature::IsaName(table.isa_)
+            << ", int8: " << (table.vnni_ ? "vnni" : "maddubs") << std::endl;
+  std::size_t weight_num = 784 * 256 + 256 * 10, neuron_num = 256 + 10;
+  std::cout << "model size float: " << (weight_num + neuron_num) * 4
+            << " int8: " << weight_num + neuron_num * 8 << " byte"
+            << std::endl;
+
+  auto time = [&](auto &&predict) {
+    const int repeat = 5;
+    std::vector<float> result;
+    auto begin = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; r++) {
+      for (auto &sample : float_test) {
+        predict(sample, result);
+      }
+    }
+    auto end = std::chrono::steady_clock::now();
+    double second = std::chrono::duration<double>(end - begin).count();
+    return repeat * float_test.size() / second;
+  };
+  double float_rate = time([&](const std::vector<float> &sample,
+                               std::vector<float> &result) {
+    network.Predict(sample, result);
+  });
+  double int8_rate = time([&](const std::vector<float> &sample,
+                              std::vector<float> &result) {
+    quantized.Predict(sample, result);
+  });
+  std::cout << std::fixed << std::setprecision(0)
+            << "predict float: " << float_rate << " sample/s int8: "
+            << int8_rate << " sample/s" << std::endl;
+
+  FloatNeuralNetwork::EvaluateResult float_result, int8_result;
+  network.Evaluate(float_test, float_test_target, float_result);
+  quantized.Evaluate(float_test, float_test_target, int8_result);
+  std::cout << std::setprecision(4)
+            << "accuracy float: " << float_result.accuracy_
+            << " int8: " << int8_result.accuracy_ << " delta: "
+            << int8_result.accuracy_ - float_result.accuracy_ << std::endl;
+}
+
+} // namespace benchmark
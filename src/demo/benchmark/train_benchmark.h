@@ -0,0 +1,215 @@
+#pragma once
+#include "neural_network.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+
+// binarized mnist like data, every class is a random 0/1 prototype and a
+// sample flip some pixel of it
+inline void CreateSparseData(int size, std::vector<std::vector<double>> &data,
+                             std::vector<std::vector<double>> &target,
+                             int seed) {
+  const int input_size = 784, class_num = 10;
+  std::mt19937 proto_gen(1), gen(seed);
+  std::bernoulli_distribution proto_distr(0.15), flip_distr(0.05);
+  std::vector<std::vector<double>> prototype(class_num,
+                                             std::vector<double>(input_size));
+  for (auto &proto : prototype) {
+    for (auto &pixel : proto) {
+      pixel = proto_distr(proto_gen);
+    }
+  }
+  data.assign(size, std::vector<double>(input_size));
+  target.assign(size, std::vector<double>(class_num, 0));
+  for (int i = 0; i < size; i++) {
+    int label = i % class_num;
+    for (int j = 0; j < input_size; j++) {
+      data[i][j] = flip_distr(gen) ? 1 - prototype[label][j]
+                                   : prototype[label][j];
+    }
+    target[i][label] = 1;
+  }
+}
+
+// train in chunk of the same sample count and print the test loss against
+// the wall clock time spent in Train, evaluation is not timed
+inline void RunTrainMode(const std::string &name,
+                         const deeplearning::NeuralNetwork &init,
+                         deeplearning::NeuralNetwork::TrainMode mode,
+                         int num_threads, int batch_num, int chunk_step,
+                         const std::vector<std::vector<double>> &data,
+                         const std::vector<std::vector<double>> &target,
+                         const std::vector<std::vector<double>> &test,
+                         const std::vector<std::vector<double>> &test_target) {
+  using namespace deeplearning;
+  NeuralNetwork network;
+  network.Clone(init);
+  network.set_train_mode(mode);
+  double train_second = 0;
+  for (int chunk = 0; chunk < 8; chunk++) {
+    auto begin = std::chrono::steady_clock::now();
+    auto rc = network.Train(data, target, nullptr, chunk_step, batch_num, 0.1,
+                            num_threads);
+    auto end = std::chrono::steady_clock::now();
+    if (rc != NeuralNetwork::SUCCESS) {
+      std::cout << name << " train failed: " << network.err_msg()
+                << std::endl;
+      return;
+    }
+    train_second += std::chrono::duration<double>(end - begin).count();
+    double loss = 0;
+    network.CalcLoss(test, test_target, loss);
+    std::cout << name << " " << std::fixed << std::setprecision(3)
+              << train_second << " s, test loss: " << std::setprecision(5)
+              << loss << std::endl;
+  }
+}
+
+// sync split a batch of 8 * thread between threads, async let every thread
+// step alone with a batch of 8, so both consume the same sample per chunk
+inline void TrainBenchmark() {
+  using namespace deeplearning;
+  std::vector<std::vector<double>> data, target, test, test_target;
+  CreateSparseData(20000, data, target, 2);
+  CreateSparseData(1000, test, test_target, 3);
+  int num_threads = std::min(8, ThreadPool::Global().thread_num());
+  NeuralNetwork init(std::vector<int>{784, 64, 10});
+  init.set_param_init_function(ParamInitType::PARAM_INIT_XAVIER);
+  init.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  init.set_loss_function(LossType::LOSS_CROSS_ENTROPY);
+
+  const int batch_num = 8, chunk_step = 200;
+  std::cout << "threads: " << num_threads << std::endl;
+  RunTrainMode("sync", init, NeuralNetwork::TRAIN_MODE_SYNC, num_threads,
+               batch_num * num_threads, chunk_step, data, target, test,
+               test_target);
+  RunTrainMode("async", init, NeuralNetwork::TRAIN_MODE_ASYNC, num_threads,
+               batch_num, chunk_step * num_threads, data, target, test,
+               test_target);
+}
+
+// hashed bag of feature like input, 2048 binary feature and 24 set per
+// sample: 20 from the 100 feature of its class and 4 noise
+inline void CreateFeatureData(int size,
+                              std::vector<std::vector<double>> &data,
+                              std::vector<std::vector<double>> &target,
+                              int seed) {
+  const int input_size = 2048, class_num = 10;
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int> class_distr(0, 99),
+      noise_distr(0, input_size - 1);
+  data.assign(size, std::vector<double>(input_size, 0));
+  target.assign(size, std::vector<double>(class_num, 0));
+  for (int i = 0; i < size; i++) {
+    int label = i % class_num;
+    for (int j = 0; j < 20; j++) {
+      // class feature spread over the whole input by a fixed stride
+      data[i][(label * 100 + class_distr(gen)) * 2 % input_size] = 1;
+    }
+    for (int j = 0; j < 4; j++) {
+      data[i][noise_distr(gen)] = 1;
+    }
+    target[i][label] = 1;
+  }
+}
+
+// dense against sparse first layer on the same step count, the sparse one
+// only multiply the feature column present in each batch
+inline void SparseBenchmark() {
+  using namespace deeplearning;
+  std::vector<std::vector<double>> data, target, test, test_target;
+  CreateFeatureData(20000, data, target, 2);
+  CreateFeatureData(1000, test, test_target, 3);
+  NeuralNetwork init(std::vector<int>{2048, 128, 10});
+  init.set_param_init_function(ParamInitType::PARAM_INIT_XAVIER);
+  init.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  init.set_loss_function(LossType::LOSS_CROSS_ENTROPY);
+  for (bool sparse : {false, true}) {
+    NeuralNetwork network;
+    network.Clone(init);
+    network.set_sparse_input(sparse);
+    auto begin = std::chrono::steady_clock::now();
+    auto rc = network.Train(data, target, nullptr, 1000, 16, 0.1);
+    auto end = std::chrono::steady_clock::now();
+    if (rc != NeuralNetwork::SUCCESS) {
+      std::cout << "train failed: " << network.err_msg() << std::endl;
+      return;
+    }
+    NeuralNetwork::EvaluateResult result;
+    network.Evaluate(test, test_target, result);
+    std::cout << (sparse ? "sparse" : "dense") << " " << std::fixed
+              << std::setprecision(3)
+              << std::chrono::duration<double>(end - begin).count()
+              << " s, test accuracy: " << result.accuracy_ << std::endl;
+  }
+}
+
+// one pass over an in memory dataset against the same pass streamed from a
+// record file, and the raw decode speed of the stream without training
+inline void StreamBenchmark() {
+  using namespace deeplearning;
+  const std::string file_path = "stream_benchmark.record";
+  const int batch_num = 32;
+  std::vector<std::vector<double>> data, target;
+  CreateSparseData(20000, data, target, 2);
+  Dataset dataset;
+  dataset.Assign(data, target, Dataset::FORMAT_UINT8);
+  data.clear();
+  target.clear();
+  if (RecordWriter::Write(dataset, file_path) != RecordWriter::SUCCESS) {
+    std::cout << "write record file failed" << std::endl;
+    return;
+  }
+  RecordFileSource<double> source;
+  if (source.Open(file_path) != RecordFileSource<double>::SUCCESS) {
+    std::cout << "open failed: " << source.err_msg() << std::endl;
+    remove(file_path.c_str());
+    return;
+  }
+
+  Matrix<double> batch(batch_num, dataset.sample_size());
+  Matrix<double> batch_target(batch_num, dataset.class_num());
+  auto begin = std::chrono::steady_clock::now();
+  while (source.NextBatch(batch_num, batch.data(), batch_target.data()) > 0) {
+  }
+  auto end = std::chrono::steady_clock::now();
+  double seconds = std::chrono::duration<double>(end - begin).count();
+  std::cout << "stream read " << std::fixed << std::setprecision(1)
+            << dataset.size() * (dataset.sample_size() + 1.0) / seconds / 1e6
+            << " MB/s" << std::endl;
+
+  NeuralNetwork init(std::vector<int>{784, 128, 10});
+  init.set_param_init_function(ParamInitType::PARAM_INIT_XAVIER);
+  init.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  init.set_loss_function(LossType::LOSS_CROSS_ENTROPY);
+  for (bool stream : {false, true}) {
+    NeuralNetwork network;
+    network.Clone(init);
+    begin = std::chrono::steady_clock::now();
+    auto rc = stream ? network.Train(source, nullptr, 0, batch_num, 0.1)
+                     : network.Train(dataset, nullptr,
+                                     dataset.size() / batch_num, batch_num,
+                                     0.1);
+    end = std::chrono::steady_clock::now();
+    if (rc != NeuralNetwork::SUCCESS) {
+      std::cout << "train failed: " << network.err_msg() << std::endl;
+      break;
+    }
+    NeuralNetwork::EvaluateResult result;
+    network.Evaluate(dataset, result);
+    std::cout << (stream ? "stream" : "dataset") << " " << std::fixed
+              << std::setprecision(3)
+              << std::chrono::duration<double>(end - begin).count()
+              << " s, train accuracy: " << result.accuracy_ << std::endl;
+  }
+  remove(file_path.c_str());
+}
+
+} // namespace benchmark
@@ -26,9 +26,10 @@ int main() {
   }
   // print all size of data
   cout << "train_data size: " << mnist_data.train_data().size() << endl;
-  cout << "train_labels size: " << mnist_data.train_labels().size() << endl;
   cout << "test_data size: " << mnist_data.test_data().size() << endl;
-  cout << "test_labels size: " << mnist_data.test_labels().size() << endl;
+  cout << "mapped data byte: "
+       << mnist_data.train_data().bytes() + mnist_data.test_data().bytes()
+       << endl;
 
   // step 2 create network
   NeuralNetwork demo_network;
@@ -73,45 +74,38 @@ int main() {
   }
 
   cout << "Init success begin train" << endl;
-  vector<vector<double>> train_target(mnist_data.train_data().size(),
-                                      vector<double>(10, 0));
-  for (int i = 0; i < mnist_data.train_labels().size(); i++) {
-    train_target[i][int(mnist_data.train_labels()[i])] = 1;
-  }
-  vector<vector<double>> test_target(mnist_data.test_data().size(),
-                                     vector<double>(10, 0));
-  for (int i = 0; i < mnist_data.test_labels().size(); i++) {
-    test_target[i][int(mnist_data.test_labels()[i])] = 1.0;
-  }
 
   // step 3 train data
   vector<double> train_loss_y, test_loss_y, train_loss_x, test_loss_x;
   auto print_func = [&](NeuralNetwork &network, int epoch_num, bool &) {
     static int count = 0;
     if (count++ % 10000 == 0) {
-      double train_loss = 0;
-      rc = network.CalcLoss(mnist_data.train_data(), train_target, train_loss);
+      NeuralNetwork::EvaluateResult train_result, test_result;
+      rc = network.Evaluate(mnist_data.train_data(), train_result);
       if (rc != NeuralNetwork::SUCCESS) {
-        cout << "CalcLoss failed: " << demo_network.err_msg() << endl;
+        cout << "Evaluate failed: " << demo_network.err_msg() << endl;
         return;
       }
-      double test_loss = 0;
-      rc = network.CalcLoss(mnist_data.test_data(), test_target, test_loss);
+      rc = network.Evaluate(mnist_data.test_data(), test_result);
       if (rc != NeuralNetwork::SUCCESS) {
-        cout << "CalcLoss failed: " << demo_network.err_msg() << endl;
+        cout << "Evaluate failed: " << demo_network.err_msg() << endl;
         return;
       }
+      double train_loss = train_result.loss_, test_loss = test_result.loss_;
       train_loss_y.push_back(train_loss);
       test_loss_y.push_back(test_loss);
       train_loss_x.push_back(epoch_num);
       test_loss_x.push_back(epoch_num);
       std::cout << "epoch: " << epoch_num << " train_loss: " << train_loss
-                << " test_loss: " << test_loss << std::endl;
+                << " test_loss: " << test_loss
+                << " test_accuracy: " << test_result.accuracy_ << std::endl;
     }
   };
 
   // demo_network.set_optimizer_function(OptimizerType::OPTIMIZER_MOMENTUM);
-  rc = demo_network.Train(mnist_data.train_data(), train_target, print_func,
+  // binarized pixel, most of the 784 input are zero
+  demo_network.set_sparse_input(true);
+  rc = demo_network.Train(mnist_data.train_data(), print_func,
                           1.5 * mnist_data.train_data().size(), 1, 0.2);
   if (rc != NeuralNetwork::SUCCESS) {
     cout << "Train failed: " << demo_network.err_msg() << endl;
@@ -126,7 +120,7 @@ int main() {
 
   for (int i = 0; i < test_date_size; i++) {
     vector<double> result(10, 0);
-    rc = demo_network.Predict(mnist_data.test_data()[i], result);
+    rc = demo_network.Predict(mnist_data.test_data(), i, result);
 
     if (rc != NeuralNetwork::SUCCESS) {
       cout << "Predict failed: " << demo_network.err_msg() << endl;
@@ -140,13 +134,15 @@ int main() {
         max_index = j;
       }
     }
-    if (max_index == mnist_data.test_labels()[i]) {
+    int label = mnist_data.test_data().label(i);
+    if (max_index == label) {
       right_count++;
     } else {
       if (save_error_data) {
+        vector<double> image(mnist_data.test_data().sample_size());
+        mnist_data.test_data().LoadSample(i, image.data());
         test_error_data.push_back(
-            make_pair(mnist_data.test_data()[i],
-                      make_pair(mnist_data.test_labels()[i], max_index)));
+            make_pair(image, make_pair(label, max_index)));
       }
     }
   }
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "activate/activate_factory.h"
+#include "test.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace activate_test {
+
+// max gap of the bulk call against the per element call, input cover the
+// simd body, the tail and the saturate range
+template <typename T> double MaxBulkError(deeplearning::ActivateType type) {
+  auto activate = deeplearning::ActivateFactory::Create<T>(type);
+  std::mt19937 gen(5);
+  std::uniform_real_distribution<double> distr(-30, 30);
+  std::vector<T> input(45), output(45), delta(45), expect_delta(45);
+  for (int i = 0; i < input.size(); i++) {
+    input[i] = distr(gen);
+    delta[i] = expect_delta[i] = distr(gen);
+  }
+  activate->Activate(input, output);
+  double max_error = 0;
+  for (int i = 0; i < input.size(); i++) {
+    T expect = activate->Activate(input[i]);
+    max_error = std::max<double>(max_error, std::fabs(output[i] - expect));
+    expect_delta[i] *= activate->DerivActivate(output[i]);
+  }
+  activate->DerivActivate(output, delta);
+  for (int i = 0; i < input.size(); i++) {
+    max_error =
+        std::max<double>(max_error, std::fabs(delta[i] - expect_delta[i]));
+  }
+  return max_error;
+}
+
+} // namespace activate_test
+
+TEST(ActivateFunction, Bulk) {
+  using namespace deeplearning;
+  for (auto type : {ACTIVATE_SIGMOID, ACTIVATE_RELU, ACTIVATE_TANH}) {
+    double error = activate_test::MaxBulkError<double>(type);
+    DEBUG("activate " << type << " double bulk error: " << error);
+    MUST_TRUE(error < 1e-12, "double bulk activate mismatch");
+    error = activate_test::MaxBulkError<float>(type);
+    DEBUG("activate " << type << " float bulk error: " << error);
+    MUST_TRUE(error < 1e-5, "float bulk activate mismatch");
+  }
+}
+
+TEST(ActivateFunction, MathAccuracy) {
+  using namespace deeplearning;
+  std::vector<double> input(64), output(64);
+  for (int i = 0; i < input.size(); i++) {
+    input[i] = -8 + 0.25 * i;
+  }
+  auto activate = ActivateFactory::Create<double>(ACTIVATE_TANH);
+  activate->set_math_accuracy(MATH_ACCURACY_FAST);
+  MUST_EQUAL(activate->math_accuracy(), MATH_ACCURACY_FAST);
+  activate->Activate(input, output);
+  double max_error = 0;
+  for (int i = 0; i < input.size(); i++) {
+    max_error = std::max(max_error, std::fabs(output[i] - std::tanh(input[i])));
+  }
+  DEBUG("fast tanh error: " << max_error);
+  MUST_TRUE(max_error < 1e-4, "fast tanh error too large");
+}
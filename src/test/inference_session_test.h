@@ -0,0 +1,70 @@
+#pragma once
+
+#include "inference_session.h"
+#include "neural_network.h"
+#include "test.h"
+
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+TEST(InferenceSession, SharedNetwork) {
+  using namespace deeplearning;
+  NeuralNetwork network(std::vector<int>{4, 16, 8, 3});
+  auto rc = network.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  MUST_EQUAL(rc, NeuralNetwork::SUCCESS);
+
+  const int sample_num = 200;
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> distr(-1, 1);
+  std::vector<std::vector<double>> data(sample_num, std::vector<double>(4));
+  for (auto &sample : data) {
+    for (auto &value : sample) {
+      value = distr(gen);
+    }
+  }
+  std::vector<std::vector<double>> expect(sample_num);
+  for (int i = 0; i < sample_num; i++) {
+    rc = network.Predict(data[i], expect[i]);
+    MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+  }
+
+  // every thread predict all samples with its own session
+  const int thread_num = 4;
+  const NeuralNetwork &shared = network;
+  std::vector<std::vector<std::vector<double>>> result(thread_num);
+  std::vector<int> fail_count(thread_num, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_num; t++) {
+    threads.emplace_back([&, t]() {
+      InferenceSession session(shared);
+      result[t].resize(sample_num);
+      for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < sample_num; i++) {
+          if (session.Predict(data[i], result[t][i]) !=
+              NeuralNetwork::SUCCESS) {
+            fail_count[t]++;
+          }
+        }
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (int t = 0; t < thread_num; t++) {
+    MUST_EQUAL(fail_count[t], 0);
+    for (int i = 0; i < sample_num; i++) {
+      for (int j = 0; j < expect[i].size(); j++) {
+        MUST_TRUE(result[t][i][j] == expect[i][j], "thread result mismatch");
+      }
+    }
+  }
+
+  InferenceSession session(shared);
+  std::vector<double> out;
+  MUST_EQUAL(session.Predict(std::vector<double>(3), out),
+             NeuralNetwork::INVALID_DATA);
+  MUST_TRUE(!session.err_msg().empty(), "empty err msg");
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "kernel/dispatch.h"
+#include "test.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+TEST(KernelDispatch, ParseIsa) {
+  using namespace deeplearning::kernel;
+  CpuIsa isa = CPU_ISA_SCALAR;
+  MUST_TRUE(CpuFeature::ParseIsa("avx2", isa), "parse avx2 failed");
+  MUST_EQUAL(isa, CPU_ISA_AVX2);
+  MUST_TRUE(!CpuFeature::ParseIsa("neon", isa), "parse unknown isa");
+  MUST_TRUE(!CpuFeature::ParseIsa(nullptr, isa), "parse nullptr");
+  MUST_EQUAL(isa, CPU_ISA_AVX2);
+  MUST_TRUE(CpuFeature::ActiveIsa() <= CpuFeature::DetectIsa(),
+            "active isa higher than cpu support");
+  DEBUG("detect isa: " << CpuFeature::IsaName(CpuFeature::DetectIsa())
+                       << " active isa: "
+                       << CpuFeature::IsaName(CpuFeature::ActiveIsa()));
+}
+
+TEST(KernelDispatch, Elementwise) {
+  using namespace deeplearning::kernel;
+  const int size = 37;
+  std::mt19937 gen(3);
+  std::uniform_real_distribution<double> distr(-1, 1);
+  std::vector<double> input(size), grad(size), origin(size);
+  for (int i = 0; i < size; i++) {
+    input[i] = distr(gen);
+    grad[i] = distr(gen);
+    origin[i] = distr(gen);
+  }
+
+  // run every elementwise kernel and join the result to one vector
+  auto run = [&](const KernelTable<double> &table) {
+    std::vector<double> result, buffer(size), velocity(size, 0.5);
+    table.relu_(size, input.data(), buffer.data());
+    result.insert(result.end(), buffer.begin(), buffer.end());
+    for (auto activate : {table.sigmoid_[deeplearning::MATH_ACCURACY_EXACT],
+                          table.tanh_[deeplearning::MATH_ACCURACY_EXACT]}) {
+      for (double scale : {1.0, 40.0}) {
+        std::vector<double> scaled = input;
+        for (auto &value : scaled) {
+          value *= scale;
+        }
+        activate(size, scaled.data(), buffer.data());
+        result.insert(result.end(), buffer.begin(), buffer.end());
+      }
+    }
+    for (auto deriv : {table.relu_deriv_, table.sigmoid_deriv_,
+                       table.tanh_deriv_}) {
+      buffer = grad;
+      deriv(size, input.data(), buffer.data());
+      result.insert(result.end(), buffer.begin(), buffer.end());
+    }
+    buffer = origin;
+    table.sgd_update_(size, 0.1, grad.data(), buffer.data());
+    result.insert(result.end(), buffer.begin(), buffer.end());
+    buffer = origin;
+    table.momentum_update_(size, 0.1, 0.9, grad.data(), velocity.data(),
+                           buffer.data());
+    result.insert(result.end(), buffer.begin(), buffer.end());
+    result.insert(result.end(), velocity.begin(), velocity.end());
+    // adam then rmsprop, moment2 must stay positive
+    AdaptiveParam<double> param = {0.5, 0.9, 0.999, 0.01, 3.0, 1e-8, 0.001};
+    std::vector<double> moment1 = grad, moment2(size, 0.2);
+    buffer = origin;
+    table.adam_update_(size, param, grad.data(), moment1.data(),
+                       moment2.data(), buffer.data());
+    table.rmsprop_update_(size, param, grad.data(), moment2.data(),
+                          buffer.data());
+    result.insert(result.end(), buffer.begin(), buffer.end());
+    result.insert(result.end(), moment1.begin(), moment1.end());
+    result.insert(result.end(), moment2.begin(), moment2.end());
+    return result;
+  };
+
+  auto expect = run(CreateKernelTable<double>(CPU_ISA_SCALAR));
+  for (int i = CPU_ISA_SSE42; i <= CpuFeature::DetectIsa(); i++) {
+    auto result = run(CreateKernelTable<double>((CpuIsa)i));
+    double max_error = 0;
+    for (int j = 0; j < expect.size(); j++) {
+      max_error = std::max(max_error, std::fabs(result[j] - expect[j]));
+    }
+    DEBUG(CpuFeature::IsaName((CpuIsa)i) << " elementwise error: "
+                                          << max_error);
+    MUST_TRUE(max_error < 1e-12, "elementwise kernel mismatch");
+  }
+}
@@ -0,0 +1,228 @@
+#pragma once
+
+#include "kernel/gemm.h"
+#include "test.h"
+#include <cmath>
+#include <functional>
+#include <random>
+#include <vector>
+
+namespace gemm_test {
+
+template <typename T>
+using GemmFunc = std::function<void(bool, bool, int, int, int, T, const T *,
+                                    int, const T *, int, T, T *, int)>;
+
+template <typename T>
+using GemvFunc =
+    std::function<void(bool, int, int, T, const T *, int, const T *, T, T *)>;
+
+// compare gemm with naive triple loop on shape cross block and tile edge,
+// round_bf16 make the reference use a and b rounded as the bf16 gemm does
+template <typename T>
+double MaxGemmError(const GemmFunc<T> &gemm, bool round_bf16 = false) {
+  using deeplearning::Bf16ToFloat;
+  using deeplearning::FloatToBf16;
+  auto round = [&](T value) -> double {
+    return round_bf16 ? Bf16ToFloat(FloatToBf16(value)) : value;
+  };
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> distr(-1, 1);
+  std::vector<std::vector<int>> shapes = {
+      {1, 1, 1}, {7, 5, 3}, {13, 17, 29}, {130, 9, 300}, {6, 8, 257}};
+  double max_error = 0;
+  for (auto &shape : shapes) {
+    int m = shape[0], n = shape[1], k = shape[2];
+    for (int trans = 0; trans < 4; trans++) {
+      bool trans_a = trans & 1, trans_b = trans & 2;
+      std::vector<T> a(m * k), b(k * n), c(m * n), expect(m * n);
+      for (auto &value : a) {
+        value = distr(gen);
+      }
+      for (auto &value : b) {
+        value = distr(gen);
+      }
+      for (auto &value : c) {
+        value = distr(gen);
+      }
+      for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) {
+          double sum = 0;
+          for (int p = 0; p < k; p++) {
+            sum += round(trans_a ? a[p * m + i] : a[i * k + p]) *
+                   round(trans_b ? b[j * k + p] : b[p * n + j]);
+          }
+          expect[i * n + j] = 0.5 * sum + 2 * c[i * n + j];
+        }
+      }
+      gemm(trans_a, trans_b, m, n, k, 0.5, a.data(), trans_a ? m : k,
+           b.data(), trans_b ? k : n, 2, c.data(), n);
+      for (int i = 0; i < m * n; i++) {
+        max_error = std::max<double>(max_error, std::fabs(c[i] - expect[i]));
+      }
+    }
+  }
+  return max_error;
+}
+
+template <typename T> double MaxGemvError(const GemvFunc<T> &gemv) {
+  std::mt19937 gen(11);
+  std::uniform_real_distribution<double> distr(-1, 1);
+  double max_error = 0;
+  for (int m : {1, 5, 33}) {
+    for (int k : {1, 6, 67}) {
+      for (bool trans : {false, true}) {
+        int x_size = trans ? m : k, y_size = trans ? k : m;
+        std::vector<T> a(m * k), x(x_size), y(y_size), expect(y_size);
+        for (auto &value : a) {
+          value = distr(gen);
+        }
+        for (auto &value : x) {
+          value = distr(gen);
+        }
+        for (auto &value : y) {
+          value = distr(gen);
+        }
+        for (int i = 0; i < y_size; i++) {
+          double sum = 0;
+          for (int p = 0; p < x_size; p++) {
+            sum += (trans ? a[p * k + i] : a[i * k + p]) * x[p];
+          }
+          expect[i] = 2 * sum - y[i];
+        }
+        gemv(trans, m, k, 2, a.data(), k, x.data(), -1, y.data());
+        for (int i = 0; i < y_size; i++) {
+          max_error = std::max<double>(max_error, std::fabs(y[i] - expect[i]));
+        }
+      }
+    }
+  }
+  return max_error;
+}
+
+} // namespace gemm_test
+
+TEST(KernelGemm, AllIsa) {
+  using namespace deeplearning::kernel;
+  for (int i = CPU_ISA_SCALAR; i <= CpuFeature::DetectIsa(); i++) {
+    auto table = CreateKernelTable<double>((CpuIsa)i);
+    double error = gemm_test::MaxGemmError<double>(table.gemm_);
+    DEBUG(CpuFeature::IsaName(table.isa_) << " gemm error: " << error);
+    MUST_TRUE(error < 1e-10, "gemm error too large");
+    error = gemm_test::MaxGemvError<double>(table.gemv_);
+    DEBUG(CpuFeature::IsaName(table.isa_) << " gemv error: " << error);
+    MUST_TRUE(error < 1e-10, "gemv error too large");
+  }
+}
+
+TEST(KernelGemm, AllIsaFloat) {
+  using namespace deeplearning::kernel;
+  for (int i = CPU_ISA_SCALAR; i <= CpuFeature::DetectIsa(); i++) {
+    auto table = CreateKernelTable<float>((CpuIsa)i);
+    double error = gemm_test::MaxGemmError<float>(table.gemm_);
+    DEBUG(CpuFeature::IsaName(table.isa_) << " float gemm error: " << error);
+    MUST_TRUE(error < 1e-3, "float gemm error too large");
+    error = gemm_test::MaxGemvError<float>(table.gemv_);
+    DEBUG(CpuFeature::IsaName(table.isa_) << " float gemv error: " << error);
+    MUST_TRUE(error < 1e-3, "float gemv error too large");
+  }
+}
+
+TEST(KernelGemm, Bf16) {
+  using namespace deeplearning::kernel;
+  // rounding of the operand is in the reference, what left is the float
+  // accumulation over k up to 300
+  for (int i = CPU_ISA_SCALAR; i <= CpuFeature::DetectIsa(); i++) {
+    auto table = CreateKernelTable<double>((CpuIsa)i);
+    double error = gemm_test::MaxGemmError<double>(table.gemm_bf16_, true);
+    DEBUG(CpuFeature::IsaName(table.isa_)
+          << (table.native_bf16_ ? " native" : " emulated")
+          << " bf16 gemm error: " << error);
+    MUST_TRUE(error < 1e-4, "bf16 gemm error too large");
+    auto float_table = CreateKernelTable<float>((CpuIsa)i);
+    error = gemm_test::MaxGemmError<float>(float_table.gemm_bf16_, true);
+    MUST_TRUE(error < 1e-4, "float bf16 gemm error too large");
+  }
+#if DL_KERNEL_X86
+  // the emulated avx512 kernel is shadowed by the native one in the table
+  if (CpuFeature::DetectIsa() == CPU_ISA_AVX512) {
+    double error =
+        gemm_test::MaxGemmError<double>(avx512::GemmBf16<double>, true);
+    DEBUG("avx512 emulated bf16 gemm error: " << error);
+    MUST_TRUE(error < 1e-4, "emulated bf16 gemm error too large");
+  }
+#endif
+}
+
+TEST(KernelGemm, Int8) {
+  using namespace deeplearning::kernel;
+  // input stay in [0, 127] as the quantized network feed it, where the
+  // int16 pair sum of maddubs can not saturate and every path is exact
+  std::mt19937 gen(11);
+  std::uniform_int_distribution<int> input_distr(0, 127);
+  std::uniform_int_distribution<int> weight_distr(-128, 127);
+  for (int rows : {1, 3, 4, 37}) {
+    for (int k : {kInt8Align, 5 * kInt8Align}) {
+      deeplearning::AlignedVector<std::uint8_t> x(k);
+      deeplearning::AlignedVector<std::int8_t> w((std::size_t)rows * k);
+      for (auto &value : x) {
+        value = input_distr(gen);
+      }
+      for (auto &value : w) {
+        value = weight_distr(gen);
+      }
+      std::vector<std::int32_t> expect(rows), result(rows);
+      Int8GemvScalar(rows, k, x.data(), w.data(), k, expect.data());
+      for (int i = CPU_ISA_SCALAR; i <= CpuFeature::DetectIsa(); i++) {
+        auto table = CreateKernelTable<float>((CpuIsa)i);
+        std::fill(result.begin(), result.end(), -1);
+        table.int8_gemv_(rows, k, x.data(), w.data(), k, result.data());
+        if (result != expect) {
+          DEBUG(CpuFeature::IsaName(table.isa_)
+                << (table.vnni_ ? " vnni" : "") << " rows " << rows << " k "
+                << k);
+        }
+        MUST_TRUE(result == expect, "int8 gemv mismatch");
+      }
+    }
+  }
+}
+
+TEST(KernelGemm, ParallelMatMul) {
+  using namespace deeplearning;
+  std::mt19937 gen(5);
+  std::uniform_real_distribution<double> distr(-1, 1);
+  // big enough to split between pool thread when there is more than one
+  Matrix<double> left(300, 200), right(200, 100), result, expect(300, 100);
+  for (auto &value : left) {
+    value = distr(gen);
+  }
+  for (auto &value : right) {
+    value = distr(gen);
+  }
+  for (int trans = 0; trans < 4; trans++) {
+    bool trans_left = trans & 1, trans_right = trans & 2;
+    Matrix<double> a = left, b = right;
+    if (trans_left) {
+      a.Reshape(200, 300);
+    }
+    if (trans_right) {
+      b.Reshape(100, 200);
+    }
+    int m = trans_left ? a.cols() : a.rows();
+    int k = trans_left ? a.rows() : a.cols();
+    int n = trans_right ? b.rows() : b.cols();
+    kernel::MatMul(a, trans_left, b, trans_right, result);
+    expect.Reshape(m, n);
+    kernel::Gemm<double>(trans_left, trans_right, m, n, k, 1, a.data(),
+                         a.cols(), b.data(), b.cols(), 0, expect.data(), n);
+    MUST_EQUAL(result.rows(), m);
+    MUST_EQUAL(result.cols(), n);
+    double max_error = 0;
+    for (int i = 0; i < result.size(); i++) {
+      max_error = std::max(max_error,
+                           std::fabs(result.data()[i] - expect.data()[i]));
+    }
+    MUST_TRUE(max_error < 1e-12, "parallel matmul mismatch");
+  }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "kernel/dispatch.h"
+#include "test.h"
+#include <cmath>
+#include <vector>
+
+namespace vector_math_test {
+
+struct MathError {
+  double exp_ = 0;
+  double sigmoid_ = 0;
+  double tanh_ = 0;
+};
+
+// exp error is relative, sigmoid and tanh output is in [-1, 1] so their
+// error is absolute
+template <typename T>
+MathError MaxMathError(const deeplearning::kernel::KernelTable<T> &table,
+                       int accuracy) {
+  const int size = 20001;
+  std::vector<T> exp_input(size), input(size), output(size);
+  for (int i = 0; i < size; i++) {
+    exp_input[i] = -80 + 160.0 * i / (size - 1);
+    input[i] = -20 + 40.0 * i / (size - 1);
+  }
+  MathError error;
+  table.exp_[accuracy](size, exp_input.data(), output.data());
+  for (int i = 0; i < size; i++) {
+    double expect = std::exp((double)exp_input[i]);
+    error.exp_ = std::max(error.exp_, std::fabs(output[i] - expect) / expect);
+  }
+  table.sigmoid_[accuracy](size, input.data(), output.data());
+  for (int i = 0; i < size; i++) {
+    double expect = 1 / (1 + std::exp(-(double)input[i]));
+    error.sigmoid_ = std::max(error.sigmoid_, std::fabs(output[i] - expect));
+  }
+  table.tanh_[accuracy](size, input.data(), output.data());
+  for (int i = 0; i < size; i++) {
+    double expect = std::tanh((double)input[i]);
+    error.tanh_ = std::max(error.tanh_, std::fabs(output[i] - expect));
+  }
+  return error;
+}
+
+} // namespace vector_math_test
+
+TEST(KernelMath, Accuracy) {
+  using namespace deeplearning;
+  using namespace deeplearning::kernel;
+  const char *name[] = {"exact", "high", "fast"};
+  // bound of double, float exact and high are limit by float epsilon
+  const double double_bound[] = {1e-14, 1e-7, 1e-4};
+  const double float_bound[] = {1e-6, 1e-6, 1e-4};
+  for (int i = CPU_ISA_SCALAR; i <= CpuFeature::DetectIsa(); i++) {
+    auto double_table = CreateKernelTable<double>((CpuIsa)i);
+    auto float_table = CreateKernelTable<float>((CpuIsa)i);
+    for (int accuracy = 0; accuracy < kMathAccuracyNum; accuracy++) {
+      auto error = vector_math_test::MaxMathError(double_table, accuracy);
+      DEBUG(CpuFeature::IsaName((CpuIsa)i)
+            << " " << name[accuracy] << " double exp: " << error.exp_
+            << " sigmoid: " << error.sigmoid_ << " tanh: " << error.tanh_);
+      MUST_TRUE(error.exp_ < double_bound[accuracy] &&
+                    error.sigmoid_ < double_bound[accuracy] &&
+                    error.tanh_ < double_bound[accuracy],
+                "double math error too large");
+      error = vector_math_test::MaxMathError(float_table, accuracy);
+      DEBUG(CpuFeature::IsaName((CpuIsa)i)
+            << " " << name[accuracy] << " float exp: " << error.exp_
+            << " sigmoid: " << error.sigmoid_ << " tanh: " << error.tanh_);
+      MUST_TRUE(error.exp_ < float_bound[accuracy] &&
+                    error.sigmoid_ < float_bound[accuracy] &&
+                    error.tanh_ < float_bound[accuracy],
+                "float math error too large");
+    }
+  }
+}
@@ -1,8 +1,21 @@
 // this file is to include all test header
+#include "activate/activate_test.h"
+#include "inference_session_test.h"
+#include "kernel/dispatch_test.h"
+#include "kernel/gemm_test.h"
+#include "kernel/vector_math_test.h"
 #include "neural_network_loader_test.h"
 #include "neural_network_test.h"
+#include "optimizer/optimizer_test.h"
+#include "param_init/param_init_test.h"
 #include "softmax/std_softmax_test.h"
+#include "static_neural_network_test.h"
 #include "test.h"
+#include "util/data_source_test.h"
+#include "util/dataset_test.h"
+#include "util/idx_file_test.h"
+#include "util/reduced_float_test.h"
+#include "util/thread_pool_test.h"
 
 ARGC_FUNC {
   if (argc == 2) {
@@ -3,6 +3,7 @@
 #include "../deeplearning/neural_network_loader.h"
 #include "test.h"
 #include <cstdlib>
+#include <fstream>
 
 using namespace std;
 using namespace deeplearning;
@@ -67,3 +68,69 @@ TEST(Loader, ExportAndInport) {
     }
   }
 }
+
+TEST(Loader, OptimizerState) {
+  const string file_path = "adam.param";
+  DEFER([=]() { remove(file_path.c_str()); });
+  vector<vector<double>> data = {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+  vector<vector<double>> target = {{0}, {1}, {1}, {0}};
+
+  NeuralNetwork network((vector<int>() = {2, 4, 1}));
+  network.set_param_init_function(ParamInitType::PARAM_INIT_XAVIER);
+  network.set_optimizer_function(OptimizerType::OPTIMIZER_ADAM);
+  auto rc = network.Train(data, target, nullptr, 10, 4, 0.01);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+
+  NeuralNetwork::NetworkParam param;
+  NeuralNetwork::NetworkOption option;
+  network.ExportNetworkParam(param, option);
+  MUST_TRUE(!param.optimizer_state_.empty(), "adam state not exported");
+  auto loader_rc =
+      NeuralNetworkLoader::ExportParamToFile(param, option, file_path);
+  MUST_EQUAL(loader_rc, NeuralNetworkLoader::SUCCESS);
+  NeuralNetwork::NetworkParam load_param;
+  NeuralNetwork::NetworkOption load_option;
+  loader_rc = NeuralNetworkLoader::ImportParamFromFile(load_param, load_option,
+                                                       file_path);
+  MUST_EQUAL(loader_rc, NeuralNetworkLoader::SUCCESS);
+  MUST_TRUE(load_param.optimizer_state_ == param.optimizer_state_,
+            "state changed by file");
+
+  // a forged state size larger than the file is refused
+  {
+    std::fstream file(file_path, std::ios::binary | std::ios::in |
+                                     std::ios::out | std::ios::ate);
+    long long huge = 1ll << 60;
+    file.seekp((long long)file.tellp() -
+               (long long)(sizeof(double) * param.optimizer_state_.size() +
+                           sizeof(huge)));
+    file.write((const char *)&huge, sizeof(huge));
+  }
+  NeuralNetwork::NetworkParam forged_param;
+  loader_rc = NeuralNetworkLoader::ImportParamFromFile(forged_param,
+                                                       load_option, file_path);
+  MUST_EQUAL(loader_rc, NeuralNetworkLoader::INPORT_ERROR);
+
+  // resumed training continue where the original is, only the sum order of
+  // the shuffled batch differ
+  NeuralNetwork resume;
+  rc = resume.ImportNetworkParam(load_param, load_option);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, resume.err_msg());
+  network.Train(data, target, nullptr, 3, 4, 0.01);
+  resume.Train(data, target, nullptr, 3, 4, 0.01);
+  network.ExportNetworkParam(param, option);
+  resume.ExportNetworkParam(load_param, load_option);
+  MUST_EQUAL(load_param.optimizer_state_.size(), param.optimizer_state_.size());
+  double max_diff = 0;
+  for (int i = 0; i < param.optimizer_state_.size(); i++) {
+    max_diff = std::max(max_diff, fabs(load_param.optimizer_state_[i] -
+                                       param.optimizer_state_[i]));
+  }
+  for (int j = 0; j < param.layer_[1]; j++) {
+    for (int k = 0; k < param.layer_[0]; k++) {
+      max_diff = std::max(max_diff, fabs(load_param.neuron_weight_[1][j][k] -
+                                         param.neuron_weight_[1][j][k]));
+    }
+  }
+  MUST_TRUE(max_diff < 1e-12, "resumed training differ");
+}
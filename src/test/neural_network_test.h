@@ -3,13 +3,14 @@
 #include "matplot_draw.h"
 #include "neural_network.h"
 #include "neural_network_loader.h"
+#include "quantized_network.h"
 #include "test.h"
 
 #include <cmath>
 #include <cstdlib>
-#include <ctime>
 #include <fstream>
 #include <iomanip>
+#include <random>
 #include <utility>
 #include <vector>
 
@@ -23,10 +24,10 @@ std::vector<std::vector<double>> demo_data_target;
 std::string demo_test_file_path;
 std::vector<std::vector<double>> demo_test;
 std::vector<std::vector<double>> demo_test_target;
-NeuralNetwork demo_network;
 
 INIT(NeuralNetwork) {
-  srand(time(nullptr));
+  // fixed seed, every run train and test on the same data
+  srand(1);
   demo_data_file_path = "demo.data";
   demo_test_file_path = "demo.test";
   const int train_data_size = 60000;
@@ -111,25 +112,35 @@ END(NeuralNetwork) {
   remove(demo_test_file_path.c_str());
 }
 
+// the demo network, xavier init keep it off the dead start a default init
+// hit now and then. a test that need a trained network train its own, so it
+// does not depend on the order or result of another
+inline NeuralNetwork::RC
+TrainDemoNetwork(NeuralNetwork &network,
+                 NeuralNetwork::EpochCallback each_epoch_call = nullptr) {
+  auto rc = network.Init((vector<int>() = {2, 16, 8, 2}));
+  if (rc != NeuralNetwork::SUCCESS) {
+    return rc;
+  }
+  rc = network.set_param_init_function(ParamInitType::PARAM_INIT_XAVIER);
+  if (rc != NeuralNetwork::SUCCESS) {
+    return rc;
+  }
+  rc = network.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  if (rc != NeuralNetwork::SUCCESS) {
+    return rc;
+  }
+  return network.Train(demo_data, demo_data_target, each_epoch_call, 2000, 8,
+                       0.1);
+}
+
 TEST(NeuralNetwork, TrainAndPredict) {
   NeuralNetwork network;
-  network.Init((vector<int>() = {2, 3, 3, 2}));
-  MUST_EQUAL(network.network_status(), NeuralNetwork::NETWORK_STATUS_INIT);
-  auto rc = network.set_loss_function(LossType::LOSS_MSE);
-  MUST_EQUAL(rc, NeuralNetwork::SUCCESS);
-  rc = demo_network.set_param_init_function(ParamInitType::PARAM_INIT_XAVIER);
-  MUST_EQUAL(rc, NeuralNetwork::SUCCESS);
-
-  // rc = network.set_softmax_function(SoftmaxType::SOFTMAX_STD);
-  // MUST_EQUAL(rc, NeuralNetwork::SUCCESS);
-  // rc = network.set_activate_function(ActivateType::ACTIVATE_TANH);
-  // MUST_EQUAL(rc, NeuralNetwork::SUCCESS);
 
   vector<double> train_loss_y, test_loss_y, train_loss_x, test_loss_x;
   auto print_func = [&](NeuralNetwork &network, int epoch_num,
                         bool &early_stop) {
-    static int count = 0;
-    if (count++ % 1000 == 0) {
+    if (epoch_num % 100 == 0) {
       double train_loss = 0;
       auto rc = network.CalcLoss(demo_data, demo_data_target, train_loss);
       if (rc != NeuralNetwork::SUCCESS) {
@@ -153,10 +164,7 @@ TEST(NeuralNetwork, TrainAndPredict) {
     //   early_stop = true;
     // }
   };
-  network.set_softmax_function(SoftmaxType::SOFTMAX_STD);
-  network.set_learning_rate(0.1);
-  network.set_optimizer_function(OptimizerType::OPTIMIZER_MOMENTUM);
-  rc = network.Train(demo_data, demo_data_target, print_func);
+  auto rc = TrainDemoNetwork(network, print_func);
   MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
 
   // calc right rate
@@ -182,19 +190,23 @@ TEST(NeuralNetwork, TrainAndPredict) {
   DEBUG("right rate: " << right_count * 1.0 / demo_test.size());
   MUST_TRUE(right_count * 1.0 / demo_test.size() > 0.8,
             "train loss is too high");
-
-  // clone
-  rc = demo_network.Clone(network);
-  MUST_TRUE(rc == NeuralNetwork::SUCCESS, demo_network.err_msg());
 }
 
 TEST(NeuralNetwork, CloneAndExport) {
+  NeuralNetwork trained;
+  auto rc = TrainDemoNetwork(trained);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, trained.err_msg());
+  NeuralNetwork demo_network;
+  rc = demo_network.Clone(trained);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, demo_network.err_msg());
   MUST_EQUAL(demo_network.network_status(), NeuralNetwork::NETWORK_STATUS_INIT);
 
   // predict
-  vector<double> result;
-  auto rc = demo_network.Predict(demo_data[0], result);
+  vector<double> result, expect;
+  rc = demo_network.Predict(demo_data[0], result);
   MUST_TRUE(rc == NeuralNetwork::SUCCESS, demo_network.err_msg());
+  trained.Predict(demo_data[0], expect);
+  MUST_TRUE(result == expect, "clone predict differ");
   // calc right rate
   auto right_rate = [&](NeuralNetwork &demo_network) -> double {
     int right_count = 0;
@@ -244,3 +256,542 @@ TEST(NeuralNetwork, CloneAndExport) {
   DEBUG("right rate: " << right_count);
   MUST_TRUE(right_count > 0.8, "train loss is too high");
 }
+
+TEST(NeuralNetwork, PredictBatch) {
+  NeuralNetwork network((vector<int>() = {2, 5, 4, 2}));
+  auto rc = network.set_param_init_function(ParamInitType::PARAM_INIT_XAVIER);
+  MUST_EQUAL(rc, NeuralNetwork::SUCCESS);
+  rc = network.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  MUST_EQUAL(rc, NeuralNetwork::SUCCESS);
+
+  const int batch_size = 37;
+  NeuralNetwork::Matrix inputs(batch_size, 2), outputs;
+  for (int i = 0; i < batch_size; i++) {
+    inputs(i, 0) = demo_test[i][0] / 100;
+    inputs(i, 1) = demo_test[i][1] / 100;
+  }
+  rc = network.PredictBatch(inputs, outputs);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+  MUST_EQUAL(outputs.rows(), batch_size);
+  MUST_EQUAL(outputs.cols(), 2);
+
+  for (int i = 0; i < batch_size; i++) {
+    vector<double> result;
+    rc = network.Predict(vector<double>(inputs[i].begin(), inputs[i].end()),
+                         result);
+    MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+    for (int j = 0; j < result.size(); j++) {
+      MUST_TRUE(fabs(result[j] - outputs(i, j)) < 1e-9, "batch mismatch");
+    }
+  }
+
+  NeuralNetwork::Matrix bad_inputs(3, 4);
+  rc = network.PredictBatch(bad_inputs, outputs);
+  MUST_EQUAL(rc, NeuralNetwork::INVALID_DATA);
+}
+
+TEST(NeuralNetwork, PredictSpan) {
+  NeuralNetwork network((vector<int>() = {2, 5, 4, 3}));
+  auto rc = network.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  MUST_EQUAL(rc, NeuralNetwork::SUCCESS);
+
+  // input and output live in caller owned plain arrays
+  double input[2], output[3];
+  for (int i = 0; i < 20; i++) {
+    input[0] = demo_test[i][0] / 100;
+    input[1] = demo_test[i][1] / 100;
+    rc = network.Predict(Span<const double>(input, 2), Span<double>(output, 3));
+    MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+    vector<double> expect;
+    rc = network.Predict(vector<double>(input, input + 2), expect);
+    MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+    for (int j = 0; j < 3; j++) {
+      MUST_TRUE(output[j] == expect[j], "span predict mismatch");
+    }
+  }
+
+  rc = network.Predict(Span<const double>(input, 2), Span<double>(output, 2));
+  MUST_EQUAL(rc, NeuralNetwork::INVALID_DATA);
+  rc = network.Predict(Span<const double>(input, 1), Span<double>(output, 3));
+  MUST_EQUAL(rc, NeuralNetwork::INVALID_DATA);
+}
+
+TEST(NeuralNetwork, TrainThreads) {
+  NeuralNetwork single((vector<int>() = {2, 8, 6, 2}));
+  auto rc = single.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  MUST_EQUAL(rc, NeuralNetwork::SUCCESS);
+  NeuralNetwork multi;
+  rc = multi.Clone(single);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, multi.err_msg());
+
+  // full batch step, only the summation order differ between thread num
+  vector<vector<double>> data(demo_data.begin(), demo_data.begin() + 301);
+  vector<vector<double>> target(demo_data_target.begin(),
+                                demo_data_target.begin() + 301);
+  rc = single.Train(data, target, nullptr, 20, data.size(), 0.1);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, single.err_msg());
+  rc = multi.Train(data, target, nullptr, 20, data.size(), 0.1, 4);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, multi.err_msg());
+
+  NeuralNetwork::NetworkParam single_param, multi_param;
+  NeuralNetwork::NetworkOption option;
+  single.ExportNetworkParam(single_param, option);
+  multi.ExportNetworkParam(multi_param, option);
+  double max_diff = 0;
+  for (int i = 1; i < single_param.layer_.size(); i++) {
+    for (int j = 0; j < single_param.layer_[i]; j++) {
+      max_diff = std::max(max_diff, fabs(single_param.neuron_bias_[i][j] -
+                                         multi_param.neuron_bias_[i][j]));
+      for (int k = 0; k < single_param.layer_[i - 1]; k++) {
+        max_diff =
+            std::max(max_diff, fabs(single_param.neuron_weight_[i][j][k] -
+                                    multi_param.neuron_weight_[i][j][k]));
+      }
+    }
+  }
+  DEBUG("thread train max diff: " << max_diff);
+  MUST_TRUE(max_diff < 1e-9, "multi thread train mismatch");
+
+  rc = multi.Train(data, target, nullptr, 1, 1, 0.1, 0);
+  MUST_EQUAL(rc, NeuralNetwork::INVALID_DATA);
+}
+
+TEST(NeuralNetwork, TrainAsync) {
+  NeuralNetwork network((vector<int>() = {2, 8, 6, 2}));
+  auto rc = network.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  MUST_EQUAL(rc, NeuralNetwork::SUCCESS);
+  network.set_train_mode(NeuralNetwork::TRAIN_MODE_ASYNC);
+  double begin_loss = 0, end_loss = 0;
+  rc = network.CalcLoss(demo_test, demo_test_target, begin_loss);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+
+  int callback_count = 0;
+  auto count_func = [&](NeuralNetwork &, int, bool &) { callback_count++; };
+  rc = network.Train(demo_data, demo_data_target, count_func, 20000, 4, 0.1,
+                     4);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+  rc = network.CalcLoss(demo_test, demo_test_target, end_loss);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+  DEBUG("async loss: " << begin_loss << " -> " << end_loss);
+  MUST_TRUE(end_loss < begin_loss, "async train not converge");
+  // callback only run on the first worker
+  MUST_EQUAL(callback_count, 5000);
+
+  // each worker step its own adam state, the network keep the one of worker
+  // 0, so its step count is exactly that worker's step and not a raced sum
+  rc = network.set_optimizer_function(OPTIMIZER_ADAM);
+  MUST_EQUAL(rc, NeuralNetwork::SUCCESS);
+  rc = network.Train(demo_data, demo_data_target, nullptr, 20000, 4, 0.01, 4);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+  NeuralNetwork::NetworkParam param;
+  NeuralNetwork::NetworkOption option;
+  network.ExportNetworkParam(param, option);
+  MUST_EQUAL(param.optimizer_state_[0], 5000);
+  double adam_loss = 0;
+  rc = network.CalcLoss(demo_test, demo_test_target, adam_loss);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+  DEBUG("async adam loss: " << adam_loss);
+  MUST_TRUE(std::isfinite(adam_loss) && adam_loss < begin_loss,
+            "async adam train not converge");
+}
+
+TEST(NeuralNetwork, Evaluate) {
+  NeuralNetwork network((vector<int>() = {2, 8, 2}));
+  auto rc = network.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  MUST_EQUAL(rc, NeuralNetwork::SUCCESS);
+  rc = network.Train(demo_data, demo_data_target, nullptr, 2000, 8, 0.1);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+
+  double loss = 0;
+  rc = network.CalcLoss(demo_test, demo_test_target, loss);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+  int right_count = 0;
+  vector<vector<int>> confusion(2, vector<int>(2, 0));
+  for (int i = 0; i < demo_test.size(); i++) {
+    vector<double> result;
+    network.Predict(demo_test[i], result);
+    int predict = result[1] > result[0];
+    int label = demo_test_target[i][1] > demo_test_target[i][0];
+    right_count += predict == label;
+    confusion[label][predict]++;
+  }
+
+  for (int batch_num : {7, 256, 5000}) {
+    NeuralNetwork::EvaluateResult result;
+    rc = network.Evaluate(demo_test, demo_test_target, result, batch_num);
+    MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+    DEBUG("evaluate loss: " << result.loss_
+                            << " accuracy: " << result.accuracy_);
+    MUST_TRUE(fabs(result.loss_ - loss) < 1e-12, "evaluate loss mismatch");
+    MUST_TRUE(fabs(result.accuracy_ - right_count * 1.0 / demo_test.size()) <
+                  1e-12,
+              "evaluate accuracy mismatch");
+    MUST_TRUE(result.confusion_matrix_ == confusion,
+              "confusion matrix mismatch");
+  }
+
+  NeuralNetwork::EvaluateResult result;
+  vector<vector<double>> bad_target(demo_test.size(), vector<double>(3));
+  rc = network.Evaluate(demo_test, bad_target, result);
+  MUST_EQUAL(rc, NeuralNetwork::INVALID_DATA);
+}
+
+TEST(NeuralNetwork, TrainBf16) {
+  NeuralNetwork full((vector<int>() = {2, 8, 2}));
+  auto rc = full.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  MUST_EQUAL(rc, NeuralNetwork::SUCCESS);
+  NeuralNetwork bf16;
+  rc = bf16.Clone(full);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, bf16.err_msg());
+  bf16.set_train_precision(NeuralNetwork::TRAIN_PRECISION_BF16);
+  // the product of 1e40 overflow float, the dynamic scale must back off
+  // until the step is finite again
+  bf16.set_loss_scale(1e40);
+  bf16.set_dynamic_loss_scale(true);
+
+  rc = full.Train(demo_data, demo_data_target, nullptr, 2000, 8, 0.1);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, full.err_msg());
+  rc = bf16.Train(demo_data, demo_data_target, nullptr, 2000, 8, 0.1);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, bf16.err_msg());
+  DEBUG("bf16 loss scale: " << bf16.loss_scale());
+  MUST_TRUE(bf16.loss_scale() < 1e38, "loss scale not reduced");
+  NeuralNetwork clone;
+  clone.Clone(bf16);
+  MUST_EQUAL(clone.loss_scale(), bf16.loss_scale());
+  MUST_TRUE(clone.dynamic_loss_scale(), "dynamic loss scale not cloned");
+
+  NeuralNetwork::EvaluateResult full_result, bf16_result;
+  rc = full.Evaluate(demo_test, demo_test_target, full_result);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, full.err_msg());
+  rc = bf16.Evaluate(demo_test, demo_test_target, bf16_result);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, bf16.err_msg());
+  DEBUG("full accuracy: " << full_result.accuracy_
+                          << " bf16 accuracy: " << bf16_result.accuracy_);
+  MUST_TRUE(std::isfinite(bf16_result.loss_), "bf16 loss is not finite");
+  MUST_TRUE(bf16_result.accuracy_ > full_result.accuracy_ - 0.05,
+            "bf16 accuracy too low");
+}
+
+TEST(NeuralNetwork, TrainDataset) {
+  // uint8 step of 1/255 over the demo data, the same quantized value as
+  // nested vector is the reference. one batch of the whole set so both
+  // network take the same step whatever the shuffle
+  Dataset dataset;
+  auto dataset_rc = dataset.Assign(demo_data, demo_data_target,
+                                   Dataset::FORMAT_UINT8, 1.0 / 255);
+  MUST_TRUE(dataset_rc == Dataset::SUCCESS, dataset.err_msg());
+  vector<vector<double>> data(dataset.size(), vector<double>(2));
+  for (int i = 0; i < dataset.size(); i++) {
+    dataset.LoadSample(i, data[i].data());
+  }
+  NeuralNetwork expect((vector<int>() = {2, 8, 2}));
+  expect.set_param_init_function(ParamInitType::PARAM_INIT_XAVIER);
+  expect.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  NeuralNetwork network;
+  network.Clone(expect);
+  auto rc = expect.Train(data, demo_data_target, nullptr, 20, data.size(), 1);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, expect.err_msg());
+  rc = network.Train(dataset, nullptr, 20, dataset.size(), 1);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+
+  double expect_loss = 0, loss = 0;
+  expect.CalcLoss(data, demo_data_target, expect_loss);
+  rc = network.CalcLoss(dataset, loss);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+  DEBUG("dataset loss: " << loss << " vector loss: " << expect_loss);
+  MUST_TRUE(fabs(loss - expect_loss) < 1e-9, "dataset loss differ");
+  vector<double> expect_result, result;
+  expect.Predict(data[5], expect_result);
+  rc = network.Predict(dataset, 5, result);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+  MUST_TRUE(fabs(result[0] - expect_result[0]) < 1e-9,
+            "dataset predict differ");
+
+  Dataset wrong;
+  wrong.Init(Dataset::FORMAT_BIT, 4, 3, 2);
+  rc = network.Train(wrong, nullptr, 1, 1);
+  MUST_EQUAL(rc, NeuralNetwork::INVALID_DATA);
+}
+
+TEST(NeuralNetwork, TrainDataSource) {
+  // the record file is read in chunk of 21 record, a whole set batch span
+  // several chunk and take the same step as the in memory dataset
+  const string file_path = "demo.record";
+  DEFER([=]() { remove(file_path.c_str()); });
+  Dataset dataset;
+  dataset.Assign(demo_data, demo_data_target, Dataset::FORMAT_UINT8,
+                 1.0 / 255);
+  auto write_rc = RecordWriter::Write(dataset, file_path);
+  MUST_EQUAL(write_rc, RecordWriter::SUCCESS);
+  RecordFileSource<double> source;
+  auto source_rc = source.Open(file_path, 64);
+  MUST_TRUE(source_rc == RecordFileSource<double>::SUCCESS, source.err_msg());
+  MUST_EQUAL(source.SizeHint(), dataset.size());
+
+  NeuralNetwork expect((vector<int>() = {2, 8, 2}));
+  expect.set_param_init_function(ParamInitType::PARAM_INIT_XAVIER);
+  expect.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  NeuralNetwork network;
+  network.Clone(expect);
+  auto rc = expect.Train(dataset, nullptr, 20, dataset.size(), 1);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, expect.err_msg());
+  rc = network.Train(source, nullptr, 20, dataset.size(), 1, 2);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+  double expect_loss = 0, loss = 0;
+  expect.CalcLoss(dataset, expect_loss);
+  network.CalcLoss(dataset, loss);
+  DEBUG("source loss: " << loss << " dataset loss: " << expect_loss);
+  MUST_TRUE(fabs(loss - expect_loss) < 1e-9, "data source loss differ");
+
+  // epoch 0 is one pass, the short batch at the end is dropped
+  int step = 0;
+  rc = network.Train(
+      source, [&](NeuralNetwork &, int, bool &) { step++; }, 0, 7);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+  MUST_EQUAL(step, dataset.size() / 7);
+  rc = network.Train(source, nullptr, 1, dataset.size() + 1);
+  MUST_EQUAL(rc, NeuralNetwork::INVALID_DATA);
+}
+
+TEST(NeuralNetwork, SparseInput) {
+  // 4 of the even feature set per sample, the class is whether feature
+  // 0-31 or 32-63 has more of them. odd column are never set so the batch
+  // take the sparse path. whole data set is one batch so both network see
+  // the same step whatever the shuffle
+  mt19937 gen(3);
+  uniform_int_distribution<int> distr(0, 31);
+  vector<vector<double>> data(64, vector<double>(64, 0)), target;
+  for (auto &sample : data) {
+    int low = 0;
+    for (int i = 0; i < 4; i++) {
+      int feature = distr(gen) * 2;
+      low += sample[feature] == 0 && feature < 32;
+      sample[feature] = 1;
+    }
+    target.push_back(low * 2 > 4 ? vector<double>{1, 0}
+                                 : vector<double>{0, 1});
+  }
+  // sgd step only the gathered column on one worker and scatter for the
+  // reduce on two, momentum step every column. see SparseMomentum for batch
+  // whose column differ
+  for (auto type : {OPTIMIZER_SGD, OPTIMIZER_MOMENTUM}) {
+    for (int threads : {1, 2}) {
+      NeuralNetwork dense((vector<int>() = {64, 16, 2}));
+      dense.set_param_init_function(ParamInitType::PARAM_INIT_XAVIER);
+      dense.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+      dense.set_optimizer_function(type);
+      NeuralNetwork sparse;
+      auto rc = sparse.Clone(dense);
+      MUST_TRUE(rc == NeuralNetwork::SUCCESS, sparse.err_msg());
+      sparse.set_sparse_input(true);
+      rc = dense.Train(data, target, nullptr, 50, data.size(), 0.1);
+      MUST_TRUE(rc == NeuralNetwork::SUCCESS, dense.err_msg());
+      rc = sparse.Train(data, target, nullptr, 50, data.size(), 0.1,
+                        threads);
+      MUST_TRUE(rc == NeuralNetwork::SUCCESS, sparse.err_msg());
+
+      Matrix<double> inputs, dense_output, sparse_output;
+      inputs.Assign(data);
+      dense.PredictBatch(inputs, dense_output);
+      sparse.PredictBatch(inputs, sparse_output);
+      double max_diff = 0;
+      for (int i = 0; i < dense_output.size(); i++) {
+        max_diff = std::max(max_diff, fabs(dense_output.data()[i] -
+                                           sparse_output.data()[i]));
+      }
+      DEBUG("optimizer " << type << " thread " << threads
+                         << " sparse max diff: " << max_diff);
+      MUST_TRUE(max_diff < 1e-9, "sparse input result differ");
+    }
+  }
+}
+
+TEST(NeuralNetwork, SparseMomentum) {
+  // 8 mini batch of 8 sample, batch b only set feature 8b to 8b+7, so a
+  // column skipped by one batch has a velocity from an earlier one. each
+  // batch is its own Train call to fix the order, the momentum state is kept
+  mt19937 gen(5);
+  uniform_int_distribution<int> distr(0, 7);
+  vector<vector<vector<double>>> data(8), target(8);
+  for (int b = 0; b < 8; b++) {
+    for (int i = 0; i < 8; i++) {
+      vector<double> sample(64, 0);
+      int feature = distr(gen), other = distr(gen);
+      sample[b * 8 + feature] = sample[b * 8 + other] = 1;
+      data[b].push_back(sample);
+      target[b].push_back(feature < 4 ? vector<double>{1, 0}
+                                      : vector<double>{0, 1});
+    }
+  }
+  auto train = [&](NeuralNetwork &network, int threads) {
+    for (int epoch = 0; epoch < 5; epoch++) {
+      for (int b = 0; b < 8; b++) {
+        auto rc = network.Train(data[b], target[b], nullptr, 1, 8, 0.1,
+                                threads);
+        MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+      }
+    }
+  };
+  auto max_diff = [&](NeuralNetwork &a, NeuralNetwork &b) {
+    double diff = 0;
+    for (int b_i = 0; b_i < 8; b_i++) {
+      Matrix<double> inputs, a_output, b_output;
+      inputs.Assign(data[b_i]);
+      a.PredictBatch(inputs, a_output);
+      b.PredictBatch(inputs, b_output);
+      for (int i = 0; i < a_output.size(); i++) {
+        diff = std::max(diff,
+                        fabs(a_output.data()[i] - b_output.data()[i]));
+      }
+    }
+    return diff;
+  };
+
+  NeuralNetwork init((vector<int>() = {64, 16, 2}));
+  init.set_param_init_function(ParamInitType::PARAM_INIT_XAVIER);
+  init.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  init.set_optimizer_function(OPTIMIZER_MOMENTUM);
+  NeuralNetwork dense;
+  dense.Clone(init);
+  train(dense, 1);
+  // by default sparse momentum still step every column, on one worker and
+  // after the reduce of two
+  for (int threads : {1, 2}) {
+    NeuralNetwork sparse;
+    sparse.Clone(init);
+    sparse.set_sparse_input(true);
+    train(sparse, threads);
+    double diff = max_diff(dense, sparse);
+    DEBUG("thread " << threads << " sparse momentum max diff: " << diff);
+    MUST_TRUE(diff < 1e-9, "sparse momentum result differ");
+  }
+  // the lazy opt in hold the velocity of a skipped column, so it drift
+  NeuralNetwork lazy;
+  lazy.Clone(init);
+  lazy.set_sparse_input(true);
+  lazy.set_lazy_momentum(true);
+  train(lazy, 1);
+  double diff = max_diff(dense, lazy);
+  DEBUG("lazy momentum max diff: " << diff);
+  MUST_TRUE(diff > 1e-6, "lazy momentum should differ from the dense step");
+}
+
+TEST(NeuralNetwork, Quantize) {
+  const string file_path = "demo.q8";
+  DEFER([=]() { remove(file_path.c_str()); });
+  NeuralNetwork network;
+  auto rc = TrainDemoNetwork(network);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+  NeuralNetwork::NetworkParam param;
+  NeuralNetwork::NetworkOption option;
+  network.ExportNetworkParam(param, option);
+
+  // a slice of the train set is enough to find the range
+  vector<vector<double>> calibration(demo_data.begin(),
+                                     demo_data.begin() + 200);
+  QuantizedNetwork quantized;
+  auto quantized_rc = quantized.Quantize(param, option, calibration);
+  MUST_TRUE(quantized_rc == QuantizedNetwork::SUCCESS, quantized.err_msg());
+
+  NeuralNetwork::EvaluateResult full_result, int8_result;
+  rc = network.Evaluate(demo_test, demo_test_target, full_result);
+  MUST_TRUE(rc == NeuralNetwork::SUCCESS, network.err_msg());
+  quantized_rc = quantized.Evaluate(demo_test, demo_test_target, int8_result);
+  MUST_TRUE(quantized_rc == QuantizedNetwork::SUCCESS, quantized.err_msg());
+  DEBUG("full accuracy: " << full_result.accuracy_
+                          << " int8 accuracy: " << int8_result.accuracy_);
+  MUST_TRUE(int8_result.accuracy_ > full_result.accuracy_ - 0.02,
+            "int8 accuracy too low");
+
+  // file keep the int8 model exactly
+  QuantizedNetwork::QuantizedParam quantized_param;
+  quantized.ExportQuantizedParam(quantized_param);
+  auto loader_rc =
+      NeuralNetworkLoader::ExportQuantizedToFile(quantized_param, file_path);
+  MUST_EQUAL(loader_rc, NeuralNetworkLoader::SUCCESS);
+  loader_rc =
+      NeuralNetworkLoader::ImportQuantizedFromFile(quantized_param, file_path);
+  MUST_EQUAL(loader_rc, NeuralNetworkLoader::SUCCESS);
+  QuantizedNetwork load;
+  quantized_rc = load.ImportQuantizedParam(quantized_param);
+  MUST_TRUE(quantized_rc == QuantizedNetwork::SUCCESS, load.err_msg());
+  Matrix<double> inputs, expect, result;
+  inputs.Assign(demo_test);
+  MUST_EQUAL(quantized.PredictBatch(inputs, expect), QuantizedNetwork::SUCCESS);
+  MUST_EQUAL(load.PredictBatch(inputs, result), QuantizedNetwork::SUCCESS);
+  MUST_TRUE(std::equal(expect.begin(), expect.end(), result.begin()),
+            "loaded int8 model differ");
+  // a forged layer size beyond the file is refused before any allocation,
+  // the second layer size follow the 5 int header and the first size
+  {
+    std::fstream file(file_path, std::ios::binary | std::ios::in |
+                                     std::ios::out);
+    int huge = 0x7fffffff;
+    file.seekp(6 * sizeof(int));
+    file.write((const char *)&huge, sizeof(huge));
+  }
+  loader_rc =
+      NeuralNetworkLoader::ImportQuantizedFromFile(quantized_param, file_path);
+  MUST_EQUAL(loader_rc, NeuralNetworkLoader::INPORT_ERROR);
+}
+
+TEST(NeuralNetwork, FloatTrainAndLoad) {
+  std::vector<std::vector<float>> data, target, test, test_target;
+  for (int i = 0; i < demo_data.size(); i++) {
+    data.emplace_back(demo_data[i].begin(), demo_data[i].end());
+    target.emplace_back(demo_data_target[i].begin(),
+                        demo_data_target[i].end());
+  }
+  for (int i = 0; i < demo_test.size(); i++) {
+    test.emplace_back(demo_test[i].begin(), demo_test[i].end());
+    test_target.emplace_back(demo_test_target[i].begin(),
+                             demo_test_target[i].end());
+  }
+
+  FloatNeuralNetwork network((vector<int>() = {2, 3, 3, 2}));
+  network.set_softmax_function(SoftmaxType::SOFTMAX_STD);
+  network.set_learning_rate(0.1);
+  network.set_optimizer_function(OptimizerType::OPTIMIZER_MOMENTUM);
+  auto rc = network.Train(data, target);
+  MUST_TRUE(rc == FloatNeuralNetwork::SUCCESS, network.err_msg());
+
+  float loss = 0;
+  rc = network.CalcLoss(test, test_target, loss);
+  MUST_TRUE(rc == FloatNeuralNetwork::SUCCESS, network.err_msg());
+  DEBUG("float test loss: " << loss);
+  MUST_TRUE(std::isfinite(loss), "float loss is not finite");
+
+  // file always hold double, a double model can be load as float
+  NeuralNetwork demo_network;
+  auto demo_rc = TrainDemoNetwork(demo_network);
+  MUST_TRUE(demo_rc == NeuralNetwork::SUCCESS, demo_network.err_msg());
+  NeuralNetwork::NetworkParam param;
+  NeuralNetwork::NetworkOption option;
+  MUST_EQUAL(demo_network.ExportNetworkParam(param, option),
+             NeuralNetwork::SUCCESS);
+  const std::string filename = "neural_network_float_test.param";
+  DEFER([=]() { remove(filename.c_str()); });
+  MUST_EQUAL(NeuralNetworkLoader::ExportParamToFile(param, option, filename),
+             NeuralNetworkLoader::SUCCESS);
+
+  FloatNeuralNetwork::NetworkParam float_param;
+  FloatNeuralNetwork::NetworkOption float_option;
+  MUST_EQUAL(FloatNeuralNetworkLoader::ImportParamFromFile(
+                 float_param, float_option, filename),
+             FloatNeuralNetworkLoader::SUCCESS);
+  FloatNeuralNetwork float_network;
+  rc = float_network.ImportNetworkParam(float_param, float_option);
+  MUST_TRUE(rc == FloatNeuralNetwork::SUCCESS, float_network.err_msg());
+
+  for (int i = 0; i < 20; i++) {
+    std::vector<double> expect;
+    std::vector<float> result;
+    MUST_EQUAL(demo_network.Predict(demo_test[i], expect),
+               NeuralNetwork::SUCCESS);
+    MUST_EQUAL(float_network.Predict(test[i], result),
+               FloatNeuralNetwork::SUCCESS);
+    for (int j = 0; j < result.size(); j++) {
+      MUST_TRUE(fabs(result[j] - expect[j]) < 1e-3, "float predict mismatch");
+    }
+  }
+}
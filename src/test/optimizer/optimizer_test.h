@@ -0,0 +1,177 @@
+#pragma once
+
+#include "optimizer/optimizer_factory.h"
+#include "test.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+TEST(Optimizer, UpdateLayer) {
+  using namespace deeplearning;
+  std::vector<int> layer = {7, 5};
+  const int size = 35;
+  std::mt19937 gen(9);
+  std::uniform_real_distribution<double> distr(-1, 1);
+  std::vector<double> origin(size), grad(size);
+  for (int i = 0; i < size; i++) {
+    origin[i] = distr(gen);
+    grad[i] = distr(gen);
+  }
+  const double rate = 0.1, scale = 0.25;
+
+  auto sgd = OptimizerFactory::Create<double>(OPTIMIZER_SGD, layer);
+  auto weight = origin;
+  sgd->UpdateLayer(weight, grad, sgd->weight_state(1), rate, scale);
+  for (int i = 0; i < size; i++) {
+    MUST_TRUE(std::fabs(weight[i] - (origin[i] - rate * scale * grad[i])) <
+                  1e-15,
+              "sgd update mismatch");
+  }
+
+  // two step so the kept velocity take part
+  auto momentum = OptimizerFactory::Create<double>(OPTIMIZER_MOMENTUM, layer);
+  MUST_EQUAL(momentum->weight_state(1).moment_.size(), 1);
+  MUST_EQUAL(momentum->bias_state(1).moment_[0].size(), 5);
+  weight = origin;
+  std::vector<double> expect = origin, velocity(size, 0);
+  for (int step = 0; step < 2; step++) {
+    momentum->UpdateLayer(weight, grad, momentum->weight_state(1), rate,
+                          scale);
+    for (int i = 0; i < size; i++) {
+      velocity[i] = 0.9 * velocity[i] - rate * scale * grad[i];
+      expect[i] += velocity[i];
+    }
+  }
+  for (int i = 0; i < size; i++) {
+    MUST_TRUE(std::fabs(weight[i] - expect[i]) < 1e-15,
+              "momentum update mismatch");
+  }
+}
+
+TEST(Optimizer, Adaptive) {
+  using namespace deeplearning;
+  std::vector<int> layer = {6, 3};
+  const int size = 18;
+  std::mt19937 gen(4);
+  std::uniform_real_distribution<double> distr(-1, 1);
+  std::vector<double> origin(size), grad(size);
+  for (int i = 0; i < size; i++) {
+    origin[i] = distr(gen);
+    grad[i] = distr(gen);
+  }
+  const double rate = 0.01, scale = 0.5;
+
+  // reference of adam, adamw and rmsprop over three step, adamw with a
+  // decay other than the default
+  for (auto type : {OPTIMIZER_ADAM, OPTIMIZER_ADAMW, OPTIMIZER_RMSPROP}) {
+    auto optimizer = OptimizerFactory::Create<double>(type, layer, 0.05);
+    double decay = type == OPTIMIZER_ADAMW ? 0.05 : 0;
+    MUST_EQUAL(optimizer->weight_decay(), decay);
+    auto weight = origin, expect = origin;
+    std::vector<double> m(size, 0), v(size, 0);
+    for (int step = 1; step <= 3; step++) {
+      optimizer->UpdateLayer(weight, grad, optimizer->weight_state(1), rate,
+                             scale);
+      for (int i = 0; i < size; i++) {
+        double g = grad[i] * scale;
+        if (type == OPTIMIZER_RMSPROP) {
+          v[i] = 0.99 * v[i] + 0.01 * g * g;
+          expect[i] -= rate * g / (std::sqrt(v[i]) + 1e-8);
+          continue;
+        }
+        m[i] = 0.9 * m[i] + 0.1 * g;
+        v[i] = 0.999 * v[i] + 0.001 * g * g;
+        double m_hat = m[i] / (1 - std::pow(0.9, step));
+        double v_hat = v[i] / (1 - std::pow(0.999, step));
+        expect[i] -= rate * decay * expect[i];
+        expect[i] -= rate * m_hat / (std::sqrt(v_hat) + 1e-8);
+      }
+    }
+    double max_error = 0;
+    for (int i = 0; i < size; i++) {
+      max_error = std::max(max_error, std::fabs(weight[i] - expect[i]));
+    }
+    DEBUG("optimizer " << type << " error: " << max_error);
+    MUST_TRUE(max_error < 1e-12, "adaptive update mismatch");
+    MUST_EQUAL(optimizer->weight_state(1).step_, 3);
+
+    // state survive export and import
+    std::vector<double> state;
+    optimizer->ExportState(state);
+    auto copy = OptimizerFactory::Create<double>(type, layer, 0.05);
+    MUST_TRUE(copy->ImportState(state), "import state failed");
+    auto next = weight;
+    optimizer->UpdateLayer(weight, grad, optimizer->weight_state(1), rate,
+                           scale);
+    copy->UpdateLayer(next, grad, copy->weight_state(1), rate, scale);
+    MUST_TRUE(weight == next, "imported state step differ");
+    state.pop_back();
+    MUST_TRUE(!copy->ImportState(state), "import short state");
+  }
+}
+
+TEST(Optimizer, ReducedState) {
+  using namespace deeplearning;
+  // more than one chunk of 1024 so the step count is check across chunk
+  std::vector<int> layer = {40, 50};
+  const int size = 2000;
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> distr(-1, 1);
+  std::vector<double> origin(size);
+  for (int i = 0; i < size; i++) {
+    origin[i] = distr(gen);
+  }
+  const double rate = 0.01, scale = 1;
+
+  for (auto type : {OPTIMIZER_MOMENTUM, OPTIMIZER_ADAM}) {
+    auto full = OptimizerFactory::Create<double>(type, layer);
+    auto expect = origin;
+    std::size_t full_bytes = full->state_bytes();
+    for (auto precision : {STATE_PRECISION_FLOAT, STATE_PRECISION_BF16,
+                           STATE_PRECISION_FP16}) {
+      auto optimizer = OptimizerFactory::Create<double>(type, layer);
+      optimizer->set_state_precision(precision);
+      std::size_t expect_bytes =
+          full_bytes / (precision == STATE_PRECISION_FLOAT ? 2 : 4);
+      MUST_EQUAL(optimizer->state_bytes(), expect_bytes);
+      MUST_TRUE(optimizer->weight_state(1).moment_.empty(),
+                "full state still allocated");
+
+      // a slowly changing gradient, weight keep double and stay near the
+      // full precision run
+      auto weight = origin;
+      expect = origin;
+      full->set_state_precision(STATE_PRECISION_FULL);
+      for (int step = 0; step < 20; step++) {
+        std::vector<double> grad(size);
+        for (int i = 0; i < size; i++) {
+          grad[i] = std::sin(i + step * 0.1);
+        }
+        optimizer->Update(weight, grad, optimizer->weight_state(1), rate,
+                          scale);
+        full->Update(expect, grad, full->weight_state(1), rate, scale);
+      }
+      MUST_EQUAL(optimizer->weight_state(1).step_,
+                 full->weight_state(1).step_);
+      double max_error = 0;
+      for (int i = 0; i < size; i++) {
+        max_error = std::max(max_error, std::fabs(weight[i] - expect[i]));
+      }
+      DEBUG("optimizer " << type << " precision " << precision
+                         << " error: " << max_error);
+      // weight move about 1 in total, error follow the mantissa of state
+      double tolerance = precision == STATE_PRECISION_FLOAT  ? 1e-5
+                         : precision == STATE_PRECISION_BF16 ? 3e-2
+                                                             : 4e-3;
+      MUST_TRUE(max_error < tolerance, "reduced state drift");
+
+      // export widen to double, import into full state give the same moment
+      std::vector<double> state, full_state;
+      optimizer->ExportState(state);
+      auto copy = OptimizerFactory::Create<double>(type, layer);
+      MUST_TRUE(copy->ImportState(state), "import reduced state failed");
+      copy->ExportState(full_state);
+      MUST_TRUE(state == full_state, "reduced state changed by import");
+    }
+  }
+}
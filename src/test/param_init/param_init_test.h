@@ -0,0 +1,41 @@
+#pragma once
+
+#include "param_init/param_init_factory.h"
+#include "test.h"
+#include <cmath>
+#include <vector>
+
+TEST(ParamInit, Range) {
+  using namespace deeplearning;
+  std::vector<int> layer = {100, 20, 4};
+  std::vector<Matrix<double>> weight(layer.size());
+  std::vector<AlignedVector<double>> bias(layer.size());
+  for (int i = 1; i < layer.size(); i++) {
+    weight[i].Resize(layer[i], layer[i - 1]);
+    bias[i].resize(layer[i]);
+  }
+  // fan in and out of layer i is layer[i - 1] and layer[i], the first layer
+  // included. 2000 uniform draw get above 0.9 of the limit for sure, a wider
+  // or narrower range is caught
+  auto check = [&](ParamInitType type, int i, double limit) {
+    ParamInitFactory::Create<double>(type)->InitParam(weight, bias);
+    double max = 0;
+    for (double w : weight[i]) {
+      max = std::max(max, std::fabs(w));
+    }
+    for (double b : bias[i]) {
+      max = std::max(max, std::fabs(b));
+    }
+    DEBUG("init " << type << " layer " << i << " max: " << max
+                  << " limit: " << limit);
+    return max <= limit && (i == 2 || max > 0.9 * limit);
+  };
+  MUST_TRUE(check(PARAM_INIT_XAVIER, 1, std::sqrt(6.0 / (100 + 20))),
+            "xavier first layer out of range");
+  MUST_TRUE(check(PARAM_INIT_XAVIER, 2, std::sqrt(6.0 / (20 + 4))),
+            "xavier second layer out of range");
+  MUST_TRUE(check(PARAM_INIT_HE, 1, std::sqrt(6.0 / 100)),
+            "he first layer out of range");
+  MUST_TRUE(check(PARAM_INIT_HE, 2, std::sqrt(6.0 / 20)),
+            "he second layer out of range");
+}
@@ -2,6 +2,7 @@
 
 #include "softmax/softmax_factory.h"
 #include "test.h"
+#include <cmath>
 #include <vector>
 
 TEST(SoftmaxStd, Demo) {
@@ -13,3 +14,52 @@ TEST(SoftmaxStd, Demo) {
   MUST_EQUAL(arr[0], 0.5);
   MUST_EQUAL(arr[1], 0.5);
 }
+
+TEST(SoftmaxStd, StableAndBatch) {
+  using namespace deeplearning;
+  using namespace deeplearning::kernel;
+  // large logit overflow e^x without subtract the max
+  auto softmax = SoftmaxFactory::Create(SOFTMAX_STD);
+  std::vector<double> arr = {1000, 1000, 990};
+  softmax->Normalize(arr, arr);
+  MUST_TRUE(std::fabs(arr[0] - arr[1]) < 1e-15, "large logit not stable");
+  MUST_TRUE(std::fabs(arr[0] + arr[1] + arr[2] - 1) < 1e-12,
+            "large logit sum is not 1");
+
+  // every isa, row-wise batch match the long double reference
+  const int rows = 5, cols = 13;
+  Matrix<double> logits(rows, cols), expect(rows, cols);
+  for (int i = 0; i < rows; i++) {
+    long double sum = 0;
+    for (int j = 0; j < cols; j++) {
+      logits(i, j) = (i * 7 + j * 3) % 11 - 5 + 100 * i;
+    }
+    for (int j = 0; j < cols; j++) {
+      sum += std::exp((long double)(logits(i, j) - 100 * i));
+    }
+    for (int j = 0; j < cols; j++) {
+      expect(i, j) = std::exp((long double)(logits(i, j) - 100 * i)) / sum;
+    }
+  }
+  for (int isa = CPU_ISA_SCALAR; isa <= CpuFeature::DetectIsa(); isa++) {
+    auto output = logits;
+    CreateKernelTable<double>((CpuIsa)isa)
+        .softmax_[MATH_ACCURACY_EXACT](rows, cols, output.data(),
+                                       output.data());
+    double max_error = 0;
+    for (int i = 0; i < output.size(); i++) {
+      max_error = std::max(max_error,
+                           std::fabs(output.data()[i] - expect.data()[i]));
+    }
+    DEBUG(CpuFeature::IsaName((CpuIsa)isa) << " softmax error: " << max_error);
+    MUST_TRUE(max_error < 1e-15, "softmax kernel mismatch");
+  }
+
+  // batch normalize through the softmax function
+  auto output = logits;
+  softmax->Normalize(output);
+  for (int i = 0; i < output.size(); i++) {
+    MUST_TRUE(std::fabs(output.data()[i] - expect.data()[i]) < 1e-15,
+              "batch softmax mismatch");
+  }
+}
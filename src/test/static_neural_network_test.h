@@ -0,0 +1,112 @@
+#pragma once
+
+#include "neural_network.h"
+#include "neural_network_loader.h"
+#include "static_neural_network.h"
+#include "test.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using namespace std;
+using namespace deeplearning;
+
+using DemoStaticNetwork =
+    StaticNeuralNetwork<SigmoidActivate<double>, MSELoss<double>,
+                        MomentumOptimizer<double>, 2, 6, 4, 2>;
+
+TEST(StaticNeuralNetwork, TrainAndExport) {
+  // point above or below line y = x
+  std::vector<std::vector<double>> data, target;
+  srand(1);
+  for (int i = 0; i < 4000; i++) {
+    double x = rand() * 2.0 / RAND_MAX - 1, y = rand() * 2.0 / RAND_MAX - 1;
+    data.push_back({x, y});
+    target.push_back(y > x ? vector<double>{1, 0} : vector<double>{0, 1});
+  }
+
+  auto network = std::make_unique<DemoStaticNetwork>();
+  MUST_EQUAL(network->Init(), DemoStaticNetwork::SUCCESS);
+  MUST_EQUAL(network->set_param_init_function(PARAM_INIT_XAVIER),
+             DemoStaticNetwork::SUCCESS);
+  MUST_EQUAL(network->set_softmax_function(SOFTMAX_STD),
+             DemoStaticNetwork::SUCCESS);
+  auto rc = network->Train(data, target, nullptr, 20000, 4, 0.1);
+  MUST_TRUE(rc == DemoStaticNetwork::SUCCESS, network->err_msg());
+
+  int right_count = 0;
+  for (int i = 0; i < data.size(); i++) {
+    vector<double> result;
+    MUST_EQUAL(network->Predict(data[i], result), DemoStaticNetwork::SUCCESS);
+    if ((result[0] > result[1]) == (target[i][0] > target[i][1])) {
+      right_count++;
+    }
+  }
+  DEBUG("static right rate: " << right_count * 1.0 / data.size());
+  MUST_TRUE(right_count * 1.0 / data.size() > 0.9, "train loss is too high");
+
+  // same param and option format as NeuralNetwork, round trip by file
+  NeuralNetwork::NetworkParam param;
+  NeuralNetwork::NetworkOption option;
+  MUST_EQUAL(network->ExportNetworkParam(param, option),
+             DemoStaticNetwork::SUCCESS);
+  const std::string filename = "static_neural_network_test.param";
+  DEFER([=]() { remove(filename.c_str()); });
+  MUST_EQUAL(NeuralNetworkLoader::ExportParamToFile(param, option, filename),
+             NeuralNetworkLoader::SUCCESS);
+  NeuralNetwork::NetworkParam param2;
+  NeuralNetwork::NetworkOption option2;
+  MUST_EQUAL(NeuralNetworkLoader::ImportParamFromFile(param2, option2, filename),
+             NeuralNetworkLoader::SUCCESS);
+
+  NeuralNetwork dynamic_network;
+  auto dynamic_rc = dynamic_network.ImportNetworkParam(param2, option2);
+  MUST_TRUE(dynamic_rc == NeuralNetwork::SUCCESS, dynamic_network.err_msg());
+  auto network2 = std::make_unique<DemoStaticNetwork>();
+  rc = network2->ImportNetworkParam(param2, option2);
+  MUST_TRUE(rc == DemoStaticNetwork::SUCCESS, network2->err_msg());
+  for (int i = 0; i < 100; i++) {
+    vector<double> expect, result;
+    MUST_EQUAL(dynamic_network.Predict(data[i], expect), NeuralNetwork::SUCCESS);
+    MUST_EQUAL(network2->Predict(data[i], result), DemoStaticNetwork::SUCCESS);
+    for (int j = 0; j < result.size(); j++) {
+      MUST_TRUE(fabs(result[j] - expect[j]) < 1e-9, "static predict mismatch");
+    }
+  }
+
+  // topology is compiled in, other layer is rejected
+  param2.layer_[1] = 5;
+  auto network3 = std::make_unique<DemoStaticNetwork>();
+  MUST_EQUAL(network3->ImportNetworkParam(param2, option2),
+             DemoStaticNetwork::INVALID_DATA);
+}
+
+// the concrete policy is not final, a user optimizer derive from it
+int counting_sgd_update = 0;
+template <typename T> class CountingSGD : public SGDOptimizer<T> {
+public:
+  using SGDOptimizer<T>::SGDOptimizer;
+  void UpdateLayer(Span<T> weight, Span<const T> grad, OptimizerState<T> &state,
+                   T learning_rate, T grad_scale) override {
+    counting_sgd_update++;
+    SGDOptimizer<T>::UpdateLayer(weight, grad, state, learning_rate,
+                                 grad_scale);
+  }
+};
+
+TEST(StaticNeuralNetwork, DerivedPolicy) {
+  using CountingNetwork =
+      StaticNeuralNetwork<SigmoidActivate<double>, MSELoss<double>,
+                          CountingSGD<double>, 2, 3, 2>;
+  CountingNetwork network;
+  counting_sgd_update = 0;
+  MUST_EQUAL(network.Init(), CountingNetwork::SUCCESS);
+  std::vector<std::vector<double>> data = {{0, 1}, {1, 0}};
+  std::vector<std::vector<double>> target = {{1, 0}, {0, 1}};
+  auto rc = network.Train(data, target, nullptr, 5, 2, 0.1);
+  MUST_TRUE(rc == CountingNetwork::SUCCESS, network.err_msg());
+  // weight and bias of 2 layer per step
+  MUST_EQUAL(counting_sgd_update, 5 * 4);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "test.h"
+#include "util/data_source.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+TEST(DataSource, RecordFile) {
+  using namespace deeplearning;
+  const std::string file_path = "data_source.record";
+  DEFER([=]() { remove(file_path.c_str()); });
+  // 11 feature bit row of 2 byte, a record is 3 byte and a chunk of 9 byte
+  // hold 3 record
+  RecordWriter writer;
+  auto rc = writer.Open(file_path, Dataset::FORMAT_BIT, 11, 4);
+  MUST_TRUE(rc == RecordWriter::SUCCESS, writer.err_msg());
+  std::vector<std::vector<std::uint8_t>> value(
+      10, std::vector<std::uint8_t>(11));
+  for (int i = 0; i < 10; i++) {
+    for (int j = 0; j < 11; j++) {
+      value[i][j] = (i + j) % 3 == 0;
+    }
+    MUST_EQUAL(writer.Append(value[i].data(), i % 4), RecordWriter::SUCCESS);
+  }
+  MUST_EQUAL(writer.Append(value[0].data(), 4), RecordWriter::INVALID_DATA);
+  MUST_EQUAL(writer.Close(), RecordWriter::SUCCESS);
+
+  RecordFileSource<float> source;
+  auto source_rc = source.Open(file_path, 9, false);
+  MUST_TRUE(source_rc == RecordFileSource<float>::SUCCESS, source.err_msg());
+  MUST_EQUAL(source.SizeHint(), 10);
+  MUST_EQUAL(source.sample_size(), 11);
+  MUST_EQUAL(source.target_size(), 4);
+  std::vector<float> data(4 * 11), target(4 * 4);
+  for (int pass = 0; pass < 2; pass++) {
+    int read = 0;
+    for (int expect : {4, 4, 2, 0}) {
+      int count = source.NextBatch(4, data.data(), target.data());
+      MUST_EQUAL(count, expect);
+      for (int i = 0; i < count; i++, read++) {
+        for (int j = 0; j < 11; j++) {
+          MUST_EQUAL(data[i * 11 + j], (float)value[read][j]);
+        }
+        MUST_EQUAL(target[i * 4 + read % 4], 1.0f);
+      }
+    }
+    MUST_TRUE(source.Reset(), source.err_msg());
+  }
+
+  // a shuffled pass still see every record once
+  source_rc = source.Open(file_path, 9, true);
+  MUST_TRUE(source_rc == RecordFileSource<float>::SUCCESS, source.err_msg());
+  std::vector<int> seen(4, 0);
+  int count = 0;
+  while ((count = source.NextBatch(4, data.data(), target.data())) > 0) {
+    for (int i = 0; i < count; i++) {
+      for (int k = 0; k < 4; k++) {
+        seen[k] += target[i * 4 + k] == 1.0f;
+      }
+    }
+  }
+  MUST_TRUE(seen == (std::vector<int>{3, 3, 2, 2}), "record lost in shuffle");
+
+  // a truncated file is found at open
+  {
+    std::ofstream file(file_path, std::ios::binary | std::ios::app);
+    file.put(0);
+  }
+  source_rc = source.Open(file_path);
+  MUST_EQUAL(source_rc, RecordFileSource<float>::DATA_FORMAT_ERROR);
+}
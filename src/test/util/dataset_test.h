@@ -0,0 +1,47 @@
+#pragma once
+
+#include "test.h"
+#include "util/dataset.h"
+#include <cmath>
+#include <vector>
+
+TEST(Dataset, Encode) {
+  using namespace deeplearning;
+  // 11 feature, so the bit row has a partial last byte
+  std::vector<std::vector<double>> data = {
+      {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10},
+      {10, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2}};
+  std::vector<std::vector<double>> target = {{0, 0, 1}, {1, 0, 0}};
+  Dataset byte_data, bit_data;
+  auto rc = byte_data.Assign(data, target, Dataset::FORMAT_UINT8, 0.5);
+  MUST_TRUE(rc == Dataset::SUCCESS, byte_data.err_msg());
+  rc = bit_data.Assign(data, target, Dataset::FORMAT_BIT, 1);
+  MUST_TRUE(rc == Dataset::SUCCESS, bit_data.err_msg());
+  MUST_EQUAL(byte_data.bytes(), 2 * 11 + 2);
+  MUST_EQUAL(bit_data.bytes(), 2 * 2 + 2);
+
+  std::vector<float> sample(11), expect(3);
+  for (int i = 0; i < 2; i++) {
+    byte_data.LoadSample(i, sample.data());
+    for (int j = 0; j < 11; j++) {
+      MUST_EQUAL(sample[j], (float)data[i][j]);
+    }
+    bit_data.LoadSample(i, sample.data());
+    for (int j = 0; j < 11; j++) {
+      MUST_EQUAL(sample[j], data[i][j] != 0 ? 1.0f : 0.0f);
+    }
+    bit_data.LoadTarget(i, expect.data());
+    for (int j = 0; j < 3; j++) {
+      MUST_EQUAL(expect[j], (float)target[i][j]);
+    }
+  }
+  MUST_EQUAL(byte_data.label(0), 2);
+
+  // value beyond 255 step saturate
+  rc = byte_data.Assign(data, target, Dataset::FORMAT_UINT8, 0.01);
+  MUST_TRUE(rc == Dataset::SUCCESS, byte_data.err_msg());
+  byte_data.LoadSample(0, sample.data());
+  MUST_TRUE(std::fabs(sample[10] - 2.55f) < 1e-6, "uint8 not saturated");
+  rc = byte_data.SetLabel(0, 3);
+  MUST_EQUAL(rc, Dataset::INVALID_DATA);
+}
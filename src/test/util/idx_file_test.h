@@ -0,0 +1,125 @@
+#pragma once
+
+#include "neural_network.h"
+#include "test.h"
+#include "util/idx_file.h"
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+inline void WriteIdxFile(const std::string &filename,
+                         const std::vector<int> &dims,
+                         const std::vector<std::uint8_t> &payload) {
+  std::ofstream file(filename, std::ios::binary);
+  std::vector<std::uint8_t> head = {0, 0, 0x08, (std::uint8_t)dims.size()};
+  for (int dim : dims) {
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      head.push_back((dim >> shift) & 255);
+    }
+  }
+  file.write((const char *)head.data(), head.size());
+  file.write((const char *)payload.data(), payload.size());
+}
+
+TEST(IdxFile, MappedDataset) {
+  using namespace deeplearning;
+  const std::string image_file = "idx_image.idx";
+  const std::string label_file = "idx_label.idx";
+  DEFER([=]() {
+    remove(image_file.c_str());
+    remove(label_file.c_str());
+  });
+  // 4 image of 2x3
+  std::vector<std::uint8_t> pixel(4 * 6), label = {2, 0, 1, 2};
+  for (int i = 0; i < pixel.size(); i++) {
+    pixel[i] = i * 7 % 5 == 0 ? 0 : i * 10;
+  }
+  WriteIdxFile(image_file, {4, 2, 3}, pixel);
+  WriteIdxFile(label_file, {4}, label);
+
+  IdxFile image;
+  auto rc = image.Open(image_file);
+  MUST_TRUE(rc == IdxFile::SUCCESS, image.err_msg());
+  MUST_EQUAL(image.dims().size(), 3);
+  MUST_EQUAL(image.size(), 4);
+  MUST_EQUAL(image.item_size(), 6);
+  MUST_EQUAL(image.view().Slice(1, 3).Row(1)[0], pixel[12]);
+
+  Dataset view;
+  {
+    Dataset mapped;
+    std::string err_msg;
+    rc = IdxFile::OpenDataset(image_file, label_file, 3, Dataset::FORMAT_UINT8,
+                              0.5, mapped, err_msg);
+    MUST_TRUE(rc == IdxFile::SUCCESS, err_msg);
+    // the copy keep the mapping alive
+    view = mapped;
+  }
+  MUST_EQUAL(view.size(), 4);
+  MUST_EQUAL(view.sample_size(), 6);
+  MUST_EQUAL(view.SetLabel(0, 1), Dataset::INVALID_DATA);
+  std::vector<float> sample(6), target(3);
+  for (int i = 0; i < 4; i++) {
+    MUST_EQUAL(view.label(i), label[i]);
+    view.LoadSample(i, sample.data());
+    for (int j = 0; j < 6; j++) {
+      MUST_EQUAL(sample[j], pixel[i * 6 + j] * 0.5f);
+    }
+    view.LoadTarget(i, target.data());
+    MUST_EQUAL(target[label[i]], 1.0f);
+  }
+
+  // the network see the same data as an owned copy
+  std::vector<std::vector<double>> data(4, std::vector<double>(6));
+  std::vector<std::vector<double>> one_hot(4, std::vector<double>(3, 0));
+  for (int i = 0; i < 4; i++) {
+    for (int j = 0; j < 6; j++) {
+      data[i][j] = pixel[i * 6 + j] != 0;
+    }
+    one_hot[i][label[i]] = 1;
+  }
+  Dataset owned, binary;
+  owned.Assign(data, one_hot, Dataset::FORMAT_BIT);
+  std::string err_msg;
+  rc = IdxFile::OpenDataset(image_file, label_file, 3,
+                            Dataset::FORMAT_UINT8_BINARY, 1, binary, err_msg);
+  MUST_TRUE(rc == IdxFile::SUCCESS, err_msg);
+  NeuralNetwork network((std::vector<int>() = {6, 4, 3}));
+  network.set_param_init_function(ParamInitType::PARAM_INIT_XAVIER);
+  double owned_loss = 0, binary_loss = 0;
+  network.CalcLoss(owned, owned_loss);
+  network.CalcLoss(binary, binary_loss);
+  MUST_EQUAL(owned_loss, binary_loss);
+}
+
+TEST(IdxFile, InvalidFile) {
+  using namespace deeplearning;
+  const std::string image_file = "idx_bad_image.idx";
+  const std::string label_file = "idx_bad_label.idx";
+  DEFER([=]() {
+    remove(image_file.c_str());
+    remove(label_file.c_str());
+  });
+  IdxFile file;
+  MUST_EQUAL(file.Open("idx_missing.idx"), IdxFile::FILE_OPEN_ERROR);
+  // header promise 3 item of 4 byte, payload has 11
+  WriteIdxFile(image_file, {3, 4}, std::vector<std::uint8_t>(11));
+  MUST_EQUAL(file.Open(image_file), IdxFile::DATA_FORMAT_ERROR);
+  // an item of 2^48 byte is refused while its size is multiplied
+  WriteIdxFile(image_file, {1, 65536, 65536, 65536},
+               std::vector<std::uint8_t>(16));
+  MUST_EQUAL(file.Open(image_file), IdxFile::DATA_FORMAT_ERROR);
+
+  WriteIdxFile(image_file, {2, 4}, std::vector<std::uint8_t>(8));
+  WriteIdxFile(label_file, {2}, {1, 5});
+  Dataset dataset;
+  std::string err_msg;
+  auto rc = IdxFile::OpenDataset(image_file, label_file, 5,
+                                 Dataset::FORMAT_UINT8, 1, dataset, err_msg);
+  MUST_EQUAL(rc, IdxFile::DATA_FORMAT_ERROR);
+  WriteIdxFile(label_file, {3}, {1, 2, 3});
+  rc = IdxFile::OpenDataset(image_file, label_file, 5, Dataset::FORMAT_UINT8,
+                            1, dataset, err_msg);
+  MUST_EQUAL(rc, IdxFile::DATA_FORMAT_ERROR);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "test.h"
+#include "util/reduced_float.h"
+#include <cmath>
+
+TEST(ReducedFloat, Convert) {
+  using namespace deeplearning;
+  // representable value survive whatever the random word is
+  for (float value : {0.0f, 1.0f, -2.5f, 0.15625f, 65504.0f, 0x1p-24f}) {
+    for (std::uint32_t random : {0u, 0x7fffu, 0xffffffffu}) {
+      MUST_EQUAL(Fp16ToFloat(FloatToFp16(value, random)), value);
+      if (value != 65504.0f && value != 0x1p-24f) {
+        MUST_EQUAL(Bf16ToFloat(FloatToBf16(value, random)), value);
+      }
+    }
+  }
+  MUST_EQUAL(Fp16ToFloat(FloatToFp16(1e6f, 0)), 65504.0f);
+  MUST_EQUAL(Fp16ToFloat(FloatToFp16(-1e6f, 0)), -65504.0f);
+  MUST_TRUE(std::isinf(Bf16ToFloat(FloatToBf16(INFINITY, 0))), "bf16 inf");
+  MUST_TRUE(std::isnan(Bf16ToFloat(FloatToBf16(NAN, 0))), "bf16 nan");
+  MUST_TRUE(std::isnan(Fp16ToFloat(FloatToFp16(NAN, 0))), "fp16 nan");
+
+  // stochastic rounding is unbiased, round to nearest would always give 1
+  RoundingRandom random;
+  const int count = 100000;
+  const double value = 1 + 0x1p-10, fp16_value = 1 + 0x1p-13;
+  const double tiny = 0x1p-26, fp32_value = 1 + 0x1p-26;
+  double bf16_sum = 0, fp16_sum = 0, tiny_sum = 0, fp32_sum = 0;
+  for (int i = 0; i < count; i++) {
+    bf16_sum += Bf16ToFloat(FloatToBf16(value, random.Next()));
+    fp16_sum += Fp16ToFloat(FloatToFp16(fp16_value, random.Next()));
+    tiny_sum += Fp16ToFloat(FloatToFp16(tiny, random.Next()));
+    fp32_sum += RoundToFloat(fp32_value, random.Next());
+  }
+  DEBUG("bf16 mean: " << bf16_sum / count - 1 << " fp16 mean: "
+                      << fp16_sum / count - 1);
+  MUST_TRUE(std::fabs(bf16_sum / count - value) < 0x1p-13, "bf16 bias");
+  MUST_TRUE(std::fabs(fp16_sum / count - fp16_value) < 0x1p-16, "fp16 bias");
+  MUST_TRUE(std::fabs(tiny_sum / count - tiny) < 0x1p-29, "subnormal bias");
+  MUST_TRUE(std::fabs(fp32_sum / count - fp32_value) < 0x1p-29, "fp32 bias");
+}
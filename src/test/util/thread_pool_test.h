@@ -0,0 +1,55 @@
+#pragma once
+
+#include "test.h"
+#include "util/thread_pool.h"
+#include <atomic>
+#include <vector>
+
+TEST(ThreadPool, ParallelFor) {
+  using namespace deeplearning;
+  ThreadPool pool(4);
+  MUST_EQUAL(pool.thread_num(), 4);
+  const int size = 1000;
+  for (int grain : {1, 7, 64, 2000}) {
+    std::vector<int> count(size, 0);
+    pool.ParallelFor(0, size, grain, [&](int begin, int end) {
+      MUST_TRUE(end - begin <= grain, "chunk bigger than grain");
+      for (int i = begin; i < end; i++) {
+        count[i]++;
+      }
+    });
+    for (int i = 0; i < size; i++) {
+      MUST_EQUAL(count[i], 1);
+    }
+  }
+
+  // nested call run inside the worker without deadlock
+  std::atomic<int> sum(0);
+  pool.ParallelFor(0, 16, 1, [&](int outer, int) {
+    pool.ParallelFor(0, 100, 10, [&](int begin, int end) {
+      for (int i = begin; i < end; i++) {
+        sum += i;
+      }
+    });
+  });
+  MUST_EQUAL(sum.load(), 16 * 4950);
+
+  // one thread run inline
+  ThreadPool single(1);
+  int calls = 0;
+  single.ParallelFor(3, 10, 2, [&](int begin, int end) {
+    calls++;
+    MUST_EQUAL(begin, 3);
+    MUST_EQUAL(end, 10);
+  });
+  MUST_EQUAL(calls, 1);
+}
+
+TEST(ThreadPool, Global) {
+  using namespace deeplearning;
+  auto &pool = ThreadPool::Global();
+  MUST_TRUE(pool.thread_num() >= 1, "empty global pool");
+  MUST_TRUE(&pool == &ThreadPool::Global(), "global pool not unique");
+  // sized once per process
+  MUST_TRUE(!ThreadPool::Configure(2), "configure after first use");
+}